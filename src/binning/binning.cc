@@ -0,0 +1,264 @@
+#include "binning.h"
+
+#include <algorithm>
+#include <cassert>
+#include <ranges>
+#include <utility>
+
+#include <omp.h>
+#include <opencv2/core/core.hpp>
+
+#include "instruction_info.h"
+
+void BinningBase::SetNumThreads(int32_t num_threads) {
+  num_threads_ = num_threads > 0 ? num_threads : omp_get_max_threads();
+}
+
+namespace {
+// dstのrows行をnum_bands個に分けたときのband番目の[begin, end)．境界はalignの倍数に揃え，最後のバンドは端数を含む
+std::pair<int32_t, int32_t> BandRows(int32_t rows, int32_t align, int32_t band, int32_t num_bands) {
+  const int32_t begin = rows * band / num_bands / align * align;
+  const int32_t end   = band == num_bands - 1 ? rows : rows * (band + 1) / num_bands / align * align;
+  return {begin, end};
+}
+} // namespace
+
+void BinningBase::ForEachBand(const cv::Mat& src, cv::Mat& dst, uint32_t binning_y,
+                              const std::function<void(const cv::Mat&, cv::Mat&)>& func) {
+  const int32_t align     = color_filter_ == ColorFilter::Bayer ? 2 : 1;
+  const int32_t num_bands = std::clamp(num_threads_, 1, std::max(dst.rows / align, 1));
+  if (num_bands == 1) {
+    func(src, dst);
+    return;
+  }
+
+#pragma omp parallel for num_threads(num_bands) schedule(static, 1)
+  for (int32_t band = 0; band < num_bands; band++) {
+    const auto [dst_begin, dst_end] = BandRows(dst.rows, align, band, num_bands);
+    const cv::Mat src_band          = src.rowRange(dst_begin * binning_y, dst_end * binning_y);
+    cv::Mat dst_band                = dst.rowRange(dst_begin, dst_end);
+    func(src_band, dst_band);
+  }
+}
+
+void BinningBase::ExecuteBatch(std::span<const cv::Mat> src, std::span<cv::Mat> dst, uint32_t binning_x,
+                               uint32_t binning_y) {
+  assert(src.size() == dst.size());
+  const int32_t num_frames = static_cast<int32_t>(src.size());
+  if (num_frames == 0) {
+    return;
+  }
+
+  // フレーム数がスレッド数より少ない場合だけフレームを行方向のバンドに分け，全体でスレッド数以上の単位にする
+  const int32_t align           = color_filter_ == ColorFilter::Bayer ? 2 : 1;
+  const int32_t bands_per_frame = std::max((num_threads_ + num_frames - 1) / num_frames, 1);
+  const int32_t num_items       = num_frames * bands_per_frame;
+
+#pragma omp parallel for num_threads(std::clamp(num_threads_, 1, num_items)) schedule(dynamic)
+  for (int32_t item = 0; item < num_items; item++) {
+    const int32_t frame     = item / bands_per_frame;
+    const int32_t band      = item % bands_per_frame;
+    const cv::Mat& src_i    = src[frame];
+    cv::Mat& dst_i          = dst[frame];
+    const int32_t num_bands = std::clamp(bands_per_frame, 1, std::max(dst_i.rows / align, 1));
+    if (band >= num_bands) {
+      continue;
+    }
+    const auto [dst_begin, dst_end] = BandRows(dst_i.rows, align, band, num_bands);
+    const cv::Mat src_band          = src_i.rowRange(dst_begin * binning_y, dst_end * binning_y);
+    cv::Mat dst_band                = dst_i.rowRange(dst_begin, dst_end);
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  }
+}
+
+void BinningBase::ExecuteBatch(const cv::Mat& src_stack, cv::Mat& dst_stack, int32_t num_frames,
+                               uint32_t binning_x, uint32_t binning_y) {
+  assert(num_frames > 0 && src_stack.rows % num_frames == 0 && dst_stack.rows % num_frames == 0);
+  const int32_t src_rows = src_stack.rows / num_frames;
+  const int32_t dst_rows = dst_stack.rows / num_frames;
+
+  // 行の範囲のヘッダを作るだけでコピーはしない
+  std::vector<cv::Mat> src(num_frames), dst(num_frames);
+  for (auto frame : std::views::iota(0, num_frames)) {
+    src[frame] = src_stack.rowRange(frame * src_rows, (frame + 1) * src_rows);
+    dst[frame] = dst_stack.rowRange(frame * dst_rows, (frame + 1) * dst_rows);
+  }
+  ExecuteBatch(src, dst, binning_x, binning_y);
+}
+
+cv::Size BinningBase::GetOutputSize(cv::Size src_size, uint32_t binning_x, uint32_t binning_y) const {
+  if (color_filter_ == ColorFilter::Bayer) {
+    return cv::Size(src_size.width / (2 * binning_x) * 2, src_size.height / (2 * binning_y) * 2);
+  }
+  return cv::Size(src_size.width / binning_x, src_size.height / binning_y);
+}
+
+int32_t BinningBase::GetOutputType(int32_t src_type) const {
+  const int32_t depth = CV_MAT_DEPTH(src_type);
+  // 32bitの入力は和と出力が同じ型
+  if (output_mode_ == OutputMode::WideSum && (depth == CV_8U || depth == CV_16U)) {
+    return CV_32SC1;
+  }
+  return CV_MAKETYPE(depth, 1);
+}
+
+void BinningBase::ExecutePyramid(const cv::Mat& src, std::vector<cv::Mat>& dst, int32_t num_levels) {
+  num_levels = std::max(num_levels, 0);
+  dst.resize(num_levels);
+  for (auto level : std::views::iota(0, num_levels)) {
+    const uint32_t binning = 2u << level;
+    dst[level].create(GetOutputSize(src.size(), binning, binning), GetOutputType(src.type()));
+  }
+  if (num_levels == 0) {
+    return;
+  }
+
+  // 符号なしの飽和加算は途中で飽和しても最終結果が変わらないので，8/16bitのSaturatingSumは2x2を重ねて計算できる
+  // int32_tは正負の飽和が打ち消し合って結果が変わり，floatは加算順が変わるので段ごとに計算する
+  const int32_t depth = CV_MAT_DEPTH(src.type());
+  if (output_mode_ != OutputMode::SaturatingSum || color_filter_ != ColorFilter::Mono ||
+      (depth != CV_8U && depth != CV_16U)) {
+    for (auto level : std::views::iota(0, num_levels)) {
+      const uint32_t binning = 2u << level;
+      Execute(src, dst[level], binning, binning);
+    }
+    return;
+  }
+
+  // dst[level]の[begin, end)行を1つ上の段(level == 0の場合はsrc)から2x2でまとめる
+  auto execute_rows = [&](int32_t level, int32_t begin, int32_t end) {
+    const cv::Mat upper = level == 0 ? src : dst[level - 1];
+    cv::Mat dst_rows    = dst[level].rowRange(begin, end);
+    Execute_Band(upper.rowRange(begin * 2, end * 2), dst_rows, 2, 2);
+  };
+
+  // 各段は直後に次の段から読み直すので，非テンポラルストアは使わない
+  const bool streaming_store = std::exchange(streaming_store_, false);
+
+  const int32_t strip_rows = 1 << num_levels;
+  const int32_t num_strips = src.rows / strip_rows;
+  const int32_t num_bands  = std::clamp(num_threads_, 1, std::max(num_strips, 1));
+
+#pragma omp parallel for num_threads(num_bands) schedule(static)
+  for (int32_t strip = 0; strip < num_strips; strip++) {
+    for (int32_t level = 0; level < num_levels; level++) {
+      const int32_t rows = strip_rows >> (level + 1);
+      execute_rows(level, strip * rows, (strip + 1) * rows);
+    }
+  }
+
+  // 2^num_levels行に満たない下端
+  for (auto level : std::views::iota(0, num_levels)) {
+    const int32_t begin = num_strips * (strip_rows >> (level + 1));
+    if (begin < dst[level].rows) {
+      execute_rows(level, begin, dst[level].rows);
+    }
+  }
+  streaming_store_ = streaming_store;
+}
+
+void BinningBase::ExecuteFallback(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) const {
+  Binning<Impl::Naive> naive;
+  naive.SetOutputMode(output_mode_);
+  naive.SetColorFilter(color_filter_);
+  naive.Execute(src, dst, binning_x, binning_y);
+}
+
+namespace {
+bool IsAvx512Supported() {
+  using IIIS = InstructionInfo::InstructionSet;
+  return InstructionInfo::IsSupported(IIIS::AVX512F) && InstructionInfo::IsSupported(IIIS::AVX512BW) &&
+         InstructionInfo::IsSupported(IIIS::AVX512VL);
+}
+
+bool IsAvx2Supported() {
+  return InstructionInfo::IsSupported(InstructionInfo::InstructionSet::AVX2);
+}
+
+constexpr std::pair<Impl, const char*> impl_names[] = {
+    {Impl::None,             "None"            },
+    {Impl::Naive,            "Naive"           },
+    {Impl::SeqRead,          "SeqRead"         },
+    {Impl::Avx2,             "Avx2"            },
+    {Impl::Avx512,           "Avx512"          },
+    {Impl::Avx512UnrollAll,  "Avx512UnrollAll" },
+    {Impl::Avx512UnrollX,    "Avx512UnrollX"   },
+    {Impl::Avx512UnrollLoad, "Avx512UnrollLoad"},
+    {Impl::Avx512Seq,        "Avx512Seq"       },
+    {Impl::Avx512SeqBuffer,  "Avx512SeqBuffer" },
+    {Impl::Auto,             "Auto"            },
+};
+} // namespace
+
+const char* ToString(Impl impl) {
+  for (const auto& [value, name] : impl_names) {
+    if (value == impl) {
+      return name;
+    }
+  }
+  return "Unknown";
+}
+
+Impl ImplFromString(const std::string& name) {
+  for (const auto& [value, impl_name] : impl_names) {
+    if (name == impl_name) {
+      return value;
+    }
+  }
+  return Impl::None;
+}
+
+std::shared_ptr<BinningBase> BinningFactory::Create() {
+  if (IsAvx512Supported()) {
+    return std::make_shared<Binning<Impl::Avx512UnrollAll>>();
+  } else if (IsAvx2Supported()) {
+    return std::make_shared<Binning<Impl::Avx2>>();
+  } else {
+    return std::make_shared<Binning<Impl::Naive>>();
+  }
+}
+
+// 実行環境で使えない実装を指定した場合はnullptrを返す
+std::shared_ptr<BinningBase> BinningFactory::Create(Impl impl) {
+  switch (impl) {
+  case (Impl::Naive):
+    return std::make_shared<Binning<Impl::Naive>>();
+  case (Impl::SeqRead):
+    return std::make_shared<Binning<Impl::SeqRead>>();
+  case (Impl::Avx2):
+    return IsAvx2Supported() ? std::make_shared<Binning<Impl::Avx2>>() : nullptr;
+  case (Impl::Avx512):
+    return IsAvx512Supported() ? std::make_shared<Binning<Impl::Avx512>>() : nullptr;
+  case (Impl::Avx512UnrollAll):
+    return IsAvx512Supported() ? std::make_shared<Binning<Impl::Avx512UnrollAll>>() : nullptr;
+  case (Impl::Avx512UnrollX):
+    return IsAvx512Supported() ? std::make_shared<Binning<Impl::Avx512UnrollX>>() : nullptr;
+  case (Impl::Avx512UnrollLoad):
+    return IsAvx512Supported() ? std::make_shared<Binning<Impl::Avx512UnrollLoad>>() : nullptr;
+  case (Impl::Avx512Seq):
+    return IsAvx512Supported() ? std::make_shared<Binning<Impl::Avx512Seq>>() : nullptr;
+  case (Impl::Avx512SeqBuffer):
+    return IsAvx512Supported() ? std::make_shared<Binning<Impl::Avx512SeqBuffer>>() : nullptr;
+  case (Impl::Auto):
+    return std::make_shared<BinningAutoTuner>();
+  default:
+    return nullptr;
+  }
+}
+
+std::vector<std::shared_ptr<BinningBase>> BinningFactory::CreateAvailable() {
+  std::vector<std::shared_ptr<BinningBase>> impls;
+  for (const auto& [impl, name] : impl_names) {
+    if (impl == Impl::None || impl == Impl::Auto) {
+      continue;
+    }
+    if (auto binning = Create(impl)) {
+      impls.push_back(binning);
+    }
+  }
+  return impls;
+}
+
+std::shared_ptr<BinningBase> BinningFactory::CreateAutoTuner(const std::string& profile_path) {
+  return std::make_shared<BinningAutoTuner>(profile_path);
+}
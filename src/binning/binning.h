@@ -1,7 +1,17 @@
 #pragma once
 
+#include <bit>
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <print>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 #include <immintrin.h>
 #include <opencv2/core/types.hpp>
@@ -10,27 +20,142 @@ enum class Impl {
   None,
   Naive,
   SeqRead,
+  Avx2,
   Avx512,
   Avx512UnrollAll,
   Avx512UnrollX,
   Avx512UnrollLoad,
   Avx512Seq,
-  Avx512SeqBuffer
+  Avx512SeqBuffer,
+  Auto
 };
 
+// 出力の意味
+// SaturatingSum: BINNING_X * BINNING_Y画素の和を入力と同じ型で飽和させる(CV_16UC1の場合CV_16UC1)
+// Average      : 和を画素数で割って四捨五入する(入力と同じ型)
+// WideSum      : 和を飽和させずに32bitで出力する(CV_8UC1, CV_16UC1の場合CV_32SC1)
+// CV_32SC1, CV_32FC1の入力は和と出力が同じ型なので，WideSumはSaturatingSumと同じ
+// CV_32FC1は飽和させず，Averageは四捨五入しない
+enum class OutputMode { SaturatingSum, Average, WideSum };
+
+// 入力のカラーフィルタ
+// Mono : 隣り合う画素をまとめる
+// Bayer: 2x2のBayer配列(RGGB等)の同じ色どうしをまとめ，縮小したBayer配列を出力する
+//        出力サイズは(src.cols / (2 * binning_x) * 2, src.rows / (2 * binning_y) * 2)
+enum class ColorFilter { Mono, Bayer };
+
+// CV_16UC1以外の入力画素型(uint8_t, int32_t, float)のカーネルを選ぶタグ
+template<typename T>
+struct PixelType {};
+template<typename T>
+struct IsPixelType : std::false_type {};
+template<typename T>
+struct IsPixelType<PixelType<T>> : std::true_type {};
+
 class BinningBase {
+protected:
+  int32_t num_threads_       = 1;
+  OutputMode output_mode_   = OutputMode::SaturatingSum;
+  ColorFilter color_filter_ = ColorFilter::Mono;
+  bool streaming_store_     = false;
+
+  // dstを行方向のバンドに分割し，各バンドをワーカースレッドで実行する
+  // srcのバンド境界はBINNING_Yの倍数に揃える．Bayerの場合はdstのバンド境界を偶数行に揃える
+  void ForEachBand(const cv::Mat& src, cv::Mat& dst, uint32_t binning_y,
+                   const std::function<void(const cv::Mat&, cv::Mat&)>& func);
+  // SIMD実装がない係数・出力モード・カラーフィルタの組み合わせはNaiveで処理する
+  void ExecuteFallback(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) const;
+  // ForEachBandで分割した後のバンドを現在のスレッドで処理する
+  virtual void Execute_Band(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) = 0;
+
 public:
   virtual void Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) = 0;
   virtual Impl GetImpl()                                                                         = 0;
+
+  // 2x2, 4x4, ... 2^num_levels x 2^num_levelsのビニング結果をdst[0], dst[1], ...に出力する
+  // srcを2^num_levels行ずつ読み，各段は直前に書いたキャッシュ上の1つ上の段から2x2でまとめるので，srcは1度しか読まない
+  // SaturatingSumかつMonoの場合のみ1パスで処理し，それ以外は段ごとにExecuteする
+  virtual void ExecutePyramid(const cv::Mat& src, std::vector<cv::Mat>& dst, int32_t num_levels);
+
+  // src[i]をdst[i]にビニングする．フレームとバンドをまとめて1つの並列領域で処理するので，小さいフレームを
+  // 多数処理する場合にExecuteを繰り返すよりフレームごとのオーバーヘッドが小さい．dst[i]は確保しておく
+  virtual void ExecuteBatch(std::span<const cv::Mat> src, std::span<cv::Mat> dst, uint32_t binning_x,
+                            uint32_t binning_y);
+  // 同じサイズのnum_frames枚のフレームを縦に並べたsrc_stackをdst_stackにビニングする
+  // dst_stackはGetOutputSize(フレームのサイズ)の高さ * num_frames行で確保しておく
+  void ExecuteBatch(const cv::Mat& src_stack, cv::Mat& dst_stack, int32_t num_frames, uint32_t binning_x,
+                    uint32_t binning_y);
+
+  // 0以下を指定した場合はomp_get_max_threads()を使用する
+  void SetNumThreads(int32_t num_threads);
+  int32_t GetNumThreads() const {
+    return num_threads_;
+  };
+
+  // dstはGetOutputType(src.type())で確保しておく
+  void SetOutputMode(OutputMode output_mode) {
+    output_mode_ = output_mode;
+  };
+  OutputMode GetOutputMode() const {
+    return output_mode_;
+  };
+
+  // 現在の出力モード・カラーフィルタでのdstのサイズと型
+  // 入力はCV_8UC1, CV_16UC1, CV_32SC1, CV_32FC1
+  cv::Size GetOutputSize(cv::Size src_size, uint32_t binning_x, uint32_t binning_y) const;
+  int32_t GetOutputType(int32_t src_type = CV_16UC1) const;
+
+  void SetColorFilter(ColorFilter color_filter) {
+    color_filter_ = color_filter;
+  };
+  ColorFilter GetColorFilter() const {
+    return color_filter_;
+  };
+
+  // AVX-512実装で，64byte境界に揃ったdstの行を非テンポラルストア(_mm512_stream_si512)で書き込む
+  // dstがキャッシュに収まらず，直後に読み直さない場合に書き込み時の読み込み(RFO)を省ける
+  // AVX-512以外の実装，dstを読み直すAvx512Seqの1x1以外，ExecutePyramidの1パス処理では無視する
+  void SetStreamingStore(bool streaming_store) {
+    streaming_store_ = streaming_store;
+  };
+  bool GetStreamingStore() const {
+    return streaming_store_;
+  };
 };
 
 template<Impl IMPL>
 class Binning : public BinningBase {
 private:
+  // 実装済みのビニング係数．未対応の組み合わせはNaiveで処理する
+  static constexpr bool IsSupported(uint32_t binning_x, uint32_t binning_y);
+  // Average, WideSumを実装済みのビニング係数
+  static constexpr bool IsSupportedWide(uint32_t binning_x, uint32_t binning_y);
+  // Bayerを実装済みのビニング係数
+  static constexpr bool IsSupportedBayer(uint32_t binning_x, uint32_t binning_y);
+  // CV_16UC1以外の画素型を実装済みのビニング係数
+  static constexpr bool IsSupportedPixelType(uint32_t binning_x, uint32_t binning_y);
+  // カーネルの引数の型から，どの実装済み係数を使うかを判定する
+  template<uint32_t BINNING_X, uint32_t BINNING_Y, typename... Args>
+  static constexpr bool IsImplemented();
+
   template<uint32_t... params>
   inline void Execute_Impl(uint32_t head, auto&&... args);
+  template<uint32_t... params>
+  inline void Execute_Dispatch(auto&&... args);
   template<uint32_t BINNING_X, uint32_t BINNING_Y>
   void Execute_Impl(const cv::Mat& src, cv::Mat& dst);
+  // 32bitで和をとるAverage, WideSum用のカーネル
+  template<uint32_t BINNING_X, uint32_t BINNING_Y>
+  void Execute_Impl(const cv::Mat& src, cv::Mat& dst, OutputMode output_mode);
+  // 同じ色の画素どうしをまとめるBayer用のカーネル
+  template<uint32_t BINNING_X, uint32_t BINNING_Y>
+  void Execute_Impl(const cv::Mat& src, cv::Mat& dst, ColorFilter color_filter);
+  // CV_16UC1以外の画素型用のカーネル．出力モードはoutput_mode_．SIMDカーネルはMonoのみ
+  template<uint32_t BINNING_X, uint32_t BINNING_Y, typename T>
+  void Execute_Impl(const cv::Mat& src, cv::Mat& dst, PixelType<T>);
+
+protected:
+  void Execute_Band(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) override;
 
 public:
   void Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) override;
@@ -39,24 +164,264 @@ public:
   };
 };
 
+// 係数・画像サイズごとに利用可能な実装を計測し，最速のものでExecuteする
+// 計測結果はprofile_pathに保存し，次回以降は計測せずに読み込む(空の場合は保存しない)
+class BinningAutoTuner : public BinningBase {
+private:
+  // binning_x, binning_y, width, height, type, output_mode, color_filter, num_threads, streaming_store
+  using Key = std::tuple<uint32_t, uint32_t, int32_t, int32_t, int32_t, OutputMode, ColorFilter, int32_t, bool>;
+
+  std::string profile_path_;
+  std::vector<std::shared_ptr<BinningBase>> candidates_;
+  std::map<Key, Impl> selected_;
+  std::mutex mutex_;
+
+  std::shared_ptr<BinningBase> Tune(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y);
+  void LoadProfile();
+  void SaveProfile() const;
+  std::shared_ptr<BinningBase> Select(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y);
+
+protected:
+  void Execute_Band(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) override;
+
+public:
+  explicit BinningAutoTuner(const std::string& profile_path = "");
+
+  void Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) override;
+  // 2x2で選ばれた実装のExecutePyramidを使う
+  void ExecutePyramid(const cv::Mat& src, std::vector<cv::Mat>& dst, int32_t num_levels) override;
+  // src[0]のサイズで選ばれた実装のExecuteBatchを使う
+  void ExecuteBatch(std::span<const cv::Mat> src, std::span<cv::Mat> dst, uint32_t binning_x,
+                    uint32_t binning_y) override;
+  using BinningBase::ExecuteBatch;
+  Impl GetImpl() override {
+    return Impl::Auto;
+  };
+
+  // 計測済みの場合は選ばれた実装，未計測の場合はImpl::Noneを返す
+  Impl GetSelectedImpl(uint32_t binning_x, uint32_t binning_y, cv::Size size, int32_t type = CV_16UC1);
+};
+
+// 数行ずつ届く入力を受け取り，binning_y行(Bayerの場合は2 * binning_y行)揃うごとに出力行を返す
+// 入力のストリップ内で揃った行はそのままExecuteし，揃わなかった行だけを行バッファに保持するので，フレーム全体は保持しない
+class BinningStream {
+public:
+  // dst_rows: 出力行(Bayerの場合は2行単位)，dst_y: dst_rowsの先頭行がフレーム内で何行目か
+  using Callback = std::function<void(const cv::Mat& dst_rows, int32_t dst_y)>;
+
+  // binningの出力モード・カラーフィルタは設定済みであること
+  BinningStream(std::shared_ptr<BinningBase> binning, int32_t width, uint32_t binning_x, uint32_t binning_y);
+
+  // 入力行(1行以上のストリップ)を追加する．出力行ができるたびにcallbackを呼ぶ
+  void Push(const cv::Mat& src_rows, const Callback& callback);
+  // 次のフレームの先頭に戻す．揃っていない行は捨てる(Executeと同じく下端の端数は出力しない)
+  void Reset();
+
+private:
+  std::shared_ptr<BinningBase> binning_;
+  int32_t width_;
+  uint32_t binning_x_;
+  uint32_t binning_y_;
+  int32_t src_group_rows_; // 出力1グループ分の入力行数
+  int32_t dst_group_rows_; // 出力1グループの行数
+  cv::Mat buffer_;         // 揃っていない入力行
+  int32_t buffered_rows_ = 0;
+  cv::Mat dst_;
+  int32_t dst_y_ = 0;
+
+  void Emit(const cv::Mat& src_rows, const Callback& callback);
+};
+
+class BinningFactory {
+public:
+  // 実行環境で利用可能な命令セットから最速の実装を返す
+  static std::shared_ptr<BinningBase> Create();
+  static std::shared_ptr<BinningBase> Create(Impl impl);
+  // 実行環境で利用可能な実装をすべて返す
+  static std::vector<std::shared_ptr<BinningBase>> CreateAvailable();
+  static std::shared_ptr<BinningBase> CreateAutoTuner(const std::string& profile_path = "");
+};
+
+const char* ToString(Impl impl);
+Impl ImplFromString(const std::string& name);
+
+template<Impl IMPL>
+constexpr bool Binning<IMPL>::IsSupported(uint32_t binning_x, uint32_t binning_y) {
+  return std::has_single_bit(binning_x) && std::has_single_bit(binning_y) && binning_x <= 4 && binning_y <= 4;
+}
+template<>
+constexpr bool Binning<Impl::Naive>::IsSupported(uint32_t, uint32_t) {
+  return true;
+}
+template<>
+constexpr bool Binning<Impl::SeqRead>::IsSupported(uint32_t, uint32_t) {
+  return true;
+}
+template<>
+constexpr bool Binning<Impl::Avx2>::IsSupported(uint32_t binning_x, uint32_t binning_y) {
+  return binning_x == 1 || binning_x == 2 || binning_x == 4;
+}
+template<>
+constexpr bool Binning<Impl::Avx512>::IsSupported(uint32_t binning_x, uint32_t binning_y) {
+  return (binning_x == 1 && binning_y == 1) ||
+         ((binning_x == 2 || binning_x == 4) && (binning_y == 2 || binning_y == 4));
+}
+template<>
+constexpr bool Binning<Impl::Avx512UnrollAll>::IsSupported(uint32_t, uint32_t) {
+  return true;
+}
+template<>
+constexpr bool Binning<Impl::Avx512Seq>::IsSupported(uint32_t binning_x, uint32_t binning_y) {
+  return (binning_x == 1 && binning_y == 1) ||
+         ((binning_x == 2 || binning_x == 4) && (binning_y == 1 || binning_y == 2 || binning_y == 4));
+}
+
+template<Impl IMPL>
+constexpr bool Binning<IMPL>::IsSupportedWide(uint32_t, uint32_t) {
+  return false;
+}
+template<>
+constexpr bool Binning<Impl::Naive>::IsSupportedWide(uint32_t, uint32_t) {
+  return true;
+}
+template<>
+constexpr bool Binning<Impl::Avx2>::IsSupportedWide(uint32_t binning_x, uint32_t) {
+  return std::has_single_bit(binning_x) && binning_x <= 8;
+}
+template<>
+constexpr bool Binning<Impl::Avx512UnrollAll>::IsSupportedWide(uint32_t binning_x, uint32_t) {
+  return std::has_single_bit(binning_x) && binning_x <= 8;
+}
+
+template<Impl IMPL>
+constexpr bool Binning<IMPL>::IsSupportedBayer(uint32_t, uint32_t) {
+  return false;
+}
+template<>
+constexpr bool Binning<Impl::Naive>::IsSupportedBayer(uint32_t, uint32_t) {
+  return true;
+}
+template<>
+constexpr bool Binning<Impl::Avx2>::IsSupportedBayer(uint32_t binning_x, uint32_t) {
+  return std::has_single_bit(binning_x) && binning_x <= 8;
+}
+template<>
+constexpr bool Binning<Impl::Avx512UnrollAll>::IsSupportedBayer(uint32_t binning_x, uint32_t) {
+  return std::has_single_bit(binning_x) && binning_x <= 8;
+}
+
+template<Impl IMPL>
+constexpr bool Binning<IMPL>::IsSupportedPixelType(uint32_t, uint32_t) {
+  return false;
+}
+template<>
+constexpr bool Binning<Impl::Naive>::IsSupportedPixelType(uint32_t, uint32_t) {
+  return true;
+}
+template<>
+constexpr bool Binning<Impl::Avx2>::IsSupportedPixelType(uint32_t binning_x, uint32_t) {
+  return std::has_single_bit(binning_x) && binning_x <= 8;
+}
+template<>
+constexpr bool Binning<Impl::Avx512UnrollAll>::IsSupportedPixelType(uint32_t binning_x, uint32_t) {
+  return std::has_single_bit(binning_x) && binning_x <= 8;
+}
+
+template<Impl IMPL>
+template<uint32_t BINNING_X, uint32_t BINNING_Y, typename... Args>
+constexpr bool Binning<IMPL>::IsImplemented() {
+  if constexpr ((IsPixelType<std::remove_cvref_t<Args>>::value || ...)) {
+    return IsSupportedPixelType(BINNING_X, BINNING_Y);
+  } else if constexpr ((std::is_same_v<std::remove_cvref_t<Args>, OutputMode> || ...)) {
+    return IsSupportedWide(BINNING_X, BINNING_Y);
+  } else if constexpr ((std::is_same_v<std::remove_cvref_t<Args>, ColorFilter> || ...)) {
+    return IsSupportedBayer(BINNING_X, BINNING_Y);
+  } else {
+    return IsSupported(BINNING_X, BINNING_Y);
+  }
+}
+
 template<Impl IMPL>
 template<uint32_t... params>
 inline void Binning<IMPL>::Execute_Impl(uint32_t head, auto&&... args) {
   switch (head) {
   case (1):
-    Execute_Impl<params..., 1>(std::forward<decltype(args)>(args)...);
+    Execute_Dispatch<params..., 1>(std::forward<decltype(args)>(args)...);
     break;
   case (2):
-    Execute_Impl<params..., 2>(std::forward<decltype(args)>(args)...);
+    Execute_Dispatch<params..., 2>(std::forward<decltype(args)>(args)...);
+    break;
+  case (3):
+    Execute_Dispatch<params..., 3>(std::forward<decltype(args)>(args)...);
     break;
   case (4):
-    Execute_Impl<params..., 4>(std::forward<decltype(args)>(args)...);
+    Execute_Dispatch<params..., 4>(std::forward<decltype(args)>(args)...);
+    break;
+  case (8):
+    Execute_Dispatch<params..., 8>(std::forward<decltype(args)>(args)...);
     break;
   default:
     assert(false);
   }
 }
 
+template<Impl IMPL>
+template<uint32_t... params>
+inline void Binning<IMPL>::Execute_Dispatch(auto&&... args) {
+  if constexpr (sizeof...(params) < 2) {
+    Execute_Impl<params...>(std::forward<decltype(args)>(args)...);
+  } else if constexpr (IsImplemented<params..., decltype(args)...>()) {
+    Execute_Impl<params...>(std::forward<decltype(args)>(args)...);
+  } else {
+    [&](const cv::Mat& src, cv::Mat& dst, auto&&...) {
+      ExecuteFallback(src, dst, params...);
+    }(std::forward<decltype(args)>(args)...);
+  }
+}
+
+template<Impl IMPL>
+void Binning<IMPL>::Execute_Band(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
+  if (src.depth() != CV_16U) {
+    // SIMDの画素型別カーネルはMonoのみ．NaiveはBayerにも対応する
+    if (IMPL != Impl::Naive && color_filter_ == ColorFilter::Bayer) {
+      ExecuteFallback(src, dst, binning_x, binning_y);
+    } else if (src.depth() == CV_8U) {
+      Execute_Impl(binning_x, binning_y, src, dst, PixelType<uint8_t>{});
+    } else if (src.depth() == CV_32S) {
+      Execute_Impl(binning_x, binning_y, src, dst, PixelType<int32_t>{});
+    } else {
+      assert(src.depth() == CV_32F);
+      Execute_Impl(binning_x, binning_y, src, dst, PixelType<float>{});
+    }
+  } else if (color_filter_ == ColorFilter::Bayer) {
+    // SIMDのBayerカーネルはSaturatingSumのみ．NaiveのBayerカーネルはすべての出力モードに対応する
+    if (IMPL == Impl::Naive || output_mode_ == OutputMode::SaturatingSum) {
+      Execute_Impl(binning_x, binning_y, src, dst, color_filter_);
+    } else {
+      ExecuteFallback(src, dst, binning_x, binning_y);
+    }
+  } else if (output_mode_ == OutputMode::SaturatingSum) {
+    Execute_Impl(binning_x, binning_y, src, dst);
+  } else {
+    Execute_Impl(binning_x, binning_y, src, dst, output_mode_);
+  }
+  // 非テンポラルストアは他のスレッドから見える順序が保証されないので，バンドの終わりでフェンスする
+  if (streaming_store_) {
+    _mm_sfence();
+  }
+}
+
+// カーネルは各実装の.ccにしかないので，Execute_Bandはその.ccで明示的実体化する
+extern template void Binning<Impl::Naive>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+extern template void Binning<Impl::SeqRead>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+extern template void Binning<Impl::Avx2>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+extern template void Binning<Impl::Avx512>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+extern template void Binning<Impl::Avx512UnrollAll>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+extern template void Binning<Impl::Avx512UnrollX>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+extern template void Binning<Impl::Avx512UnrollLoad>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+extern template void Binning<Impl::Avx512Seq>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+extern template void Binning<Impl::Avx512SeqBuffer>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
+
 inline void Print(__m512i vec) {
   std::vector<uint16_t> a(32);
   _mm512_storeu_si512(a.data(), vec);
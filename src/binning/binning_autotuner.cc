@@ -0,0 +1,154 @@
+#include "binning.h"
+
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <ranges>
+#include <sstream>
+
+#include <opencv2/core/core.hpp>
+
+BinningAutoTuner::BinningAutoTuner(const std::string& profile_path)
+    : profile_path_(profile_path), candidates_(BinningFactory::CreateAvailable()) {
+  LoadProfile();
+}
+
+void BinningAutoTuner::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
+  // 候補の実装はこのインスタンスへの呼び出しすべてで共有し，Selectで出力モード等を設定し直すので，
+  // 設定から実行までをまとめて排他する
+  std::lock_guard lock(mutex_);
+  Select(src, dst, binning_x, binning_y)->Execute(src, dst, binning_x, binning_y);
+}
+
+void BinningAutoTuner::ExecutePyramid(const cv::Mat& src, std::vector<cv::Mat>& dst, int32_t num_levels) {
+  std::lock_guard lock(mutex_);
+  if (num_levels <= 0) {
+    dst.clear();
+    return;
+  }
+  dst.resize(num_levels);
+  dst[0].create(GetOutputSize(src.size(), 2, 2), GetOutputType(src.type()));
+  Select(src, dst[0], 2, 2)->ExecutePyramid(src, dst, num_levels);
+}
+
+void BinningAutoTuner::ExecuteBatch(std::span<const cv::Mat> src, std::span<cv::Mat> dst, uint32_t binning_x,
+                                    uint32_t binning_y) {
+  std::lock_guard lock(mutex_);
+  if (src.empty()) {
+    return;
+  }
+  Select(src[0], dst[0], binning_x, binning_y)->ExecuteBatch(src, dst, binning_x, binning_y);
+}
+
+void BinningAutoTuner::Execute_Band(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
+  Execute(src, dst, binning_x, binning_y);
+}
+
+// 計測済みの実装(未計測の場合は計測して最速の実装)を現在の設定にして返す
+std::shared_ptr<BinningBase> BinningAutoTuner::Select(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x,
+                                                      uint32_t binning_y) {
+  const Key key{binning_x, binning_y, src.cols, src.rows, src.type(), output_mode_, color_filter_, num_threads_,
+                streaming_store_};
+  std::shared_ptr<BinningBase> binning;
+  if (auto it = selected_.find(key); it != selected_.end()) {
+    for (const auto& candidate : candidates_) {
+      if (candidate->GetImpl() == it->second) {
+        binning = candidate;
+      }
+    }
+  }
+  // プロファイルに記録された実装がこの環境で使えない場合も計測し直す
+  if (!binning) {
+    binning        = Tune(src, dst, binning_x, binning_y);
+    selected_[key] = binning->GetImpl();
+    SaveProfile();
+  }
+
+  binning->SetOutputMode(output_mode_);
+  binning->SetColorFilter(color_filter_);
+  binning->SetNumThreads(num_threads_);
+  binning->SetStreamingStore(streaming_store_);
+  return binning;
+}
+
+Impl BinningAutoTuner::GetSelectedImpl(uint32_t binning_x, uint32_t binning_y, cv::Size size, int32_t type) {
+  std::lock_guard lock(mutex_);
+  const Key key{binning_x, binning_y, size.width, size.height, type, output_mode_, color_filter_, num_threads_,
+                streaming_store_};
+  auto it = selected_.find(key);
+  return it != selected_.end() ? it->second : Impl::None;
+}
+
+// 実際の入出力で各実装を数回実行し，最短時間の実装を返す
+std::shared_ptr<BinningBase> BinningAutoTuner::Tune(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x,
+                                                    uint32_t binning_y) {
+  constexpr int32_t loop_time = 3;
+
+  std::shared_ptr<BinningBase> fastest;
+  auto fastest_time = std::chrono::steady_clock::duration::max();
+  for (const auto& candidate : candidates_) {
+    candidate->SetOutputMode(output_mode_);
+    candidate->SetColorFilter(color_filter_);
+    candidate->SetNumThreads(num_threads_);
+    candidate->SetStreamingStore(streaming_store_);
+    candidate->Execute(src, dst, binning_x, binning_y); // warm up
+
+    auto time = std::chrono::steady_clock::duration::max();
+    for ([[maybe_unused]] auto i : std::views::iota(0, loop_time)) {
+      const auto start = std::chrono::steady_clock::now();
+      candidate->Execute(src, dst, binning_x, binning_y);
+      time = std::min(time, std::chrono::steady_clock::now() - start);
+    }
+    if (time < fastest_time) {
+      fastest      = candidate;
+      fastest_time = time;
+    }
+  }
+  return fastest;
+}
+
+// 1行1エントリ: binning_x binning_y width height type output_mode color_filter num_threads streaming_store impl
+void BinningAutoTuner::LoadProfile() {
+  if (profile_path_.empty()) {
+    return;
+  }
+  std::ifstream ifs(profile_path_);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::istringstream iss(line);
+    uint32_t binning_x, binning_y;
+    int32_t width, height, type, output_mode, color_filter, num_threads;
+    bool streaming_store;
+    std::string impl_name;
+    if (!(iss >> binning_x >> binning_y >> width >> height >> type >> output_mode >> color_filter >> num_threads >>
+          streaming_store >> impl_name)) {
+      continue;
+    }
+    const Impl impl = ImplFromString(impl_name);
+    if (impl == Impl::None) {
+      continue;
+    }
+    // 範囲外の値はenumにキャストせず，その行を無視する
+    if (output_mode < static_cast<int32_t>(OutputMode::SaturatingSum) ||
+        output_mode > static_cast<int32_t>(OutputMode::WideSum) || color_filter < static_cast<int32_t>(ColorFilter::Mono) ||
+        color_filter > static_cast<int32_t>(ColorFilter::Bayer)) {
+      continue;
+    }
+    selected_[Key{binning_x, binning_y, width, height, type, static_cast<OutputMode>(output_mode),
+                  static_cast<ColorFilter>(color_filter), num_threads, streaming_store}] = impl;
+  }
+}
+
+void BinningAutoTuner::SaveProfile() const {
+  if (profile_path_.empty()) {
+    return;
+  }
+  std::ofstream ofs(profile_path_, std::ios::trunc);
+  for (const auto& [key, impl] : selected_) {
+    const auto& [binning_x, binning_y, width, height, type, output_mode, color_filter, num_threads, streaming_store] =
+        key;
+    ofs << binning_x << ' ' << binning_y << ' ' << width << ' ' << height << ' ' << type << ' '
+        << static_cast<int32_t>(output_mode) << ' ' << static_cast<int32_t>(color_filter) << ' ' << num_threads << ' '
+        << streaming_store << ' ' << ToString(impl) << '\n';
+  }
+}
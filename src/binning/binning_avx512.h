@@ -0,0 +1,125 @@
+#pragma once
+
+// binning_impl_avx512*.cc 専用．#pragma GCC target("avx512f,avx512bw,avx512vl") の後にincludeする
+
+#include <algorithm>
+#include <cstdint>
+#include <ranges>
+
+#include <immintrin.h>
+#include <opencv2/core/core.hpp>
+
+// 有効なレーン数remainからuint16_tベクトルの書き込み・読み込みマスクを作る
+inline __mmask32 TailMask(int32_t remain) {
+  return _bzhi_u32(0xFFFFFFFF, std::clamp(remain, 0, 32));
+}
+
+// 行の途中: ベクトル幅分すべて読み書きできる
+struct FullLanes {
+  __mmask32 LoadMask(int32_t) const {
+    return 0xFFFFFFFF;
+  }
+  __mmask32 StoreMask(int32_t) const {
+    return 0xFFFFFFFF;
+  }
+  __m512i Load(const uint16_t* ptr, int32_t) const {
+    return _mm512_loadu_si512(reinterpret_cast<const void*>(ptr));
+  }
+  void Store(uint16_t* ptr, int32_t, __m512i v) const {
+    _mm512_storeu_si512(ptr, v);
+  }
+  void Store(uint16_t* ptr, int32_t, __m256i v) const {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr), v);
+  }
+  void Store(uint16_t* ptr, int32_t, __m128i v) const {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ptr), v);
+  }
+  void Store(int32_t* ptr, int32_t, __m512i v) const {
+    _mm512_storeu_si512(ptr, v);
+  }
+};
+
+// 行の途中(非テンポラルストア): 書き込み先はストア幅に揃っている必要がある
+// 各カーネルはストア幅ずつ書き進めるので，行の先頭が64byte境界に揃っていれば行の途中はすべて揃う
+struct StreamLanes : FullLanes {
+  void Store(uint16_t* ptr, int32_t, __m512i v) const {
+    _mm512_stream_si512(reinterpret_cast<__m512i*>(ptr), v);
+  }
+  void Store(uint16_t* ptr, int32_t, __m256i v) const {
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(ptr), v);
+  }
+  void Store(uint16_t* ptr, int32_t, __m128i v) const {
+    _mm_stream_si128(reinterpret_cast<__m128i*>(ptr), v);
+  }
+  void Store(int32_t* ptr, int32_t, __m512i v) const {
+    _mm512_stream_si512(reinterpret_cast<__m512i*>(ptr), v);
+  }
+};
+
+// 非テンポラルストアを使う行か．行の先頭が64byte境界に揃っていない場合は通常のストアにする
+inline bool UseStreamingStore(bool streaming_store, const void* dptry) {
+  return streaming_store && (reinterpret_cast<uintptr_t>(dptry) & 63) == 0;
+}
+
+// [0, simd_end)をstepずつprocess(x, lanes)で処理し，処理し終えたxを返す
+// 行の途中のlanesはstreamに応じてStreamLanesかFullLanesにする
+template<typename Process>
+inline int32_t ProcessFullLanes(int32_t simd_end, int32_t step, bool stream, const Process& process) {
+  int32_t x = 0;
+  if (stream) {
+    for (; x < simd_end; x += step) {
+      process(x, StreamLanes{});
+    }
+  } else {
+    for (; x < simd_end; x += step) {
+      process(x, FullLanes{});
+    }
+  }
+  return x;
+}
+
+// 行末の端数: src_remain, dst_remainを超えるレーンはマスクして行外(ROIの外)を読み書きしない
+// offsetはベクトル先頭からの要素オフセット
+struct TailLanes {
+  int32_t src_remain;
+  int32_t dst_remain;
+
+  __mmask32 LoadMask(int32_t offset) const {
+    return TailMask(src_remain - offset);
+  }
+  __mmask32 StoreMask(int32_t offset) const {
+    return TailMask(dst_remain - offset);
+  }
+  __m512i Load(const uint16_t* ptr, int32_t offset) const {
+    return _mm512_maskz_loadu_epi16(TailMask(src_remain - offset), ptr);
+  }
+  void Store(uint16_t* ptr, int32_t offset, __m512i v) const {
+    _mm512_mask_storeu_epi16(ptr, StoreMask(offset), v);
+  }
+  void Store(uint16_t* ptr, int32_t offset, __m256i v) const {
+    _mm256_mask_storeu_epi16(ptr, static_cast<__mmask16>(StoreMask(offset)), v);
+  }
+  void Store(uint16_t* ptr, int32_t offset, __m128i v) const {
+    _mm_mask_storeu_epi16(ptr, static_cast<__mmask8>(StoreMask(offset)), v);
+  }
+  void Store(int32_t* ptr, int32_t offset, __m512i v) const {
+    _mm512_mask_storeu_epi32(ptr, static_cast<__mmask16>(StoreMask(offset)), v);
+  }
+};
+
+// 1x1: 行ごとにコピーする．ROIのstepを考慮し，行末はマスクで処理する
+inline void CopyRows_Avx512(const cv::Mat& src, cv::Mat& dst, bool streaming_store) {
+  constexpr int32_t stride = 512 / 8 / sizeof(uint16_t);
+  const int32_t simd_end   = src.cols / stride * stride;
+  for (auto y : std::views::iota(0, src.rows)) {
+    const uint16_t* sptry = src.ptr<uint16_t>(y);
+    uint16_t* dptry       = dst.ptr<uint16_t>(y);
+    auto process          = [&](int32_t x, const auto& lanes) {
+      lanes.Store(dptry + x, 0, lanes.Load(sptry + x, 0));
+    };
+    int32_t x = ProcessFullLanes(simd_end, stride, UseStreamingStore(streaming_store, dptry), process);
+    if (x < src.cols) {
+      process(x, TailLanes{src.cols - x, src.cols - x});
+    }
+  }
+}
@@ -0,0 +1,400 @@
+#include "binning.h"
+#include "binning_pixel.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <print>
+#include <ranges>
+#include <type_traits>
+
+#include <immintrin.h>
+#include <opencv2/core/core.hpp>
+
+template<>
+void Binning<Impl::Avx2>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
+}
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y>
+void Binning<Impl::Avx2>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
+  static_assert(BINNING_X == 1 || BINNING_X == 2 || BINNING_X == 4);
+
+  assert(src.cols / BINNING_X == dst.cols);
+  assert(src.rows / BINNING_Y == dst.rows);
+  assert(src.type() == CV_16UC1);
+  assert(src.type() == CV_16UC1);
+
+  constexpr int32_t stride = 256 / 8 / sizeof(uint16_t);
+  const int32_t src_step1  = src.step1();
+  const int32_t simd_end   = dst.cols / stride * stride;
+
+  const __m256i mask2       = _mm256_set1_epi32(0x0000FFFF);
+  const __m256i mask4       = _mm256_set1_epi64x(0x000000000000FFFF);
+  const __m256i permute_idx = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+  for (auto y : std::views::iota(0, dst.rows)) {
+    const uint16_t* sptry = src.ptr<uint16_t>(y * BINNING_Y);
+    uint16_t* dptry       = dst.ptr<uint16_t>(y);
+
+    for (int32_t x = 0; x < simd_end; x += stride) {
+      const uint16_t* sptryx = sptry + x * BINNING_X;
+
+      __m256i acc[BINNING_X];
+#pragma GCC unroll 4
+      for (uint32_t i = 0; i < BINNING_X; i++) {
+        acc[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptryx + stride * i));
+      }
+#pragma GCC unroll 8
+      for (uint32_t y_b = 1; y_b < BINNING_Y; y_b++) {
+#pragma GCC unroll 4
+        for (uint32_t i = 0; i < BINNING_X; i++) {
+          __m256i sv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptryx + src_step1 * y_b + stride * i));
+          acc[i]     = _mm256_adds_epu16(acc[i], sv);
+        }
+      }
+
+      __m256i ret;
+      if constexpr (BINNING_X == 1) {
+        ret = acc[0];
+      } else if constexpr (BINNING_X == 2) {
+        // 偶数レーンに2画素の和を作りuint32_tとしてpackusで詰める
+        acc[0] = _mm256_and_si256(_mm256_adds_epu16(acc[0], _mm256_srli_epi32(acc[0], 16)), mask2);
+        acc[1] = _mm256_and_si256(_mm256_adds_epu16(acc[1], _mm256_srli_epi32(acc[1], 16)), mask2);
+        ret    = _mm256_packus_epi32(acc[0], acc[1]);
+        ret    = _mm256_permute4x64_epi64(ret, _MM_SHUFFLE(3, 1, 2, 0));
+      } else if constexpr (BINNING_X == 4) {
+#pragma GCC unroll 4
+        for (uint32_t i = 0; i < BINNING_X; i++) {
+          acc[i] = _mm256_adds_epu16(acc[i], _mm256_srli_epi32(acc[i], 16));
+          acc[i] = _mm256_and_si256(_mm256_adds_epu16(acc[i], _mm256_srli_epi64(acc[i], 32)), mask4);
+        }
+        __m256i ab = _mm256_packus_epi32(acc[0], acc[1]);
+        __m256i cd = _mm256_packus_epi32(acc[2], acc[3]);
+        ret        = _mm256_packus_epi32(ab, cd);
+        ret        = _mm256_permutevar8x32_epi32(ret, permute_idx);
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dptry + x), ret);
+    }
+
+    for (auto x : std::views::iota(simd_end, dst.cols)) {
+      uint32_t temp = 0;
+      for (auto y_b : std::views::iota(0u, BINNING_Y)) {
+        const uint16_t* sptryx = src.ptr<uint16_t>(y * BINNING_Y + y_b) + x * BINNING_X;
+        for (auto x_b : std::views::iota(0u, BINNING_X)) {
+          temp += sptryx[x_b];
+        }
+      }
+      dptry[x] = std::min<uint32_t>(temp, std::numeric_limits<uint16_t>::max());
+    }
+  }
+}
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y>
+void Binning<Impl::Avx2>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, OutputMode output_mode) {
+  static_assert(std::has_single_bit(BINNING_X) && BINNING_X <= 8);
+
+  assert(src.cols / BINNING_X == dst.cols);
+  assert(src.rows / BINNING_Y == dst.rows);
+  assert(src.type() == CV_16UC1);
+  assert(dst.type() == (output_mode == OutputMode::WideSum ? CV_32SC1 : CV_16UC1));
+
+  // 出力8画素(uint32_t x 8)ごとに処理する．入力はBINNING_X / 2本のベクトル
+  constexpr int32_t stride      = 256 / 8 / sizeof(uint32_t);
+  constexpr uint32_t num_vec    = std::max(BINNING_X / 2, 1u);
+  constexpr uint32_t num_pixels = BINNING_X * BINNING_Y;
+  const int32_t src_step1       = src.step1();
+  const int32_t simd_end        = dst.cols / stride * stride;
+
+  const __m256i mask2  = _mm256_set1_epi32(0x0000FFFF);
+  const __m256i half   = _mm256_set1_epi32(num_pixels / 2);
+  const __m256 divisor = _mm256_set1_ps(num_pixels);
+
+  auto run = [&]<bool WIDE>() {
+    for (auto y : std::views::iota(0, dst.rows)) {
+      const uint16_t* sptry = src.ptr<uint16_t>(y * BINNING_Y);
+
+      for (int32_t x = 0; x < simd_end; x += stride) {
+        const uint16_t* sptryx = sptry + x * BINNING_X;
+
+        // 縦方向はuint32_tで足すので飽和しない
+        __m256i acc[num_vec] = {};
+#pragma GCC unroll 8
+        for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+          const uint16_t* sptryxb = sptryx + src_step1 * y_b;
+          if constexpr (BINNING_X == 1) {
+            __m128i sv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sptryxb));
+            acc[0]     = _mm256_add_epi32(acc[0], _mm256_cvtepu16_epi32(sv));
+          } else {
+#pragma GCC unroll 4
+            for (uint32_t i = 0; i < num_vec; i++) {
+              __m256i sv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptryxb + stride * 2 * i));
+              sv         = _mm256_add_epi32(_mm256_and_si256(sv, mask2), _mm256_srli_epi32(sv, 16));
+              acc[i]     = _mm256_add_epi32(acc[i], sv);
+            }
+          }
+        }
+        // 隣り合う2画素の和をhaddでまとめ，128bitレーンをまたいだ並びをpermuteで戻す
+#pragma GCC unroll 4
+        for (uint32_t n = num_vec; n > 1; n /= 2) {
+          for (uint32_t i = 0; i < n / 2; i++) {
+            acc[i] = _mm256_hadd_epi32(acc[i * 2], acc[i * 2 + 1]);
+            acc[i] = _mm256_permute4x64_epi64(acc[i], _MM_SHUFFLE(3, 1, 2, 0));
+          }
+        }
+
+        if constexpr (WIDE) {
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst.ptr<int32_t>(y) + x), acc[0]);
+        } else {
+          __m256i ret;
+          if constexpr (std::has_single_bit(num_pixels)) {
+            ret = _mm256_srli_epi32(_mm256_add_epi32(acc[0], half), std::bit_width(num_pixels) - 1);
+          } else {
+            // 和は2^24未満なのでfloatで正確に割れる
+            __m256 q = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(acc[0], half)), divisor);
+            ret      = _mm256_cvttps_epi32(q);
+          }
+          ret = _mm256_permute4x64_epi64(_mm256_packus_epi32(ret, ret), _MM_SHUFFLE(3, 1, 2, 0));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(dst.ptr<uint16_t>(y) + x), _mm256_castsi256_si128(ret));
+        }
+      }
+
+      for (auto x : std::views::iota(simd_end, dst.cols)) {
+        uint32_t temp = 0;
+        for (auto y_b : std::views::iota(0u, BINNING_Y)) {
+          const uint16_t* sptryx = src.ptr<uint16_t>(y * BINNING_Y + y_b) + x * BINNING_X;
+          for (auto x_b : std::views::iota(0u, BINNING_X)) {
+            temp += sptryx[x_b];
+          }
+        }
+        if constexpr (WIDE) {
+          dst.ptr<int32_t>(y)[x] = temp;
+        } else {
+          dst.ptr<uint16_t>(y)[x] = (temp + num_pixels / 2) / num_pixels;
+        }
+      }
+    }
+  };
+
+  if (output_mode == OutputMode::WideSum) {
+    run.template operator()<true>();
+  } else {
+    run.template operator()<false>();
+  }
+}
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y>
+void Binning<Impl::Avx2>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, ColorFilter color_filter) {
+  static_assert(std::has_single_bit(BINNING_X) && BINNING_X <= 8);
+
+  assert(color_filter == ColorFilter::Bayer);
+  assert(src.cols / (2 * BINNING_X) * 2 == dst.cols);
+  assert(src.rows / (2 * BINNING_Y) * 2 == dst.rows);
+  assert(src.type() == CV_16UC1);
+  assert(dst.type() == CV_16UC1);
+
+  // 隣り合う2色(R, G等)をuint32_tの1要素として扱うと，32bit単位のビニングが同じ色どうしの和になる
+  constexpr int32_t stride = 256 / 8 / sizeof(uint16_t);
+  const int32_t src_step2  = src.step1() * 2;
+  const int32_t simd_end   = dst.cols / stride * stride;
+
+  for (auto y : std::views::iota(0, dst.rows)) {
+    const uint16_t* sptry = src.ptr<uint16_t>((y >> 1) * BINNING_Y * 2 + (y & 1));
+    uint16_t* dptry       = dst.ptr<uint16_t>(y);
+
+    for (int32_t x = 0; x < simd_end; x += stride) {
+      const uint16_t* sptryx = sptry + x * BINNING_X;
+
+      __m256i acc[BINNING_X];
+#pragma GCC unroll 8
+      for (uint32_t i = 0; i < BINNING_X; i++) {
+        acc[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptryx + stride * i));
+      }
+#pragma GCC unroll 8
+      for (uint32_t y_b = 1; y_b < BINNING_Y; y_b++) {
+#pragma GCC unroll 8
+        for (uint32_t i = 0; i < BINNING_X; i++) {
+          __m256i sv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptryx + src_step2 * y_b + stride * i));
+          acc[i]     = _mm256_adds_epu16(acc[i], sv);
+        }
+      }
+      // 偶数番目の32bit要素に隣の要素を足し，shuffle_psで2本のベクトルから偶数番目だけを集める
+#pragma GCC unroll 4
+      for (uint32_t n = BINNING_X; n > 1; n /= 2) {
+        for (uint32_t i = 0; i < n / 2; i++) {
+          __m256 a = _mm256_castsi256_ps(_mm256_adds_epu16(acc[i * 2], _mm256_srli_epi64(acc[i * 2], 32)));
+          __m256 b = _mm256_castsi256_ps(_mm256_adds_epu16(acc[i * 2 + 1], _mm256_srli_epi64(acc[i * 2 + 1], 32)));
+          acc[i]   = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+          acc[i]   = _mm256_permute4x64_epi64(acc[i], _MM_SHUFFLE(3, 1, 2, 0));
+        }
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dptry + x), acc[0]);
+    }
+
+    for (auto x : std::views::iota(simd_end, dst.cols)) {
+      uint32_t temp = 0;
+      for (auto y_b : std::views::iota(0u, BINNING_Y)) {
+        const uint16_t* sptryx = sptry + src_step2 * y_b;
+        for (auto x_b : std::views::iota(0u, BINNING_X)) {
+          temp += sptryx[((x >> 1) * BINNING_X + x_b) * 2 + (x & 1)];
+        }
+      }
+      dptry[x] = std::min<uint32_t>(temp, std::numeric_limits<uint16_t>::max());
+    }
+  }
+}
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y, typename T>
+void Binning<Impl::Avx2>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, PixelType<T>) {
+  static_assert(std::has_single_bit(BINNING_X) && BINNING_X <= 8);
+
+  assert(src.cols / BINNING_X == dst.cols);
+  assert(src.rows / BINNING_Y == dst.rows);
+  assert(src.type() == cv::DataType<T>::type);
+  assert(dst.type() == GetOutputType(src.type()));
+
+  constexpr uint32_t num_pixels = BINNING_X * BINNING_Y;
+  const OutputMode output_mode  = output_mode_;
+
+  // int64_tの和はAVX2で割れないので，int32_tの2冪でない画素数の平均はスカラーで処理する
+  if constexpr (std::is_same_v<T, int32_t> && !std::has_single_bit(num_pixels)) {
+    if (output_mode == OutputMode::Average) {
+      for (auto y : std::views::iota(0, dst.rows)) {
+        for (auto x : std::views::iota(0, dst.cols)) {
+          BinPixel<T, BINNING_X, BINNING_Y>(src, dst, y, x, output_mode, ColorFilter::Mono);
+        }
+      }
+      return;
+    }
+  }
+
+  // 出力8画素ごとに処理する．入力は8画素ずつBINNING_X本のベクトルに広げて縦に足し，最後に横の隣どうしを足す
+  constexpr int32_t stride = 256 / 8 / sizeof(uint32_t);
+  const int32_t src_step1  = src.step1();
+  const int32_t simd_end   = dst.cols / stride * stride;
+
+  const __m256i half   = _mm256_set1_epi32(num_pixels / 2);
+  const __m256 divisor = _mm256_set1_ps(num_pixels);
+
+  // floatのAverageは画素ごとに1 / num_pixelsを掛けながらFMAで足す
+  const __m256 scale = _mm256_set1_ps(output_mode == OutputMode::Average ? 1.0f / num_pixels : 1.0f);
+
+  // int32_tのAverage: 和にnum_pixels * 2^31を足して非負にしてから論理シフトし，最上位bitを戻す
+  const __m256i bias64 = _mm256_set1_epi64x(num_pixels / 2 + (int64_t{1} << 31) * num_pixels);
+  const __m256i max64  = _mm256_set1_epi64x(std::numeric_limits<int32_t>::max());
+  const __m256i min64  = _mm256_set1_epi64x(std::numeric_limits<int32_t>::min());
+  const __m256i low32  = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+  const __m128i sign32 = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+
+  for (auto y : std::views::iota(0, dst.rows)) {
+    const T* sptry = src.ptr<T>(y * BINNING_Y);
+
+    for (int32_t x = 0; x < simd_end; x += stride) {
+      const T* sptryx = sptry + x * BINNING_X;
+
+      if constexpr (std::is_same_v<T, uint8_t>) {
+        // uint8_tは8画素ずつint32_tに広げて足す
+        __m256i acc[BINNING_X] = {};
+#pragma GCC unroll 8
+        for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+          const uint8_t* sptryxb = sptryx + src_step1 * y_b;
+#pragma GCC unroll 8
+          for (uint32_t i = 0; i < BINNING_X; i++) {
+            __m128i sv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(sptryxb + stride * i));
+            acc[i]     = _mm256_add_epi32(acc[i], _mm256_cvtepu8_epi32(sv));
+          }
+        }
+#pragma GCC unroll 4
+        for (uint32_t n = BINNING_X; n > 1; n /= 2) {
+          for (uint32_t i = 0; i < n / 2; i++) {
+            acc[i] = _mm256_hadd_epi32(acc[i * 2], acc[i * 2 + 1]);
+            acc[i] = _mm256_permute4x64_epi64(acc[i], _MM_SHUFFLE(3, 1, 2, 0));
+          }
+        }
+
+        if (output_mode == OutputMode::WideSum) {
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst.ptr<int32_t>(y) + x), acc[0]);
+          continue;
+        }
+        __m256i ret = acc[0];
+        if (output_mode == OutputMode::Average) {
+          if constexpr (std::has_single_bit(num_pixels)) {
+            ret = _mm256_srli_epi32(_mm256_add_epi32(ret, half), std::bit_width(num_pixels) - 1);
+          } else {
+            __m256 q = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(ret, half)), divisor);
+            ret      = _mm256_cvttps_epi32(q);
+          }
+        }
+        __m128i ret16 = _mm_packus_epi32(_mm256_castsi256_si128(ret), _mm256_extracti128_si256(ret, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst.ptr<uint8_t>(y) + x), _mm_packus_epi16(ret16, ret16));
+      } else if constexpr (std::is_same_v<T, int32_t>) {
+        // int32_tは4画素ずつint64_tに広げて足す．acc[k]は[4k, 4k + 4)番目の画素
+        __m256i acc[BINNING_X * 2] = {};
+#pragma GCC unroll 8
+        for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+          const int32_t* sptryxb = sptryx + src_step1 * y_b;
+#pragma GCC unroll 8
+          for (uint32_t i = 0; i < BINNING_X; i++) {
+            __m256i sv     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptryxb + stride * i));
+            acc[i * 2]     = _mm256_add_epi64(acc[i * 2], _mm256_cvtepi32_epi64(_mm256_castsi256_si128(sv)));
+            acc[i * 2 + 1] = _mm256_add_epi64(acc[i * 2 + 1], _mm256_cvtepi32_epi64(_mm256_extracti128_si256(sv, 1)));
+          }
+        }
+#pragma GCC unroll 4
+        for (uint32_t n = BINNING_X * 2; n > 2; n /= 2) {
+          for (uint32_t i = 0; i < n / 2; i++) {
+            __m256i a = acc[i * 2];
+            __m256i b = acc[i * 2 + 1];
+            acc[i]    = _mm256_add_epi64(_mm256_unpacklo_epi64(a, b), _mm256_unpackhi_epi64(a, b));
+            acc[i]    = _mm256_permute4x64_epi64(acc[i], _MM_SHUFFLE(3, 1, 2, 0));
+          }
+        }
+
+        __m128i ret[2];
+        for (uint32_t i = 0; i < 2; i++) {
+          __m256i v = acc[i];
+          if (output_mode == OutputMode::Average) {
+            v      = _mm256_srli_epi64(_mm256_add_epi64(v, bias64), std::bit_width(num_pixels) - 1);
+            ret[i] = _mm_xor_si128(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, low32)), sign32);
+          } else {
+            v      = _mm256_blendv_epi8(v, max64, _mm256_cmpgt_epi64(v, max64));
+            v      = _mm256_blendv_epi8(v, min64, _mm256_cmpgt_epi64(min64, v));
+            ret[i] = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, low32));
+          }
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst.ptr<int32_t>(y) + x), _mm256_set_m128i(ret[1], ret[0]));
+      } else {
+        static_assert(std::is_same_v<T, float>);
+        __m256 acc[BINNING_X] = {};
+#pragma GCC unroll 8
+        for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+          const float* sptryxb = sptryx + src_step1 * y_b;
+#pragma GCC unroll 8
+          for (uint32_t i = 0; i < BINNING_X; i++) {
+            acc[i] = _mm256_fmadd_ps(_mm256_loadu_ps(sptryxb + stride * i), scale, acc[i]);
+          }
+        }
+#pragma GCC unroll 4
+        for (uint32_t n = BINNING_X; n > 1; n /= 2) {
+          for (uint32_t i = 0; i < n / 2; i++) {
+            __m256d sum = _mm256_castps_pd(_mm256_hadd_ps(acc[i * 2], acc[i * 2 + 1]));
+            acc[i]      = _mm256_castpd_ps(_mm256_permute4x64_pd(sum, _MM_SHUFFLE(3, 1, 2, 0)));
+          }
+        }
+        _mm256_storeu_ps(dst.ptr<float>(y) + x, acc[0]);
+      }
+    }
+
+    for (auto x : std::views::iota(simd_end, dst.cols)) {
+      BinPixel<T, BINNING_X, BINNING_Y>(src, dst, y, x, output_mode, ColorFilter::Mono);
+    }
+  }
+}
+
+template void Binning<Impl::Avx2>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
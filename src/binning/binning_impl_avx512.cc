@@ -1,6 +1,7 @@
 #pragma GCC target("avx512f,avx512bw,avx512vl")
 
 #include "binning.h"
+#include "binning_avx512.h"
 
 #include <bit>
 #include <cassert>
@@ -12,23 +13,19 @@
 
 template<>
 void Binning<Impl::Avx512>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
-  Execute_Impl(binning_x, binning_y, src, dst);
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
 }
 
 template<>
 template<>
 void Binning<Impl::Avx512>::Execute_Impl<1, 1>(const cv::Mat& src, cv::Mat& dst) {
-  constexpr uint32_t BINNING_X = 1;
-  constexpr uint32_t BINNING_Y = 1;
   assert(src.cols == dst.cols);
   assert(src.rows == dst.rows);
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
-  for (auto y : std::views::iota(0, src.rows)) {
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(512 / 8 / sizeof(uint16_t))) {
-      _mm512_storeu_si512(dst.ptr<uint16_t>(y) + x, _mm512_loadu_si512(reinterpret_cast<const void*>(src.ptr<uint16_t>(y) + x)));
-    }
-  }
+  CopyRows_Avx512(src, dst, streaming_store_);
 }
 
 template<>
@@ -45,17 +42,19 @@ void Binning<Impl::Avx512>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
 
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
-    uint16_t* dptry = dst.ptr<uint16_t>(y >> shift_y);
+  constexpr int32_t stride = 512 / 8 / sizeof(uint16_t);
+  const int32_t src_end    = dst.cols * BINNING_X;
+  const int32_t simd_end   = src_end / stride * stride;
 
-    constexpr int32_t stride = 512 / 8 / sizeof(uint16_t);
+  for (auto y : std::views::iota(0, dst.rows * static_cast<int32_t>(BINNING_Y)) | std::views::stride(BINNING_Y)) {
+    uint16_t* dptry = dst.ptr<uint16_t>(y >> shift_y);
 
     constexpr __mmask32 mask2 = 0b01010101010101010101010101010101;
     constexpr __mmask32 mask4 = 0b00010001000100010001000100010001;
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride)) {
+    auto process              = [&](int32_t x, const auto& lanes) {
       const uint16_t* sptryx = src.ptr<uint16_t>(y + 0) + x;
-      __m512i y0             = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx));
-      __m512i y1             = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src.step1()));
+      __m512i y0             = lanes.Load(sptryx, 0);
+      __m512i y1             = lanes.Load(sptryx + src.step1(), 0);
       __m512i y0_            = _mm512_srli_epi64(y0, 16);
       __m512i y1_            = _mm512_srli_epi64(y1, 16);
       y0                     = _mm512_adds_epu16(y0, y0_);
@@ -63,8 +62,8 @@ void Binning<Impl::Avx512>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
       y0                     = _mm512_maskz_adds_epu16(mask2, y0, y1);
 
       if constexpr (BINNING_Y == 4) {
-        __m512i y2  = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src.step1() * 2));
-        __m512i y3  = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src.step1() * 3));
+        __m512i y2  = lanes.Load(sptryx + src.step1() * 2, 0);
+        __m512i y3  = lanes.Load(sptryx + src.step1() * 3, 0);
         __m512i y2_ = _mm512_srli_epi64(y2, 16);
         __m512i y3_ = _mm512_srli_epi64(y3, 16);
         y2          = _mm512_adds_epu16(y2, y2_);
@@ -74,11 +73,18 @@ void Binning<Impl::Avx512>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
       }
 
       if constexpr (BINNING_X == 2) {
-        _mm512_mask_cvtepi32_storeu_epi16(dptry + (x >> shift_x), 0xFFFF, y0);
+        lanes.Store(dptry + (x >> shift_x), 0, _mm512_cvtepi32_epi16(y0));
       } else if (BINNING_X == 4) {
         y0 = _mm512_maskz_adds_epu16(mask4, y0, _mm512_srli_epi64(y0, 32));
-        _mm512_mask_cvtepi64_storeu_epi16(dptry + (x >> shift_x), 0xFF, y0);
+        lanes.Store(dptry + (x >> shift_x), 0, _mm512_cvtepi64_epi16(y0));
       }
+    };
+
+    int32_t x = ProcessFullLanes(simd_end, stride, UseStreamingStore(streaming_store_, dptry), process);
+    if (x < src_end) {
+      process(x, TailLanes{src_end - x, dst.cols - (x >> shift_x)});
     }
   }
 }
+
+template void Binning<Impl::Avx512>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
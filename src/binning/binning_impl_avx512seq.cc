@@ -1,5 +1,6 @@
 #pragma GCC target("avx512f,avx512bw,avx512vl")
 #include "binning.h"
+#include "binning_avx512.h"
 
 #include <bit>
 #include <cassert>
@@ -11,7 +12,9 @@
 
 template<>
 void Binning<Impl::Avx512Seq>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
-  Execute_Impl(binning_x, binning_y, src, dst);
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
 }
 
 template<>
@@ -21,11 +24,7 @@ void Binning<Impl::Avx512Seq>::Execute_Impl<1, 1>(const cv::Mat& src, cv::Mat& d
   assert(src.rows == dst.rows);
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
-  for (auto y : std::views::iota(0, src.rows)) {
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(512 / 8 / sizeof(uint16_t))) {
-      _mm512_storeu_si512(dst.ptr<uint16_t>(y) + x, _mm512_loadu_si512(reinterpret_cast<const void*>(src.ptr<uint16_t>(y) + x)));
-    }
-  }
+  CopyRows_Avx512(src, dst, streaming_store_);
 }
 
 template<>
@@ -45,27 +44,40 @@ void Binning<Impl::Avx512Seq>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
   constexpr __mmask32 mask2 = 0b01010101010101010101010101010101;
   constexpr __mmask32 mask4 = 0b00010001000100010001000100010001;
   constexpr int32_t stride  = 512 / 8 / sizeof(uint16_t);
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
+  const int32_t src_end     = dst.cols * BINNING_X;
+  const int32_t simd_end    = src_end / stride * stride;
+  for (auto y : std::views::iota(0, dst.rows * static_cast<int32_t>(BINNING_Y)) | std::views::stride(BINNING_Y)) {
     uint16_t* dptry = dst.ptr<uint16_t>(y >> shift_y);
-    std::memset(dptry, 0, dst.step);
+    std::memset(dptry, 0, dst.cols * sizeof(uint16_t));
     int32_t y_b = 0;
     for (; y_b < BINNING_Y; y_b++) {
       const uint16_t* sptry = src.ptr<uint16_t>(y + y_b);
-      for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride)) {
-        __m512i sv = _mm512_loadu_si512(reinterpret_cast<const void*>(sptry + x));
+      auto process          = [&](int32_t x, const auto& lanes) {
+        __m512i sv = lanes.Load(sptry + x, 0);
         if constexpr (BINNING_X == 2) {
-          __m256i dv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dptry + (x >> shift_x)));
+          __m256i dv = _mm256_maskz_loadu_epi16(static_cast<__mmask16>(lanes.StoreMask(0)), dptry + (x >> shift_x));
           sv         = _mm512_maskz_adds_epu16(mask2, sv, _mm512_srli_epi64(sv, 16));
           dv         = _mm256_adds_epu16(dv, _mm512_cvtepi32_epi16(sv));
-          _mm256_storeu_si256(reinterpret_cast<__m256i*>(dptry + (x >> shift_x)), dv);
+          lanes.Store(dptry + (x >> shift_x), 0, dv);
         } else if constexpr (BINNING_X == 4) {
-          __m128i dv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dptry + (x >> shift_x)));
+          __m128i dv = _mm_maskz_loadu_epi16(static_cast<__mmask8>(lanes.StoreMask(0)), dptry + (x >> shift_x));
           sv         = _mm512_maskz_adds_epu16(mask2, sv, _mm512_srli_epi64(sv, 16));
           sv         = _mm512_maskz_adds_epu16(mask4, sv, _mm512_srli_epi64(sv, 32));
           dv         = _mm_adds_epu16(dv, _mm512_cvtepi64_epi16(sv));
-          _mm_storeu_si128(reinterpret_cast<__m128i*>(dptry + (x >> shift_x)), dv);
+          lanes.Store(dptry + (x >> shift_x), 0, dv);
         }
+      };
+
+      // dptryはy_bごとに読み直してキャッシュ上にあるので，非テンポラルストアは使わない
+      int32_t x = 0;
+      for (; x < simd_end; x += stride) {
+        process(x, FullLanes{});
+      }
+      if (x < src_end) {
+        process(x, TailLanes{src_end - x, dst.cols - (x >> shift_x)});
       }
     }
   }
 }
+
+template void Binning<Impl::Avx512Seq>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
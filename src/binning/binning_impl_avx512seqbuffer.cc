@@ -1,5 +1,6 @@
 #pragma GCC target("avx512f,avx512bw,avx512vl")
 #include "binning.h"
+#include "binning_avx512.h"
 
 #include <bit>
 #include <cassert>
@@ -12,7 +13,9 @@
 
 template<>
 void Binning<Impl::Avx512SeqBuffer>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
-  Execute_Impl(binning_x, binning_y, src, dst);
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
 }
 
 template<>
@@ -22,11 +25,7 @@ void Binning<Impl::Avx512SeqBuffer>::Execute_Impl<1, 1>(const cv::Mat& src, cv::
   assert(src.rows == dst.rows);
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
-  for (auto y : std::views::iota(0, src.rows)) {
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(512 / 8 / sizeof(uint16_t))) {
-      _mm512_storeu_si512(dst.ptr<uint16_t>(y) + x, _mm512_loadu_si512(reinterpret_cast<const void*>(src.ptr<uint16_t>(y) + x)));
-    }
-  }
+  CopyRows_Avx512(src, dst, streaming_store_);
 }
 
 template<>
@@ -47,14 +46,26 @@ void Binning<Impl::Avx512SeqBuffer>::Execute_Impl(const cv::Mat& src, cv::Mat& d
   constexpr __mmask32 mask4 = 0b00010001000100010001000100010001;
   constexpr int32_t stride  = 512 / 8 / sizeof(uint16_t);
 
-  cv::Mat buffer = cv::Mat(cv::Size(src.cols, 1), CV_16UC1);
+  const int32_t src_end     = dst.cols * BINNING_X;
+  const int32_t simd_end    = src_end / stride * stride;
+
+  // bufferはベクトル幅に切り上げておき，行末でもマスクなしで読み書きする
+  cv::Mat buffer = cv::Mat(cv::Size((src_end + stride - 1) / stride * stride, 1), CV_16UC1);
   uint16_t* bptr = buffer.ptr<uint16_t>();
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
+  // bufferへの書き込みは通常のストアなので，streamはdstに書き込む最後の行だけで使う
+  auto for_each_block = [&](bool stream, auto&& process) {
+    int32_t x = ProcessFullLanes(simd_end, stride, stream, process);
+    if (x < src_end) {
+      process(x, TailLanes{src_end - x, dst.cols - (x >> shift_x)});
+    }
+  };
+
+  for (auto y : std::views::iota(0, dst.rows * static_cast<int32_t>(BINNING_Y)) | std::views::stride(BINNING_Y)) {
     int32_t y_b = 0;
     if constexpr (BINNING_Y >= 2) {
       const uint16_t* sptry = src.ptr<uint16_t>(y + y_b);
-      for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride)) {
-        __m512i sv = _mm512_loadu_si512(reinterpret_cast<const void*>(sptry + x));
+      for_each_block(false, [&](int32_t x, const auto& lanes) {
+        __m512i sv = lanes.Load(sptry + x, 0);
         if constexpr (BINNING_X == 2) {
           sv = _mm512_maskz_adds_epu16(mask2, sv, _mm512_srli_epi64(sv, 16));
         } else if constexpr (BINNING_X == 4) {
@@ -62,11 +73,11 @@ void Binning<Impl::Avx512SeqBuffer>::Execute_Impl(const cv::Mat& src, cv::Mat& d
           sv = _mm512_maskz_adds_epu16(mask4, sv, _mm512_srli_epi64(sv, 32));
         }
         _mm512_storeu_si512(bptr + x, sv);
-      }
+      });
       for (y_b = 1; y_b < BINNING_Y - 1; y_b++) {
         const uint16_t* sptry = src.ptr<uint16_t>(y + y_b);
-        for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride)) {
-          __m512i sv = _mm512_loadu_si512(reinterpret_cast<const void*>(sptry + x));
+        for_each_block(false, [&](int32_t x, const auto& lanes) {
+          __m512i sv = lanes.Load(sptry + x, 0);
           __m512i bv = _mm512_loadu_si512(reinterpret_cast<const void*>(bptr + x));
           if constexpr (BINNING_X == 2) {
             sv = _mm512_maskz_adds_epu16(mask2, sv, _mm512_srli_epi64(sv, 16));
@@ -76,14 +87,14 @@ void Binning<Impl::Avx512SeqBuffer>::Execute_Impl(const cv::Mat& src, cv::Mat& d
           }
           bv = _mm512_adds_epu16(bv, sv);
           _mm512_storeu_si512(bptr + x, bv);
-        }
+        });
       }
     }
     {
       uint16_t* dptry       = dst.ptr<uint16_t>(y >> shift_y);
       const uint16_t* sptry = src.ptr<uint16_t>(y + y_b);
-      for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride)) {
-        __m512i sv = _mm512_loadu_si512(reinterpret_cast<const void*>(sptry + x));
+      for_each_block(UseStreamingStore(streaming_store_, dptry), [&](int32_t x, const auto& lanes) {
+        __m512i sv = lanes.Load(sptry + x, 0);
         __m512i bv;
         if constexpr (BINNING_Y == 1) {
           bv = _mm512_setzero_si512();
@@ -92,18 +103,20 @@ void Binning<Impl::Avx512SeqBuffer>::Execute_Impl(const cv::Mat& src, cv::Mat& d
         }
         if constexpr (BINNING_X == 1) {
           bv = _mm512_adds_epu16(bv, sv);
-          _mm512_storeu_si512(dptry + (x >> shift_x), bv);
+          lanes.Store(dptry + (x >> shift_x), 0, bv);
         } else if constexpr (BINNING_X == 2) {
           sv = _mm512_maskz_adds_epu16(mask2, sv, _mm512_srli_epi64(sv, 16));
           bv = _mm512_adds_epu16(bv, sv);
-          _mm256_storeu_si256(reinterpret_cast<__m256i*>(dptry + (x >> shift_x)), _mm512_cvtepi32_epi16(bv));
+          lanes.Store(dptry + (x >> shift_x), 0, _mm512_cvtepi32_epi16(bv));
         } else if constexpr (BINNING_X == 4) {
           sv = _mm512_maskz_adds_epu16(mask2, sv, _mm512_srli_epi64(sv, 16));
           sv = _mm512_maskz_adds_epu16(mask4, sv, _mm512_srli_epi64(sv, 32));
           bv = _mm512_adds_epu16(bv, sv);
-          _mm_storeu_si128(reinterpret_cast<__m128i*>(dptry + (x >> shift_x)), _mm512_cvtepi64_epi16(bv));
+          lanes.Store(dptry + (x >> shift_x), 0, _mm512_cvtepi64_epi16(bv));
         }
-      }
+      });
     }
   }
 }
+
+template void Binning<Impl::Avx512SeqBuffer>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
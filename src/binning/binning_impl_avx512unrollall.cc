@@ -1,22 +1,133 @@
 #pragma GCC target("avx512f,avx512bw,avx512vl")
 #include "binning.h"
+#include "binning_avx512.h"
+#include "binning_pixel.h"
 
+#include <algorithm>
+#include <array>
 #include <bit>
 #include <cassert>
 #include <print>
 #include <ranges>
+#include <type_traits>
 
 #include <immintrin.h>
 #include <opencv2/core/core.hpp>
 
 template<>
 void Binning<Impl::Avx512UnrollAll>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
-  Execute_Impl(binning_x, binning_y, src, dst);
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
 }
 
+namespace {
+// BINNING_X本のベクトル(32 * BINNING_X要素)から，出力レーンjへj * BINNING_X + k番目の要素を集める
+// vpermt2wのインデックスとベクトル対ごとの書き込みマスク
+template<uint32_t BINNING_X>
+struct GatherTable {
+  std::array<std::array<uint16_t, 32>, BINNING_X> idx;
+  std::array<std::array<__mmask32, (BINNING_X + 1) / 2>, BINNING_X> mask;
+};
+
+template<uint32_t BINNING_X>
+constexpr GatherTable<BINNING_X> MakeGatherTable() {
+  GatherTable<BINNING_X> table{};
+  for (uint32_t k = 0; k < BINNING_X; k++) {
+    for (uint32_t j = 0; j < 32; j++) {
+      const uint32_t s   = j * BINNING_X + k;
+      table.idx[k][j]    = s & 63;
+      table.mask[k][s >> 6] |= 1u << j;
+    }
+  }
+  return table;
+}
+} // namespace
+
 template<>
 template<uint32_t BINNING_X, uint32_t BINNING_Y>
-void Binning<Impl::Avx512UnrollAll>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {}
+void Binning<Impl::Avx512UnrollAll>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
+  assert(src.cols / BINNING_X == dst.cols);
+  assert(src.rows / BINNING_Y == dst.rows);
+  assert(src.type() == CV_16UC1);
+  assert(src.type() == CV_16UC1);
+
+  constexpr int32_t stride    = 512 / 8 / sizeof(uint16_t);
+  constexpr uint32_t num_pair = (BINNING_X + 1) / 2;
+  // 2のべき乗はベクトル内のシフト加算で水平方向をまとめ，各グループの先頭レーンだけを集める
+  constexpr bool shift_reduce   = std::has_single_bit(BINNING_X);
+  constexpr uint32_t num_gather = shift_reduce ? 1 : BINNING_X;
+  static constexpr auto table   = MakeGatherTable<BINNING_X>();
+
+  const int32_t src_step1 = src.step1();
+  const int32_t simd_end  = dst.cols / stride * stride;
+
+  __m512i idx[num_gather];
+  for (auto k : std::views::iota(0u, num_gather)) {
+    idx[k] = _mm512_loadu_si512(reinterpret_cast<const void*>(table.idx[k].data()));
+  }
+
+  for (auto y : std::views::iota(0, dst.rows)) {
+    const uint16_t* sptry = src.ptr<uint16_t>(y * BINNING_Y);
+    uint16_t* dptry       = dst.ptr<uint16_t>(y);
+
+    auto process = [&](int32_t x, const auto& lanes) {
+      const uint16_t* sptryx = sptry + x * BINNING_X;
+
+      __m512i acc[BINNING_X];
+#pragma GCC unroll 8
+      for (uint32_t i = 0; i < BINNING_X; i++) {
+        acc[i] = lanes.Load(sptryx + stride * i, stride * i);
+      }
+#pragma GCC unroll 8
+      for (uint32_t y_b = 1; y_b < BINNING_Y; y_b++) {
+#pragma GCC unroll 8
+        for (uint32_t i = 0; i < BINNING_X; i++) {
+          __m512i sv = lanes.Load(sptryx + src_step1 * y_b + stride * i, stride * i);
+          acc[i]     = _mm512_adds_epu16(acc[i], sv);
+        }
+      }
+
+      if constexpr (BINNING_X == 1) {
+        lanes.Store(dptry + x, 0, acc[0]);
+        return;
+      }
+
+      if constexpr (shift_reduce) {
+#pragma GCC unroll 8
+        for (uint32_t i = 0; i < BINNING_X; i++) {
+          acc[i] = _mm512_adds_epu16(acc[i], _mm512_srli_epi64(acc[i], 16));
+          if constexpr (BINNING_X >= 4) {
+            acc[i] = _mm512_adds_epu16(acc[i], _mm512_srli_epi64(acc[i], 32));
+          }
+          if constexpr (BINNING_X >= 8) {
+            acc[i] = _mm512_adds_epu16(acc[i], _mm512_bsrli_epi128(acc[i], 8));
+          }
+        }
+      }
+
+      __m512i ret = _mm512_setzero_si512();
+#pragma GCC unroll 8
+      for (uint32_t k = 0; k < num_gather; k++) {
+        __m512i gathered = _mm512_setzero_si512();
+#pragma GCC unroll 4
+        for (uint32_t p = 0; p < num_pair; p++) {
+          const __m512i lo = acc[p * 2];
+          const __m512i hi = acc[std::min(p * 2 + 1, BINNING_X - 1)];
+          gathered = _mm512_or_si512(gathered, _mm512_maskz_permutex2var_epi16(table.mask[k][p], lo, idx[k], hi));
+        }
+        ret = _mm512_adds_epu16(ret, gathered);
+      }
+      lanes.Store(dptry + x, 0, ret);
+    };
+
+    int32_t x = ProcessFullLanes(simd_end, stride, UseStreamingStore(streaming_store_, dptry), process);
+    // 行末の端数はマスク付きで処理する(ROIの外は読み書きしない)
+    if (x < dst.cols) {
+      process(x, TailLanes{(dst.cols - x) * static_cast<int32_t>(BINNING_X), dst.cols - x});
+    }
+  }
+}
 
 template<>
 template<>
@@ -25,11 +136,7 @@ void Binning<Impl::Avx512UnrollAll>::Execute_Impl<1, 1>(const cv::Mat& src, cv::
   assert(src.rows == dst.rows);
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
-  for (auto y : std::views::iota(0, src.rows)) {
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(512 / 8 / sizeof(uint16_t))) {
-      _mm512_storeu_si512(dst.ptr<uint16_t>(y) + x, _mm512_loadu_si512(reinterpret_cast<const void*>(src.ptr<uint16_t>(y) + x)));
-    }
-  }
+  CopyRows_Avx512(src, dst, streaming_store_);
 }
 
 template<>
@@ -48,23 +155,24 @@ void Binning<Impl::Avx512UnrollAll>::Execute_Impl<2, 2>(const cv::Mat& src, cv::
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
 
-  const int32_t src_step1 = src.step1();
+  constexpr int32_t stride = 512 / 8 / sizeof(uint16_t);
+  const int32_t src_step1  = src.step1();
+  const int32_t src_end    = dst.cols * BINNING_X;
+  const int32_t simd_end   = src_end / (stride << 1) * (stride << 1);
 
   const __m512i idx = _mm512_set_epi16(32 | 30, 32 | 28, 32 | 26, 32 | 24, 32 | 22, 32 | 20, 32 | 18, 32 | 16, 32 | 14,
                                        32 | 12, 32 | 10, 32 | 8, 32 | 6, 32 | 4, 32 | 2, 32 | 0, 30, 28, 26, 24, 22, 20,
                                        18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
+  for (auto y : std::views::iota(0, dst.rows * static_cast<int32_t>(BINNING_Y)) | std::views::stride(BINNING_Y)) {
     uint16_t* dptry = dst.ptr<uint16_t>(y >> shift_y);
 
-    constexpr int32_t stride = 512 / 8 / sizeof(uint16_t);
-
     constexpr __mmask32 mask2 = 0b01010101010101010101010101010101;
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride << 1)) {
+    auto process = [&](int32_t x, const auto& lanes) {
       const uint16_t* sptryx = src.ptr<uint16_t>(y + 0) + x;
-      __m512i y0_0           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx));
-      __m512i y0_1           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + stride));
-      __m512i y1_0           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step1));
-      __m512i y1_1           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step1 + stride));
+      __m512i y0_0           = lanes.Load(sptryx, 0);
+      __m512i y0_1           = lanes.Load(sptryx + stride, stride);
+      __m512i y1_0           = lanes.Load(sptryx + src_step1, 0);
+      __m512i y1_1           = lanes.Load(sptryx + src_step1 + stride, stride);
       __m512i y0_0s          = _mm512_srli_epi64(y0_0, 16);
       __m512i y0_1s          = _mm512_srli_epi64(y0_1, 16);
       __m512i y1_0s          = _mm512_srli_epi64(y1_0, 16);
@@ -77,7 +185,12 @@ void Binning<Impl::Avx512UnrollAll>::Execute_Impl<2, 2>(const cv::Mat& src, cv::
       y0_1                   = _mm512_maskz_adds_epu16(mask2, y0_1, y1_1);
 
       y0_0 = _mm512_permutex2var_epi16(y0_0, idx, y0_1); // vpermi2w vpermt2w 7/2
-      _mm512_storeu_si512(dptry + (x >> shift_x), y0_0);
+      lanes.Store(dptry + (x >> shift_x), 0, y0_0);
+    };
+
+    int32_t x = ProcessFullLanes(simd_end, stride << 1, UseStreamingStore(streaming_store_, dptry), process);
+    if (x < src_end) {
+      process(x, TailLanes{src_end - x, dst.cols - (x >> shift_x)});
     }
   }
 }
@@ -104,25 +217,27 @@ void Binning<Impl::Avx512UnrollAll>::Execute_Impl<4, 4>(const cv::Mat& src, cv::
   const int32_t src_step1   = src.step1();
   const int32_t src_step2   = src.step1() * 2;
   const int32_t src_step3   = src.step1() * 3;
+  const int32_t src_end     = dst.cols * BINNING_X;
+  const int32_t simd_end    = src_end / (stride1 << 2) * (stride1 << 2);
 
   const __m512i idx = _mm512_set_epi16(32 | 30, 32 | 28, 32 | 22, 32 | 20, 32 | 14, 32 | 12, 32 | 6, 32 | 4, 32 | 26,
                                        32 | 24, 32 | 18, 32 | 16, 32 | 10, 32 | 8, 32 | 2, 32 | 0, 30, 28, 22, 20, 14,
                                        12, 6, 4, 26, 24, 18, 16, 10, 8, 2, 0);
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
+  for (auto y : std::views::iota(0, dst.rows * static_cast<int32_t>(BINNING_Y)) | std::views::stride(BINNING_Y)) {
     uint16_t* dptry = dst.ptr<uint16_t>(y >> shift_y);
 
     constexpr __mmask32 mask2 = 0b01010101010101010101010101010101;
     constexpr __mmask32 mask4 = 0b00010001000100010001000100010001;
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride1 << 2)) {
+    auto process = [&](int32_t x, const auto& lanes) {
       const uint16_t* sptryx = src.ptr<uint16_t>(y + 0) + x;
-      __m512i y0_0           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx));
-      __m512i y0_1           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + stride1));
-      __m512i y0_2           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + stride2));
-      __m512i y0_3           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + stride3));
-      __m512i y1_0           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step1));
-      __m512i y1_1           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step1 + stride1));
-      __m512i y1_2           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step1 + stride2));
-      __m512i y1_3           = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step1 + stride3));
+      __m512i y0_0           = lanes.Load(sptryx, 0);
+      __m512i y0_1           = lanes.Load(sptryx + stride1, stride1);
+      __m512i y0_2           = lanes.Load(sptryx + stride2, stride2);
+      __m512i y0_3           = lanes.Load(sptryx + stride3, stride3);
+      __m512i y1_0           = lanes.Load(sptryx + src_step1, 0);
+      __m512i y1_1           = lanes.Load(sptryx + src_step1 + stride1, stride1);
+      __m512i y1_2           = lanes.Load(sptryx + src_step1 + stride2, stride2);
+      __m512i y1_3           = lanes.Load(sptryx + src_step1 + stride3, stride3);
 
       __m512i y0_0s = _mm512_srli_epi64(y0_0, 16);
       __m512i y0_1s = _mm512_srli_epi64(y0_1, 16);
@@ -146,14 +261,14 @@ void Binning<Impl::Avx512UnrollAll>::Execute_Impl<4, 4>(const cv::Mat& src, cv::
       __m512i y0_2t = _mm512_adds_epu16(y0_2, y1_2);
       __m512i y0_3t = _mm512_adds_epu16(y0_3, y1_3);
 
-      y0_0 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step2));
-      y0_1 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step2 + stride1));
-      y0_2 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step2 + stride2));
-      y0_3 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step2 + stride3));
-      y1_0 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step3));
-      y1_1 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step3 + stride1));
-      y1_2 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step3 + stride2));
-      y1_3 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + src_step3 + stride3));
+      y0_0 = lanes.Load(sptryx + src_step2, 0);
+      y0_1 = lanes.Load(sptryx + src_step2 + stride1, stride1);
+      y0_2 = lanes.Load(sptryx + src_step2 + stride2, stride2);
+      y0_3 = lanes.Load(sptryx + src_step2 + stride3, stride3);
+      y1_0 = lanes.Load(sptryx + src_step3, 0);
+      y1_1 = lanes.Load(sptryx + src_step3 + stride1, stride1);
+      y1_2 = lanes.Load(sptryx + src_step3 + stride2, stride2);
+      y1_3 = lanes.Load(sptryx + src_step3 + stride3, stride3);
 
       y0_0s = _mm512_srli_epi64(y0_0, 16);
       y0_1s = _mm512_srli_epi64(y0_1, 16);
@@ -186,7 +301,305 @@ void Binning<Impl::Avx512UnrollAll>::Execute_Impl<4, 4>(const cv::Mat& src, cv::
       y0_2t = _mm512_packus_epi32(y0_2t, y0_3t);
 
       y0_0t = _mm512_permutex2var_epi16(y0_0t, idx, y0_2t); // vpermi2w vpermt2w 7/2
-      _mm512_storeu_si512(dptry + (x >> shift_x), y0_0t);
+      lanes.Store(dptry + (x >> shift_x), 0, y0_0t);
+    };
+
+    int32_t x = ProcessFullLanes(simd_end, stride1 << 2, UseStreamingStore(streaming_store_, dptry), process);
+    if (x < src_end) {
+      process(x, TailLanes{src_end - x, dst.cols - (x >> shift_x)});
     }
   }
 }
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y>
+void Binning<Impl::Avx512UnrollAll>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, OutputMode output_mode) {
+  static_assert(std::has_single_bit(BINNING_X) && BINNING_X <= 8);
+
+  assert(src.cols / BINNING_X == dst.cols);
+  assert(src.rows / BINNING_Y == dst.rows);
+  assert(src.type() == CV_16UC1);
+  assert(dst.type() == (output_mode == OutputMode::WideSum ? CV_32SC1 : CV_16UC1));
+
+  // 出力16画素(uint32_t x 16)ごとに処理する．入力はBINNING_X / 2本のベクトル
+  constexpr int32_t stride      = 512 / 8 / sizeof(uint32_t);
+  constexpr uint32_t num_vec    = std::max(BINNING_X / 2, 1u);
+  constexpr uint32_t num_pixels = BINNING_X * BINNING_Y;
+  const int32_t src_step1       = src.step1();
+  const int32_t simd_end        = dst.cols / stride * stride;
+
+  const __m512i mask2  = _mm512_set1_epi32(0x0000FFFF);
+  const __m512i half   = _mm512_set1_epi32(num_pixels / 2);
+  const __m512 divisor = _mm512_set1_ps(num_pixels);
+  const __m512i idx    = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+
+  auto run = [&]<bool WIDE>() {
+    for (auto y : std::views::iota(0, dst.rows)) {
+      const uint16_t* sptry = src.ptr<uint16_t>(y * BINNING_Y);
+
+      auto process = [&](int32_t x, const auto& lanes) {
+        const uint16_t* sptryx = sptry + x * BINNING_X;
+
+        // 縦方向はuint32_tで足すので飽和しない
+        __m512i acc[num_vec] = {};
+#pragma GCC unroll 8
+        for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+          const uint16_t* sptryxb = sptryx + src_step1 * y_b;
+          if constexpr (BINNING_X == 1) {
+            __m256i sv = _mm256_maskz_loadu_epi16(static_cast<__mmask16>(lanes.LoadMask(0)), sptryxb);
+            acc[0]     = _mm512_add_epi32(acc[0], _mm512_cvtepu16_epi32(sv));
+          } else {
+#pragma GCC unroll 4
+            for (uint32_t i = 0; i < num_vec; i++) {
+              __m512i sv = lanes.Load(sptryxb + stride * 2 * i, stride * 2 * i);
+              sv         = _mm512_add_epi32(_mm512_and_si512(sv, mask2), _mm512_srli_epi32(sv, 16));
+              acc[i]     = _mm512_add_epi32(acc[i], sv);
+            }
+          }
+        }
+        // 偶数レーンに隣り合う2要素の和を作り，2本のベクトルから偶数レーンだけを集める
+#pragma GCC unroll 4
+        for (uint32_t n = num_vec; n > 1; n /= 2) {
+          for (uint32_t i = 0; i < n / 2; i++) {
+            __m512i a = _mm512_add_epi32(acc[i * 2], _mm512_srli_epi64(acc[i * 2], 32));
+            __m512i b = _mm512_add_epi32(acc[i * 2 + 1], _mm512_srli_epi64(acc[i * 2 + 1], 32));
+            acc[i]    = _mm512_permutex2var_epi32(a, idx, b);
+          }
+        }
+
+        if constexpr (WIDE) {
+          lanes.Store(dst.ptr<int32_t>(y) + x, 0, acc[0]);
+        } else {
+          __m512i ret;
+          if constexpr (std::has_single_bit(num_pixels)) {
+            ret = _mm512_srli_epi32(_mm512_add_epi32(acc[0], half), std::bit_width(num_pixels) - 1);
+          } else {
+            // 和は2^24未満なのでfloatで正確に割れる
+            __m512 q = _mm512_div_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(acc[0], half)), divisor);
+            ret      = _mm512_cvttps_epi32(q);
+          }
+          lanes.Store(dst.ptr<uint16_t>(y) + x, 0, _mm512_cvtepi32_epi16(ret));
+        }
+      };
+
+      const bool stream = UseStreamingStore(streaming_store_, dst.ptr(y));
+      int32_t x         = ProcessFullLanes(simd_end, stride, stream, process);
+      if (x < dst.cols) {
+        process(x, TailLanes{(dst.cols - x) * static_cast<int32_t>(BINNING_X), dst.cols - x});
+      }
+    }
+  };
+
+  if (output_mode == OutputMode::WideSum) {
+    run.template operator()<true>();
+  } else {
+    run.template operator()<false>();
+  }
+}
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y>
+void Binning<Impl::Avx512UnrollAll>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, ColorFilter color_filter) {
+  static_assert(std::has_single_bit(BINNING_X) && BINNING_X <= 8);
+
+  assert(color_filter == ColorFilter::Bayer);
+  assert(src.cols / (2 * BINNING_X) * 2 == dst.cols);
+  assert(src.rows / (2 * BINNING_Y) * 2 == dst.rows);
+  assert(src.type() == CV_16UC1);
+  assert(dst.type() == CV_16UC1);
+
+  // 隣り合う2色(R, G等)をuint32_tの1要素として扱うと，32bit単位のビニングが同じ色どうしの和になる
+  constexpr int32_t stride = 512 / 8 / sizeof(uint16_t);
+  const int32_t src_step2  = src.step1() * 2;
+  const int32_t simd_end   = dst.cols / stride * stride;
+
+  const __m512i idx = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+
+  for (auto y : std::views::iota(0, dst.rows)) {
+    const uint16_t* sptry = src.ptr<uint16_t>((y >> 1) * BINNING_Y * 2 + (y & 1));
+    uint16_t* dptry       = dst.ptr<uint16_t>(y);
+
+    auto process = [&](int32_t x, const auto& lanes) {
+      const uint16_t* sptryx = sptry + x * BINNING_X;
+
+      __m512i acc[BINNING_X];
+#pragma GCC unroll 8
+      for (uint32_t i = 0; i < BINNING_X; i++) {
+        acc[i] = lanes.Load(sptryx + stride * i, stride * i);
+      }
+#pragma GCC unroll 8
+      for (uint32_t y_b = 1; y_b < BINNING_Y; y_b++) {
+#pragma GCC unroll 8
+        for (uint32_t i = 0; i < BINNING_X; i++) {
+          __m512i sv = lanes.Load(sptryx + src_step2 * y_b + stride * i, stride * i);
+          acc[i]     = _mm512_adds_epu16(acc[i], sv);
+        }
+      }
+      // 偶数番目の32bit要素に隣の要素を足し，2本のベクトルから偶数番目だけを集める
+#pragma GCC unroll 4
+      for (uint32_t n = BINNING_X; n > 1; n /= 2) {
+        for (uint32_t i = 0; i < n / 2; i++) {
+          __m512i a = _mm512_adds_epu16(acc[i * 2], _mm512_srli_epi64(acc[i * 2], 32));
+          __m512i b = _mm512_adds_epu16(acc[i * 2 + 1], _mm512_srli_epi64(acc[i * 2 + 1], 32));
+          acc[i]    = _mm512_permutex2var_epi32(a, idx, b);
+        }
+      }
+      lanes.Store(dptry + x, 0, acc[0]);
+    };
+
+    int32_t x = ProcessFullLanes(simd_end, stride, UseStreamingStore(streaming_store_, dptry), process);
+    if (x < dst.cols) {
+      process(x, TailLanes{(dst.cols - x) * static_cast<int32_t>(BINNING_X), dst.cols - x});
+    }
+  }
+}
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y, typename T>
+void Binning<Impl::Avx512UnrollAll>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, PixelType<T>) {
+  static_assert(std::has_single_bit(BINNING_X) && BINNING_X <= 8);
+
+  assert(src.cols / BINNING_X == dst.cols);
+  assert(src.rows / BINNING_Y == dst.rows);
+  assert(src.type() == cv::DataType<T>::type);
+  assert(dst.type() == GetOutputType(src.type()));
+
+  constexpr uint32_t num_pixels = BINNING_X * BINNING_Y;
+  const OutputMode output_mode  = output_mode_;
+
+  // int64_tの除算(AVX512DQ)は使わないので，int32_tの2冪でない画素数の平均はスカラーで処理する
+  if constexpr (std::is_same_v<T, int32_t> && !std::has_single_bit(num_pixels)) {
+    if (output_mode == OutputMode::Average) {
+      for (auto y : std::views::iota(0, dst.rows)) {
+        for (auto x : std::views::iota(0, dst.cols)) {
+          BinPixel<T, BINNING_X, BINNING_Y>(src, dst, y, x, output_mode, ColorFilter::Mono);
+        }
+      }
+      return;
+    }
+  }
+
+  // 出力16画素ごとに処理する．入力は16画素ずつBINNING_X本のベクトルに広げて縦に足し，
+  // 最後に2本のベクトルの偶数レーンと奇数レーンを集めて足すことを繰り返す
+  constexpr int32_t stride = 512 / 8 / sizeof(uint32_t);
+  const int32_t src_step1  = src.step1();
+  const int32_t simd_end   = dst.cols / stride * stride;
+
+  const __m512i half   = _mm512_set1_epi32(num_pixels / 2);
+  const __m512 divisor = _mm512_set1_ps(num_pixels);
+  const __m512 scale   = _mm512_set1_ps(output_mode == OutputMode::Average ? 1.0f / num_pixels : 1.0f);
+  const __m512i half64 = _mm512_set1_epi64(num_pixels / 2);
+
+  const __m512i even32 = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+  const __m512i odd32  = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+  const __m512i even64 = _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+  const __m512i odd64  = _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15);
+
+  for (auto y : std::views::iota(0, dst.rows)) {
+    const T* sptry = src.ptr<T>(y * BINNING_Y);
+
+    for (int32_t x = 0; x < simd_end; x += stride) {
+      const T* sptryx = sptry + x * BINNING_X;
+
+      if constexpr (std::is_same_v<T, uint8_t>) {
+        // uint8_tは16画素ずつint32_tに広げて足す
+        __m512i acc[BINNING_X] = {};
+#pragma GCC unroll 8
+        for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+          const uint8_t* sptryxb = sptryx + src_step1 * y_b;
+#pragma GCC unroll 8
+          for (uint32_t i = 0; i < BINNING_X; i++) {
+            __m128i sv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sptryxb + stride * i));
+            acc[i]     = _mm512_add_epi32(acc[i], _mm512_cvtepu8_epi32(sv));
+          }
+        }
+#pragma GCC unroll 4
+        for (uint32_t n = BINNING_X; n > 1; n /= 2) {
+          for (uint32_t i = 0; i < n / 2; i++) {
+            __m512i a = acc[i * 2];
+            __m512i b = acc[i * 2 + 1];
+            acc[i]    = _mm512_add_epi32(_mm512_permutex2var_epi32(a, even32, b),
+                                         _mm512_permutex2var_epi32(a, odd32, b));
+          }
+        }
+
+        if (output_mode == OutputMode::WideSum) {
+          _mm512_storeu_si512(dst.ptr<int32_t>(y) + x, acc[0]);
+          continue;
+        }
+        __m512i ret = acc[0];
+        if (output_mode == OutputMode::Average) {
+          if constexpr (std::has_single_bit(num_pixels)) {
+            ret = _mm512_srli_epi32(_mm512_add_epi32(ret, half), std::bit_width(num_pixels) - 1);
+          } else {
+            __m512 q = _mm512_div_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(ret, half)), divisor);
+            ret      = _mm512_cvttps_epi32(q);
+          }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst.ptr<uint8_t>(y) + x), _mm512_cvtusepi32_epi8(ret));
+      } else if constexpr (std::is_same_v<T, int32_t>) {
+        // int32_tは8画素ずつint64_tに広げて足す．acc[k]は[8k, 8k + 8)番目の画素
+        __m512i acc[BINNING_X * 2] = {};
+#pragma GCC unroll 8
+        for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+          const int32_t* sptryxb = sptryx + src_step1 * y_b;
+#pragma GCC unroll 8
+          for (uint32_t i = 0; i < BINNING_X; i++) {
+            __m512i sv     = _mm512_loadu_si512(sptryxb + stride * i);
+            acc[i * 2]     = _mm512_add_epi64(acc[i * 2], _mm512_cvtepi32_epi64(_mm512_castsi512_si256(sv)));
+            acc[i * 2 + 1] = _mm512_add_epi64(acc[i * 2 + 1], _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(sv, 1)));
+          }
+        }
+#pragma GCC unroll 4
+        for (uint32_t n = BINNING_X * 2; n > 2; n /= 2) {
+          for (uint32_t i = 0; i < n / 2; i++) {
+            __m512i a = acc[i * 2];
+            __m512i b = acc[i * 2 + 1];
+            acc[i]    = _mm512_add_epi64(_mm512_permutex2var_epi64(a, even64, b),
+                                         _mm512_permutex2var_epi64(a, odd64, b));
+          }
+        }
+
+        int32_t* dptryx = dst.ptr<int32_t>(y) + x;
+        for (uint32_t i = 0; i < 2; i++) {
+          __m256i ret;
+          if (output_mode == OutputMode::Average) {
+            // 算術シフトで-∞方向に切り捨てる
+            __m512i q = _mm512_srai_epi64(_mm512_add_epi64(acc[i], half64), std::bit_width(num_pixels) - 1);
+            ret       = _mm512_cvtepi64_epi32(q);
+          } else {
+            ret = _mm512_cvtsepi64_epi32(acc[i]);
+          }
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(dptryx + stride / 2 * i), ret);
+        }
+      } else {
+        static_assert(std::is_same_v<T, float>);
+        // floatのAverageは画素ごとに1 / num_pixelsを掛けながらFMAで足す
+        __m512 acc[BINNING_X] = {};
+#pragma GCC unroll 8
+        for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+          const float* sptryxb = sptryx + src_step1 * y_b;
+#pragma GCC unroll 8
+          for (uint32_t i = 0; i < BINNING_X; i++) {
+            acc[i] = _mm512_fmadd_ps(_mm512_loadu_ps(sptryxb + stride * i), scale, acc[i]);
+          }
+        }
+#pragma GCC unroll 4
+        for (uint32_t n = BINNING_X; n > 1; n /= 2) {
+          for (uint32_t i = 0; i < n / 2; i++) {
+            __m512 a = acc[i * 2];
+            __m512 b = acc[i * 2 + 1];
+            acc[i]   = _mm512_add_ps(_mm512_permutex2var_ps(a, even32, b), _mm512_permutex2var_ps(a, odd32, b));
+          }
+        }
+        _mm512_storeu_ps(dst.ptr<float>(y) + x, acc[0]);
+      }
+    }
+
+    for (auto x : std::views::iota(simd_end, dst.cols)) {
+      BinPixel<T, BINNING_X, BINNING_Y>(src, dst, y, x, output_mode, ColorFilter::Mono);
+    }
+  }
+}
+
+template void Binning<Impl::Avx512UnrollAll>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
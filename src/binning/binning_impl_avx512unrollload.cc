@@ -1,5 +1,6 @@
 #pragma GCC target("avx512f,avx512bw,avx512vl")
 #include "binning.h"
+#include "binning_avx512.h"
 
 #include <bit>
 #include <cassert>
@@ -12,7 +13,9 @@
 template<>
 void Binning<Impl::Avx512UnrollLoad>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x,
                                               uint32_t binning_y) {
-  Execute_Impl(binning_x, binning_y, src, dst);
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
 }
 
 template<>
@@ -22,11 +25,7 @@ void Binning<Impl::Avx512UnrollLoad>::Execute_Impl<1, 1>(const cv::Mat& src, cv:
   assert(src.rows == dst.rows);
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
-  for (auto y : std::views::iota(0, src.rows)) {
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(512 / 8 / sizeof(uint16_t))) {
-      _mm512_storeu_si512(dst.ptr<uint16_t>(y) + x, _mm512_loadu_si512(reinterpret_cast<const void*>(src.ptr<uint16_t>(y) + x)));
-    }
-  }
+  CopyRows_Avx512(src, dst, streaming_store_);
 }
 
 template<>
@@ -65,25 +64,41 @@ void Binning<Impl::Avx512UnrollLoad>::Execute_Impl(const cv::Mat& src, cv::Mat&
   const int32_t step1      = src.step1();
   const int32_t step2      = src.step1() * 2;
   const int32_t step3      = src.step1() * 3;
+  const int32_t src_end    = dst.cols * BINNING_X;
+
+  // 次のブロックを先読みするので，行末(src_end)をはみ出す読み込みだけマスクする
+  auto load = [&](const uint16_t* ptr, int32_t offset) {
+    if (offset + stride <= src_end) {
+      return _mm512_loadu_si512(reinterpret_cast<const void*>(ptr));
+    }
+    return _mm512_maskz_loadu_epi16(TailMask(src_end - offset), ptr);
+  };
 
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
+  for (auto y : std::views::iota(0, dst.rows * static_cast<int32_t>(BINNING_Y)) | std::views::stride(BINNING_Y)) {
     const uint16_t* sptry  = src.ptr<uint16_t>(y);
     const uint16_t* sptry_ = sptry + stride;
     uint16_t* dptry        = dst.ptr<uint16_t>(y >> shift_y);
+    const bool stream      = UseStreamingStore(streaming_store_, dptry);
 
-    __m512i y0_0              = _mm512_loadu_si512(reinterpret_cast<const void*>(sptry));
-    __m512i y0_1              = _mm512_loadu_si512(reinterpret_cast<const void*>(sptry_));
-    __m512i y1_0              = _mm512_loadu_si512(reinterpret_cast<const void*>(sptry + step1));
-    __m512i y1_1              = _mm512_loadu_si512(reinterpret_cast<const void*>(sptry_ + step1));
+    __m512i y0_0              = load(sptry, 0);
+    __m512i y0_1              = load(sptry_, stride);
+    __m512i y1_0, y1_1;
+    if constexpr (BINNING_Y >= 2) {
+      y1_0 = load(sptry + step1, 0);
+      y1_1 = load(sptry_ + step1, stride);
+    }
     constexpr int32_t stride2 = stride << 1;
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride << 1)) {
+    for (int32_t x = 0; x < src_end; x += stride2) {
       const uint16_t* sptryxb  = sptry + x;
       const uint16_t* sptryxb_ = sptry_ + x;
 
-      __m512i y2_0            = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryxb + step2));
-      __m512i y2_1            = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryxb_ + step2));
-      __m512i y3_0            = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryxb + step3));
-      __m512i y3_1            = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryxb_ + step3));
+      __m512i y2_0, y2_1, y3_0, y3_1;
+      if constexpr (BINNING_Y == 4) {
+        y2_0 = load(sptryxb + step2, x);
+        y2_1 = load(sptryxb_ + step2, x + stride);
+        y3_0 = load(sptryxb + step3, x);
+        y3_1 = load(sptryxb_ + step3, x + stride);
+      }
       const uint16_t* sptryx  = sptryxb + stride2;
       const uint16_t* sptryx_ = sptryxb_ + stride2;
       __m512i ret0, ret1;
@@ -96,8 +111,8 @@ void Binning<Impl::Avx512UnrollLoad>::Execute_Impl(const cv::Mat& src, cv::Mat&
         ret0          = _mm512_adds_epu16(y0_0, y0_0s);
         ret1          = _mm512_adds_epu16(y0_1, y0_1s);
       }
-      y0_0 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx));
-      y0_1 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx_));
+      y0_0 = load(sptryx, x + stride2);
+      y0_1 = load(sptryx_, x + stride2 + stride);
 
       if constexpr (BINNING_Y >= 2) {
         if constexpr (BINNING_X >= 2) {
@@ -108,8 +123,8 @@ void Binning<Impl::Avx512UnrollLoad>::Execute_Impl(const cv::Mat& src, cv::Mat&
         }
         ret0 = _mm512_maskz_adds_epu16(mask, ret0, y1_0);
         ret1 = _mm512_maskz_adds_epu16(mask, ret1, y1_1);
-        y1_0 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + step1));
-        y1_1 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx_ + step1));
+        y1_0 = load(sptryx + step1, x + stride2);
+        y1_1 = load(sptryx_ + step1, x + stride2 + stride);
       }
 
       if constexpr (BINNING_Y == 4) {
@@ -129,18 +144,31 @@ void Binning<Impl::Avx512UnrollLoad>::Execute_Impl(const cv::Mat& src, cv::Mat&
         ret1 = _mm512_maskz_adds_epu16(mask, ret1, y2_1);
       }
 
-      if constexpr (BINNING_X == 1) {
-        _mm512_storeu_si512(dptry + x, ret0);
-        _mm512_storeu_si512(dptry + x + stride, ret1);
-      } else if constexpr (BINNING_X == 2) {
-        ret0 = _mm512_permutex2var_epi16(ret0, idx, ret1);
-        _mm512_storeu_si512(dptry + (x >> shift_x), ret0);
-      } else if (BINNING_X == 4) {
-        ret0 = _mm512_maskz_adds_epu16(mask, ret0, _mm512_srli_epi64(ret0, 32));
-        ret1 = _mm512_maskz_adds_epu16(mask, ret1, _mm512_srli_epi64(ret1, 32));
-        ret0 = _mm512_permutex2var_epi16(ret0, idx, ret1);
-        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dptry + (x >> shift_x)), _mm512_castsi512_si256(ret0));
+      auto store = [&](const auto& lanes) {
+        if constexpr (BINNING_X == 1) {
+          lanes.Store(dptry + x, 0, ret0);
+          lanes.Store(dptry + x + stride, stride, ret1);
+        } else if constexpr (BINNING_X == 2) {
+          ret0 = _mm512_permutex2var_epi16(ret0, idx, ret1);
+          lanes.Store(dptry + (x >> shift_x), 0, ret0);
+        } else if (BINNING_X == 4) {
+          ret0 = _mm512_maskz_adds_epu16(mask, ret0, _mm512_srli_epi64(ret0, 32));
+          ret1 = _mm512_maskz_adds_epu16(mask, ret1, _mm512_srli_epi64(ret1, 32));
+          ret0 = _mm512_permutex2var_epi16(ret0, idx, ret1);
+          lanes.Store(dptry + (x >> shift_x), 0, _mm512_castsi512_si256(ret0));
+        }
+      };
+      if (x + stride2 <= src_end) {
+        if (stream) {
+          store(StreamLanes{});
+        } else {
+          store(FullLanes{});
+        }
+      } else {
+        store(TailLanes{src_end - x, dst.cols - (x >> shift_x)});
       }
     }
   }
 }
+
+template void Binning<Impl::Avx512UnrollLoad>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
@@ -1,5 +1,6 @@
 #pragma GCC target("avx512f,avx512bw,avx512vl")
 #include "binning.h"
+#include "binning_avx512.h"
 
 #include <bit>
 #include <cassert>
@@ -11,7 +12,9 @@
 
 template<>
 void Binning<Impl::Avx512UnrollX>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
-  Execute_Impl(binning_x, binning_y, src, dst);
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
 }
 
 template<>
@@ -21,11 +24,7 @@ void Binning<Impl::Avx512UnrollX>::Execute_Impl<1, 1>(const cv::Mat& src, cv::Ma
   assert(src.rows == dst.rows);
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
-  for (auto y : std::views::iota(0, src.rows)) {
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(512 / 8 / sizeof(uint16_t))) {
-      _mm512_storeu_si512(dst.ptr<uint16_t>(y) + x, _mm512_loadu_si512(reinterpret_cast<const void*>(src.ptr<uint16_t>(y) + x)));
-    }
-  }
+  CopyRows_Avx512(src, dst, streaming_store_);
 }
 
 template<>
@@ -64,26 +63,28 @@ void Binning<Impl::Avx512UnrollX>::Execute_Impl(const cv::Mat& src, cv::Mat& dst
   const int32_t step1      = src.step1();
   const int32_t step2      = src.step1() * 2;
   const int32_t step3      = src.step1() * 3;
+  const int32_t src_end    = dst.cols * BINNING_X;
+  const int32_t simd_end   = src_end / (stride << 1) * (stride << 1);
 
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
+  for (auto y : std::views::iota(0, dst.rows * static_cast<int32_t>(BINNING_Y)) | std::views::stride(BINNING_Y)) {
     const uint16_t* sptry  = src.ptr<uint16_t>(y);
     const uint16_t* sptry_ = sptry + stride;
     uint16_t* dptry        = dst.ptr<uint16_t>(y >> shift_y);
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(stride << 1)) {
+    auto process = [&](int32_t x, const auto& lanes) {
       const uint16_t* sptryx  = sptry + x;
       const uint16_t* sptryx_ = sptry_ + x;
-      __m512i y0_0            = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx));
-      __m512i y0_1            = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx_));
+      __m512i y0_0            = lanes.Load(sptryx, 0);
+      __m512i y0_1            = lanes.Load(sptryx_, stride);
       __m512i y1_0, y1_1, y2_0, y2_1, y3_0, y3_1;
       if constexpr (BINNING_Y >= 2) {
-        y1_0 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + step1));
-        y1_1 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx_ + step1));
+        y1_0 = lanes.Load(sptryx + step1, 0);
+        y1_1 = lanes.Load(sptryx_ + step1, stride);
       }
       if constexpr (BINNING_Y == 4) {
-        y2_0 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + step2));
-        y2_1 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx_ + step2));
-        y3_0 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx + step3));
-        y3_1 = _mm512_loadu_si512(reinterpret_cast<const void*>(sptryx_ + step3));
+        y2_0 = lanes.Load(sptryx + step2, 0);
+        y2_1 = lanes.Load(sptryx_ + step2, stride);
+        y3_0 = lanes.Load(sptryx + step3, 0);
+        y3_1 = lanes.Load(sptryx_ + step3, stride);
       }
       if constexpr (BINNING_X >= 2) {
         __m512i y0_0s = _mm512_srli_epi64(y0_0, 16);
@@ -120,17 +121,24 @@ void Binning<Impl::Avx512UnrollX>::Execute_Impl(const cv::Mat& src, cv::Mat& dst
       }
 
       if constexpr (BINNING_X == 1) {
-        _mm512_storeu_si512(dptry + x, y0_0);
-        _mm512_storeu_si512(dptry + x + stride, y0_1);
+        lanes.Store(dptry + x, 0, y0_0);
+        lanes.Store(dptry + x + stride, stride, y0_1);
       } else if constexpr (BINNING_X == 2) {
         y0_0 = _mm512_permutex2var_epi16(y0_0, idx, y0_1);
-        _mm512_storeu_si512(dptry + (x >> shift_x), y0_0);
+        lanes.Store(dptry + (x >> shift_x), 0, y0_0);
       } else if (BINNING_X == 4) {
         y0_0 = _mm512_maskz_adds_epu16(mask, y0_0, _mm512_srli_epi64(y0_0, 32));
         y0_1 = _mm512_maskz_adds_epu16(mask, y0_1, _mm512_srli_epi64(y0_1, 32));
         y0_0 = _mm512_permutex2var_epi16(y0_0, idx, y0_1);
-        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dptry + (x >> shift_x)), _mm512_castsi512_si256(y0_0));
+        lanes.Store(dptry + (x >> shift_x), 0, _mm512_castsi512_si256(y0_0));
       }
+    };
+
+    int32_t x = ProcessFullLanes(simd_end, stride << 1, UseStreamingStore(streaming_store_, dptry), process);
+    if (x < src_end) {
+      process(x, TailLanes{src_end - x, dst.cols - (x >> shift_x)});
     }
   }
 }
+
+template void Binning<Impl::Avx512UnrollX>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
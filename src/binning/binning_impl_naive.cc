@@ -1,7 +1,9 @@
 #include "binning.h"
+#include "binning_pixel.h"
 
 #include <bit>
 #include <cassert>
+#include <cstring>
 #include <print>
 #include <ranges>
 
@@ -9,7 +11,9 @@
 
 template<>
 void Binning<Impl::Naive>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
-  Execute_Impl(binning_x, binning_y, src, dst);
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
 }
 
 template<>
@@ -19,34 +23,107 @@ void Binning<Impl::Naive>::Execute_Impl<1, 1>(const cv::Mat& src, cv::Mat& dst)
   assert(src.rows == dst.rows);
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
-  std::memcpy(dst.ptr<uint16_t>(), src.ptr<uint16_t>(), src.total() * sizeof(uint16_t));
+  // ROIではstepが行幅と一致しないので行ごとにコピーする
+  for (auto y : std::views::iota(0, src.rows)) {
+    std::memcpy(dst.ptr<uint16_t>(y), src.ptr<uint16_t>(y), src.cols * sizeof(uint16_t));
+  }
 }
 
 template<>
 template<uint32_t BINNING_X, uint32_t BINNING_Y>
 void Binning<Impl::Naive>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
-  static_assert(std::has_single_bit(BINNING_X));
-  static_assert(std::has_single_bit(BINNING_Y));
+  assert(src.cols / BINNING_X == dst.cols);
+  assert(src.rows / BINNING_Y == dst.rows);
+  assert(src.type() == CV_16UC1);
+  assert(src.type() == CV_16UC1);
 
-  constexpr int32_t shift_x = std::bit_width(BINNING_X) - 1;
-  constexpr int32_t shift_y = std::bit_width(BINNING_Y) - 1;
+  for (auto y : std::views::iota(0, dst.rows)) {
+    uint16_t* dptry = dst.ptr<uint16_t>(y);
+    for (auto x : std::views::iota(0, dst.cols)) {
+      uint32_t temp = 0;
+      for (auto y_b : std::views::iota(0u, BINNING_Y)) {
+        const uint16_t* sptryx = src.ptr<uint16_t>(y * BINNING_Y + y_b) + x * BINNING_X;
+        for (auto x_b : std::views::iota(0u, BINNING_X)) {
+          temp += sptryx[x_b];
+        }
+      }
+      dptry[x] = std::min<uint32_t>(temp, std::numeric_limits<uint16_t>::max());
+    }
+  }
+}
 
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y>
+void Binning<Impl::Naive>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, OutputMode output_mode) {
   assert(src.cols / BINNING_X == dst.cols);
   assert(src.rows / BINNING_Y == dst.rows);
   assert(src.type() == CV_16UC1);
-  assert(src.type() == CV_16UC1);
+  assert(dst.type() == (output_mode == OutputMode::WideSum ? CV_32SC1 : CV_16UC1));
+
+  constexpr uint32_t num_pixels = BINNING_X * BINNING_Y;
 
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
-    uint16_t* dptry = dst.ptr<uint16_t>(y >> shift_y);
-    for (auto x : std::views::iota(0, src.cols) | std::views::stride(BINNING_X)) {
+  for (auto y : std::views::iota(0, dst.rows)) {
+    for (auto x : std::views::iota(0, dst.cols)) {
       uint32_t temp = 0;
       for (auto y_b : std::views::iota(0u, BINNING_Y)) {
-        const uint16_t* sptryx = src.ptr<uint16_t>(y + y_b) + x;
+        const uint16_t* sptryx = src.ptr<uint16_t>(y * BINNING_Y + y_b) + x * BINNING_X;
         for (auto x_b : std::views::iota(0u, BINNING_X)) {
           temp += sptryx[x_b];
         }
       }
-      dptry[x >> shift_x] = std::min<uint32_t>(temp, std::numeric_limits<uint16_t>::max());
+      if (output_mode == OutputMode::WideSum) {
+        dst.ptr<int32_t>(y)[x] = temp;
+      } else {
+        dst.ptr<uint16_t>(y)[x] = (temp + num_pixels / 2) / num_pixels;
+      }
     }
   }
 }
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y>
+void Binning<Impl::Naive>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, ColorFilter color_filter) {
+  assert(color_filter == ColorFilter::Bayer);
+  assert(src.cols / (2 * BINNING_X) * 2 == dst.cols);
+  assert(src.rows / (2 * BINNING_Y) * 2 == dst.rows);
+  assert(src.type() == CV_16UC1);
+  assert(dst.type() == (output_mode_ == OutputMode::WideSum ? CV_32SC1 : CV_16UC1));
+
+  constexpr uint32_t num_pixels = BINNING_X * BINNING_Y;
+
+  // 出力(x, y)は色の位相(x & 1, y & 1)が同じ入力画素を2画素おきにまとめる
+  for (auto y : std::views::iota(0, dst.rows)) {
+    for (auto x : std::views::iota(0, dst.cols)) {
+      uint32_t temp = 0;
+      for (auto y_b : std::views::iota(0u, BINNING_Y)) {
+        const uint16_t* sptry = src.ptr<uint16_t>(((y >> 1) * BINNING_Y + y_b) * 2 + (y & 1));
+        for (auto x_b : std::views::iota(0u, BINNING_X)) {
+          temp += sptry[((x >> 1) * BINNING_X + x_b) * 2 + (x & 1)];
+        }
+      }
+      if (output_mode_ == OutputMode::SaturatingSum) {
+        dst.ptr<uint16_t>(y)[x] = std::min<uint32_t>(temp, std::numeric_limits<uint16_t>::max());
+      } else if (output_mode_ == OutputMode::WideSum) {
+        dst.ptr<int32_t>(y)[x] = temp;
+      } else {
+        dst.ptr<uint16_t>(y)[x] = (temp + num_pixels / 2) / num_pixels;
+      }
+    }
+  }
+}
+
+template<>
+template<uint32_t BINNING_X, uint32_t BINNING_Y, typename T>
+void Binning<Impl::Naive>::Execute_Impl(const cv::Mat& src, cv::Mat& dst, PixelType<T>) {
+  assert(dst.size() == GetOutputSize(src.size(), BINNING_X, BINNING_Y));
+  assert(src.type() == cv::DataType<T>::type);
+  assert(dst.type() == GetOutputType(src.type()));
+
+  for (auto y : std::views::iota(0, dst.rows)) {
+    for (auto x : std::views::iota(0, dst.cols)) {
+      BinPixel<T, BINNING_X, BINNING_Y>(src, dst, y, x, output_mode_, color_filter_);
+    }
+  }
+}
+
+template void Binning<Impl::Naive>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
@@ -10,7 +10,9 @@
 
 template<>
 void Binning<Impl::SeqRead>::Execute(const cv::Mat& src, cv::Mat& dst, uint32_t binning_x, uint32_t binning_y) {
-  Execute_Impl(binning_x, binning_y, src, dst);
+  ForEachBand(src, dst, binning_y, [&](const cv::Mat& src_band, cv::Mat& dst_band) {
+    Execute_Band(src_band, dst_band, binning_x, binning_y);
+  });
 }
 
 template<>
@@ -26,38 +28,32 @@ void Binning<Impl::SeqRead>::Execute_Impl<1, 1>(const cv::Mat& src, cv::Mat& dst
 template<>
 template<uint32_t BINNING_X, uint32_t BINNING_Y>
 void Binning<Impl::SeqRead>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
-  static_assert(std::has_single_bit(BINNING_X));
-  static_assert(std::has_single_bit(BINNING_Y));
-
-  constexpr int32_t shift_x = std::bit_width(BINNING_X) - 1;
-  constexpr int32_t shift_y = std::bit_width(BINNING_Y) - 1;
-
   assert(src.cols / BINNING_X == dst.cols);
   assert(src.rows / BINNING_Y == dst.rows);
   assert(src.type() == CV_16UC1);
   assert(src.type() == CV_16UC1);
 
-  for (auto y : std::views::iota(0, src.rows) | std::views::stride(BINNING_Y)) {
-    uint16_t* dptry = dst.ptr<uint16_t>(y >> shift_y);
+  for (auto y : std::views::iota(0, dst.rows)) {
+    uint16_t* dptry = dst.ptr<uint16_t>(y);
 
     {
-      const uint16_t* sptry = src.ptr<uint16_t>(y);
-      for (auto x : std::views::iota(0, src.cols) | std::views::stride(BINNING_X)) {
-        uint16_t* dptryx = dptry + (x >> shift_x);
+      const uint16_t* sptry = src.ptr<uint16_t>(y * BINNING_Y);
+      for (auto x : std::views::iota(0, dst.cols)) {
+        uint16_t* dptryx = dptry + x;
         *dptryx          = 0;
         for (auto x_b : std::views::iota(0u, BINNING_X)) {
-          uint32_t tmp = *dptryx + sptry[x + x_b];
+          uint32_t tmp = *dptryx + sptry[x * BINNING_X + x_b];
           *dptryx      = std::min<uint32_t>(tmp, std::numeric_limits<uint16_t>::max());
         }
       }
     }
     if constexpr (BINNING_Y >= 1) {
       for (auto y_b : std::views::iota(1u, BINNING_Y)) {
-        const uint16_t* sptry = src.ptr<uint16_t>(y + y_b);
-        for (auto x : std::views::iota(0, src.cols) | std::views::stride(BINNING_X)) {
-          uint16_t* dptryx = dptry + (x >> shift_x);
+        const uint16_t* sptry = src.ptr<uint16_t>(y * BINNING_Y + y_b);
+        for (auto x : std::views::iota(0, dst.cols)) {
+          uint16_t* dptryx = dptry + x;
           for (auto x_b : std::views::iota(0u, BINNING_X)) {
-            uint32_t tmp = *dptryx + sptry[x + x_b];
+            uint32_t tmp = *dptryx + sptry[x * BINNING_X + x_b];
             *dptryx      = std::min<uint32_t>(tmp, std::numeric_limits<uint16_t>::max());
           }
         }
@@ -65,3 +61,5 @@ void Binning<Impl::SeqRead>::Execute_Impl(const cv::Mat& src, cv::Mat& dst) {
     }
   }
 }
+
+template void Binning<Impl::SeqRead>::Execute_Band(const cv::Mat&, cv::Mat&, uint32_t, uint32_t);
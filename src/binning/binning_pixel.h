@@ -0,0 +1,59 @@
+#pragma once
+
+// binning_impl_*.cc 専用．CV_16UC1以外の画素型(uint8_t, int32_t, float)のスカラー処理
+// Naiveのカーネルと，SIMDカーネルの行末の端数で同じ結果にするために共有する
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include <opencv2/core/core.hpp>
+
+#include "binning.h"
+
+// 和の型: 整数は64bitで飽和・オーバーフローさせずに足し，floatはfloatのまま足す
+template<typename T>
+using BinningSum = std::conditional_t<std::is_floating_point_v<T>, float, int64_t>;
+
+// 整数の(sum + num_pixels / 2) / num_pixelsを-∞方向に切り捨てる．SIMDの算術シフトと同じ結果になる
+inline int64_t RoundedAverage(int64_t sum, int64_t num_pixels) {
+  const int64_t biased = sum + num_pixels / 2;
+  return biased >= 0 ? biased / num_pixels : -((-biased + num_pixels - 1) / num_pixels);
+}
+
+// 和をoutput_modeに従ってdstの(y, x)に書き込む
+template<typename T>
+inline void StoreBinned(cv::Mat& dst, int32_t y, int32_t x, BinningSum<T> sum, uint32_t num_pixels,
+                        OutputMode output_mode) {
+  if constexpr (std::is_floating_point_v<T>) {
+    dst.ptr<float>(y)[x] = output_mode == OutputMode::Average ? sum * (1.0f / num_pixels) : sum;
+  } else if (output_mode == OutputMode::Average) {
+    dst.ptr<T>(y)[x] = static_cast<T>(RoundedAverage(sum, num_pixels));
+  } else if (output_mode == OutputMode::WideSum) {
+    dst.ptr<int32_t>(y)[x] = static_cast<int32_t>(
+        std::clamp<int64_t>(sum, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max()));
+  } else {
+    dst.ptr<T>(y)[x] =
+        static_cast<T>(std::clamp<int64_t>(sum, std::numeric_limits<T>::min(), std::numeric_limits<T>::max()));
+  }
+}
+
+// dstの(y, x)の1画素をまとめる．Bayerの場合は色の位相(x & 1, y & 1)が同じ画素を2画素おきにまとめる
+template<typename T, uint32_t BINNING_X, uint32_t BINNING_Y>
+inline void BinPixel(const cv::Mat& src, cv::Mat& dst, int32_t y, int32_t x, OutputMode output_mode,
+                     ColorFilter color_filter) {
+  const bool bayer    = color_filter == ColorFilter::Bayer;
+  const int32_t pitch = bayer ? 2 : 1;
+  const int32_t src_y = bayer ? (y >> 1) * BINNING_Y * 2 + (y & 1) : y * BINNING_Y;
+  const int32_t src_x = bayer ? (x >> 1) * BINNING_X * 2 + (x & 1) : x * BINNING_X;
+
+  BinningSum<T> sum = 0;
+  for (uint32_t y_b = 0; y_b < BINNING_Y; y_b++) {
+    const T* sptry = src.ptr<T>(src_y + y_b * pitch);
+    for (uint32_t x_b = 0; x_b < BINNING_X; x_b++) {
+      sum += sptry[src_x + x_b * pitch];
+    }
+  }
+  StoreBinned<T>(dst, y, x, sum, BINNING_X * BINNING_Y, output_mode);
+}
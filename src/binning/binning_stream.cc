@@ -0,0 +1,66 @@
+#include "binning.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include <opencv2/core/core.hpp>
+
+BinningStream::BinningStream(std::shared_ptr<BinningBase> binning, int32_t width, uint32_t binning_x,
+                             uint32_t binning_y)
+    : binning_(std::move(binning)), width_(width), binning_x_(binning_x), binning_y_(binning_y) {
+  const bool bayer = binning_->GetColorFilter() == ColorFilter::Bayer;
+  src_group_rows_  = bayer ? 2 * binning_y : binning_y;
+  dst_group_rows_  = bayer ? 2 : 1;
+}
+
+void BinningStream::Reset() {
+  buffered_rows_ = 0;
+  dst_y_         = 0;
+}
+
+// src_rowsはsrc_group_rows_の倍数行
+void BinningStream::Emit(const cv::Mat& src_rows, const Callback& callback) {
+  const int32_t num_groups = src_rows.rows / src_group_rows_;
+  const cv::Size dst_size  = binning_->GetOutputSize(src_rows.size(), binning_x_, binning_y_);
+  assert(dst_size.height == num_groups * dst_group_rows_);
+  dst_.create(dst_size, binning_->GetOutputType(src_rows.type()));
+  binning_->Execute(src_rows, dst_, binning_x_, binning_y_);
+  callback(dst_, dst_y_);
+  dst_y_ += dst_size.height;
+}
+
+void BinningStream::Push(const cv::Mat& src_rows, const Callback& callback) {
+  assert(src_rows.cols == width_);
+  assert(buffered_rows_ == 0 || src_rows.type() == buffer_.type());
+
+  // 行バッファは入力の画素型で確保する(同じ型の場合は確保し直さない)
+  buffer_.create(cv::Size(width_, src_group_rows_), src_rows.type());
+  auto copy_rows = [&](int32_t begin, int32_t end) {
+    for (auto y = begin; y < end; y++) {
+      std::memcpy(buffer_.ptr(buffered_rows_++), src_rows.ptr(y), width_ * src_rows.elemSize());
+    }
+  };
+
+  int32_t y = 0;
+  // 前回の残りの行を埋める
+  if (buffered_rows_ > 0) {
+    const int32_t num_rows = std::min(src_group_rows_ - buffered_rows_, src_rows.rows);
+    copy_rows(0, num_rows);
+    y = num_rows;
+    if (buffered_rows_ == src_group_rows_) {
+      Emit(buffer_, callback);
+      buffered_rows_ = 0;
+    }
+  }
+
+  // 揃っているグループはコピーせずにまとめて処理する
+  const int32_t num_groups = (src_rows.rows - y) / src_group_rows_;
+  if (num_groups > 0) {
+    Emit(src_rows.rowRange(y, y + num_groups * src_group_rows_), callback);
+    y += num_groups * src_group_rows_;
+  }
+
+  copy_rows(y, src_rows.rows);
+}
@@ -3,6 +3,7 @@
 #include <print>
 #include <ranges>
 
+#include <omp.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -78,6 +79,20 @@ auto main() -> int {
   seqread.Execute(src, dst4x4, 4, 4);
   MEASURE_END();
 
+  std::println("Avx2");
+  Binning<Impl::Avx2> avx2;
+  MEASURE_BEGIN();
+  avx2.Execute(src, dst1x1, 1, 1);
+  MEASURE_END();
+
+  MEASURE_BEGIN();
+  avx2.Execute(src, dst2x2, 2, 2);
+  MEASURE_END();
+
+  MEASURE_BEGIN();
+  avx2.Execute(src, dst4x4, 4, 4);
+  MEASURE_END();
+
   std::println("Avx512");
   Binning<Impl::Avx512> avx512;
   MEASURE_BEGIN();
@@ -146,5 +161,241 @@ auto main() -> int {
   avx512seqbuffer.Execute(src, dst4x4, 4, 4);
   MEASURE_END();
 
+  auto factory = BinningFactory::Create();
+  std::println("BinningFactory: {}", ToString(factory->GetImpl()));
+  MEASURE_BEGIN();
+  factory->Execute(src, dst2x2, 2, 2);
+  MEASURE_END();
+
+  MEASURE_BEGIN();
+  factory->Execute(src, dst4x4, 4, 4);
+  MEASURE_END();
+
+  std::println("Asymmetric / 3x3 / 8x8");
+  for (auto [binning_x, binning_y] : {std::pair{1u, 2u}, {2u, 1u}, {1u, 4u}, {4u, 1u}, {2u, 4u}, {4u, 2u}, {3u, 3u},
+                                      {8u, 8u}}) {
+    cv::Mat dst = cv::Mat(cv::Size(src.cols / binning_x, src.rows / binning_y), src.type());
+    std::println("{}x{}", binning_x, binning_y);
+    std::print("Navie           ");
+    MEASURE_BEGIN();
+    naive.Execute(src, dst, binning_x, binning_y);
+    MEASURE_END();
+    std::print("Avx512UnrollAll ");
+    MEASURE_BEGIN();
+    unrollall.Execute(src, dst, binning_x, binning_y);
+    MEASURE_END();
+  }
+
+  // 初回のExecuteで計測するので，2回目以降を測る
+  std::println("AutoTuner");
+  BinningAutoTuner tuner("binning_profile.txt");
+  for (auto [binning_x, binning_y] : {std::pair{1u, 1u}, {2u, 2u}, {4u, 4u}, {3u, 3u}, {8u, 8u}, {2u, 4u}}) {
+    cv::Mat dst = cv::Mat(cv::Size(src.cols / binning_x, src.rows / binning_y), src.type());
+    tuner.Execute(src, dst, binning_x, binning_y);
+    std::print("{}x{} {:16} ", binning_x, binning_y, ToString(tuner.GetSelectedImpl(binning_x, binning_y, src.size())));
+    MEASURE_BEGIN();
+    tuner.Execute(src, dst, binning_x, binning_y);
+    MEASURE_END();
+  }
+
+  std::println("OutputMode");
+  for (auto [output_mode, name] : {std::pair{OutputMode::SaturatingSum, "SaturatingSum"},
+                                   {OutputMode::Average, "Average"},
+                                   {OutputMode::WideSum, "WideSum"}}) {
+    const int32_t type = output_mode == OutputMode::WideSum ? CV_32SC1 : CV_16UC1;
+    for (auto binning : {2u, 4u}) {
+      cv::Mat dst = cv::Mat(src.size() / binning, type);
+      std::println("{} {}x{}", name, binning, binning);
+      for (auto [impl, impl_name] : {std::pair<BinningBase*, const char*>{&naive, "Navie          "},
+                                     {&avx2, "Avx2           "},
+                                     {&unrollall, "Avx512UnrollAll"}}) {
+        impl->SetOutputMode(output_mode);
+        std::print("{} ", impl_name);
+        MEASURE_BEGIN();
+        impl->Execute(src, dst, binning, binning);
+        MEASURE_END();
+        impl->SetOutputMode(OutputMode::SaturatingSum);
+      }
+    }
+  }
+
+  std::println("Bayer");
+  for (auto binning : {1u, 2u, 4u}) {
+    cv::Mat dst = cv::Mat(cv::Size(src.cols / (2 * binning) * 2, src.rows / (2 * binning) * 2), src.type());
+    std::println("{}x{}", binning, binning);
+    for (auto [impl, impl_name] : {std::pair<BinningBase*, const char*>{&naive, "Navie          "},
+                                   {&avx2, "Avx2           "},
+                                   {&unrollall, "Avx512UnrollAll"}}) {
+      impl->SetColorFilter(ColorFilter::Bayer);
+      std::print("{} ", impl_name);
+      MEASURE_BEGIN();
+      impl->Execute(src, dst, binning, binning);
+      MEASURE_END();
+      impl->SetColorFilter(ColorFilter::Mono);
+    }
+  }
+
+  // 2x2, 4x4, 8x8のプレビューをExecute 3回と1パスのExecutePyramidで比較する
+  std::println("Pyramid 2x2/4x4/8x8");
+  {
+    cv::Mat dst8x8 = cv::Mat(src.size() / 8, src.type());
+    std::vector<cv::Mat> pyramid;
+    for (auto [impl, impl_name] : {std::pair<BinningBase*, const char*>{&naive, "Navie          "},
+                                   {&avx2, "Avx2           "},
+                                   {&unrollall, "Avx512UnrollAll"}}) {
+      std::print("{} Execute x3     ", impl_name);
+      MEASURE_BEGIN();
+      impl->Execute(src, dst2x2, 2, 2);
+      impl->Execute(src, dst4x4, 4, 4);
+      impl->Execute(src, dst8x8, 8, 8);
+      MEASURE_END();
+      std::print("{} ExecutePyramid ", impl_name);
+      MEASURE_BEGIN();
+      impl->ExecutePyramid(src, pyramid, 3);
+      MEASURE_END();
+    }
+  }
+
+  // グラバーから16行ずつ届く場合
+  std::println("Stream 16 rows");
+  for (auto binning : {2u, 4u}) {
+    auto factory_binning = BinningFactory::Create();
+    BinningStream stream(factory_binning, src.cols, binning, binning);
+    cv::Mat dst = cv::Mat(src.size() / binning, src.type());
+    std::print("{}x{} Execute ", binning, binning);
+    MEASURE_BEGIN();
+    factory_binning->Execute(src, dst, binning, binning);
+    MEASURE_END();
+    std::print("{}x{} Stream  ", binning, binning);
+    MEASURE_BEGIN();
+    stream.Reset();
+    for (int32_t y = 0; y < src.rows; y += 16) {
+      stream.Push(src.rowRange(y, std::min(y + 16, src.rows)), [&](const cv::Mat& dst_rows, int32_t dst_y) {
+        cv::Mat dst_roi = dst.rowRange(dst_y, dst_y + dst_rows.rows);
+        dst_rows.copyTo(dst_roi);
+      });
+    }
+    MEASURE_END();
+  }
+
+  // CV_8UC1, CV_32SC1, CV_32FC1の平均をcv::resize(INTER_AREA)と比較する(resizeはCV_32SC1に非対応)
+  std::println("PixelType Average");
+  for (auto [type, type_name] : {std::pair{CV_8UC1, "8UC1"}, {CV_32SC1, "32SC1"}, {CV_32FC1, "32FC1"}}) {
+    cv::Mat src_typed;
+    src.convertTo(src_typed, type);
+    for (auto binning : {2u, 4u}) {
+      cv::Mat dst = cv::Mat(src.size() / binning, type);
+      std::println("{} {}x{}", type_name, binning, binning);
+      for (auto [impl, impl_name] : {std::pair<BinningBase*, const char*>{&naive, "Navie          "},
+                                     {&avx2, "Avx2           "},
+                                     {&unrollall, "Avx512UnrollAll"}}) {
+        impl->SetOutputMode(OutputMode::Average);
+        std::print("{} ", impl_name);
+        MEASURE_BEGIN();
+        impl->Execute(src_typed, dst, binning, binning);
+        MEASURE_END();
+        impl->SetOutputMode(OutputMode::SaturatingSum);
+      }
+      if (type != CV_32SC1) {
+        std::print("cv::resize      ");
+        MEASURE_BEGIN();
+        cv::resize(src_typed, dst, dst.size(), 0, 0, cv::INTER_AREA);
+        MEASURE_END();
+      }
+    }
+  }
+
+  // 256フレームのバースト(小さいROI)をフレームごとのExecuteとExecuteBatchで比較する
+  std::println("Batch 256 frames");
+  for (auto frame_size : {cv::Size(64, 64), cv::Size(256, 256)}) {
+    constexpr int32_t num_frames = 256;
+    std::vector<cv::Mat> frames(num_frames), binned(num_frames);
+    for (auto i : std::views::iota(0, num_frames)) {
+      frames[i] = src(cv::Rect(i * 8, i * 8, frame_size.width, frame_size.height));
+      binned[i] = cv::Mat(frame_size / 2, src.type());
+    }
+    for (auto num_threads : {1, omp_get_max_threads()}) {
+      unrollall.SetNumThreads(num_threads);
+      std::print("{}x{} threads {:2} Execute      ", frame_size.width, frame_size.height, num_threads);
+      MEASURE_BEGIN();
+      for (auto j : std::views::iota(0, num_frames)) {
+        unrollall.Execute(frames[j], binned[j], 2, 2);
+      }
+      MEASURE_END();
+      std::print("{}x{} threads {:2} ExecuteBatch ", frame_size.width, frame_size.height, num_threads);
+      MEASURE_BEGIN();
+      unrollall.ExecuteBatch(frames, binned, 2, 2);
+      MEASURE_END();
+      if (omp_get_max_threads() == 1) {
+        break;
+      }
+    }
+    unrollall.SetNumThreads(1);
+  }
+
+  // dstがキャッシュに収まらないサイズで通常のストアと非テンポラルストアを比較する
+  std::println("StreamingStore");
+  for (auto size : {4096, 8192}) {
+    cv::Mat src_large = cv::Mat(cv::Size(size, size), CV_16UC1);
+    for (auto y : std::views::iota(0, src_large.rows)) {
+      uint16_t* sptry = src_large.ptr<uint16_t>(y);
+      for (auto x : std::views::iota(0, src_large.cols)) {
+        sptry[x] = y + x;
+      }
+    }
+    for (auto binning : {1u, 2u}) {
+      cv::Mat dst = cv::Mat(src_large.size() / static_cast<int32_t>(binning), src_large.type());
+      std::println("{}x{} {}x{}", size, size, binning, binning);
+      for (auto [impl, impl_name] : {std::pair<BinningBase*, const char*>{&avx512, "Avx512          "},
+                                     {&unrollall, "Avx512UnrollAll "},
+                                     {&unrollx, "Avx512UnrollX   "},
+                                     {&unrollload, "Avx512UnrollLoad"},
+                                     {&avx512seq, "Avx512Seq       "},
+                                     {&avx512seqbuffer, "Avx512SeqBuffer "}}) {
+        for (auto streaming_store : {false, true}) {
+          impl->SetStreamingStore(streaming_store);
+          std::print("{} {} ", impl_name, streaming_store ? "stream" : "store ");
+          MEASURE_BEGIN();
+          impl->Execute(src_large, dst, binning, binning);
+          MEASURE_END();
+        }
+        impl->SetStreamingStore(false);
+      }
+    }
+  }
+
+  for (auto num_threads : {1, 2, 4, 8, 16}) {
+    if (num_threads > omp_get_max_threads()) {
+      break;
+    }
+    std::println("Threads: {}", num_threads);
+    naive.SetNumThreads(num_threads);
+    unrollall.SetNumThreads(num_threads);
+    unrollload.SetNumThreads(num_threads);
+
+    std::println("Navie");
+    MEASURE_BEGIN();
+    naive.Execute(src, dst4x4, 4, 4);
+    MEASURE_END();
+
+    std::println("Avx512UnrollAll");
+    MEASURE_BEGIN();
+    unrollall.Execute(src, dst2x2, 2, 2);
+    MEASURE_END();
+
+    MEASURE_BEGIN();
+    unrollall.Execute(src, dst4x4, 4, 4);
+    MEASURE_END();
+
+    std::println("Avx512UnrollLoad");
+    MEASURE_BEGIN();
+    unrollload.Execute(src, dst2x2, 2, 2);
+    MEASURE_END();
+
+    MEASURE_BEGIN();
+    unrollload.Execute(src, dst4x4, 4, 4);
+    MEASURE_END();
+  }
+
   return 0;
 }
@@ -1,5 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
 #include <print>
 #include <random>
 #include <ranges>
@@ -7,6 +13,7 @@
 #include <opencv2/core/core.hpp>
 
 #include "binning.h"
+#include "instruction_info.h"
 
 enum class TestData { max, seq, rand };
 
@@ -39,6 +46,9 @@ void PrintTo(const Impl& impl, std::ostream* os) {
   case (Impl::SeqRead):
     *os << "Impl::SeqRead";
     break;
+  case (Impl::Avx2):
+    *os << "Impl::Avx2";
+    break;
   case (Impl::Avx512):
     *os << "Impl::Avx512";
     break;
@@ -57,25 +67,45 @@ void PrintTo(const Impl& impl, std::ostream* os) {
   case (Impl::Avx512SeqBuffer):
     *os << "Impl::Avx512SeqBuffer";
     break;
+  case (Impl::Auto):
+    *os << "Impl::Auto";
+    break;
   default:
     assert(false);
     *os << "Unknown";
   }
 }
 
+void PrintTo(const OutputMode& output_mode, std::ostream* os) {
+  switch (output_mode) {
+  case (OutputMode::SaturatingSum):
+    *os << "OutputMode::SaturatingSum";
+    break;
+  case (OutputMode::Average):
+    *os << "OutputMode::Average";
+    break;
+  case (OutputMode::WideSum):
+    *os << "OutputMode::WideSum";
+    break;
+  default:
+    *os << "Unknown";
+  }
+}
+
 void PrintTo(const std::shared_ptr<BinningBase>& binning, std::ostream* os) {
   PrintTo(binning->GetImpl(), os);
 }
 
-auto TESTIMPL  = ::testing::Values(std::make_shared<Binning<Impl::SeqRead>>()
-                                   // std::make_shared<Binning<Impl::Avx512>>(),
-                                   // std::make_shared<Binning<Impl::Avx512UnrollX>>(),
-                                   // std::make_shared<Binning<Impl::Avx512UnrollLoad>>(),
-                                   // std::make_shared<Binning<Impl::Avx512Seq>>(),
-                                   // std::make_shared<Binning<Impl::Avx512SeqBuffer>>()
-                                   );
-auto BINNING_X = ::testing::Values(1, 2, 4);
-auto BINNING_Y = ::testing::Values(1, 2, 4);
+auto TESTIMPL  = ::testing::Values(std::make_shared<Binning<Impl::SeqRead>>(),
+                                   std::make_shared<Binning<Impl::Avx2>>(),
+                                   std::make_shared<Binning<Impl::Avx512>>(),
+                                   std::make_shared<Binning<Impl::Avx512UnrollAll>>(),
+                                   std::make_shared<Binning<Impl::Avx512UnrollX>>(),
+                                   std::make_shared<Binning<Impl::Avx512UnrollLoad>>(),
+                                   std::make_shared<Binning<Impl::Avx512Seq>>(),
+                                   std::make_shared<Binning<Impl::Avx512SeqBuffer>>());
+auto BINNING_X = ::testing::Values(1, 2, 3, 4, 8);
+auto BINNING_Y = ::testing::Values(1, 2, 3, 4, 8);
 auto TESTDATA  = ::testing::Values(TestData::max, TestData::seq, TestData::rand);
 
 using TestParams = std::tuple<std::shared_ptr<BinningBase>, uint32_t, uint32_t, TestData>;
@@ -85,7 +115,7 @@ INSTANTIATE_TEST_CASE_P(, BINNING_TEST, ::testing::Combine(TESTIMPL, BINNING_X,
 constexpr int32_t width  = 4096;
 constexpr int32_t height = 4096;
 
-cv::Mat CreateTestData(TestData pattern) {
+cv::Mat CreateTestData_Impl(TestData pattern) {
   cv::Size size(width, height);
   if (pattern == TestData::max) {
     return cv::Mat::ones(size, CV_16UC1) * std::numeric_limits<uint16_t>::max();
@@ -115,6 +145,16 @@ cv::Mat CreateTestData(TestData pattern) {
   }
 }
 
+// 4096x4096のテストデータ生成は重いので，パターンごとに1度だけ作って使い回す
+cv::Mat CreateTestData(TestData pattern) {
+  static std::map<TestData, cv::Mat> cache;
+  auto it = cache.find(pattern);
+  if (it == cache.end()) {
+    it = cache.emplace(pattern, CreateTestData_Impl(pattern)).first;
+  }
+  return it->second;
+}
+
 TEST_P(BINNING_TEST, Normal) {
   const auto params       = GetParam();
   const auto impl         = std::get<0>(params);
@@ -136,3 +176,606 @@ TEST_P(BINNING_TEST, Normal) {
     }
   }
 }
+
+TEST_P(BINNING_TEST, Parallel) {
+  const auto params       = GetParam();
+  const auto impl         = std::get<0>(params);
+  const auto binning_x    = std::get<1>(params);
+  const auto binning_y    = std::get<2>(params);
+  const auto test_pattern = std::get<3>(params);
+
+  cv::Mat src = CreateTestData(test_pattern);
+  cv::Mat ref = cv::Mat::zeros(cv::Size(src.cols / binning_x, src.rows / binning_y), src.type());
+  cv::Mat dst = ref.clone();
+
+  Binning<Impl::Naive> ref_impl;
+  ref_impl.Execute(src, ref, binning_x, binning_y);
+  impl->SetNumThreads(4);
+  impl->Execute(src, dst, binning_x, binning_y);
+  impl->SetNumThreads(1);
+
+  for (auto y : std::views::iota(0, ref.rows)) {
+    for (auto x : std::views::iota(0, ref.cols)) {
+      ASSERT_EQ(ref.ptr<uint16_t>(y)[x], dst.ptr<uint16_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+    }
+  }
+}
+
+class BINNING_OUTPUT_MODE_TEST : public ::testing::TestWithParam<std::tuple<TestParams, OutputMode>> {};
+INSTANTIATE_TEST_CASE_P(, BINNING_OUTPUT_MODE_TEST,
+                        ::testing::Combine(::testing::Combine(TESTIMPL, BINNING_X, BINNING_Y, TESTDATA),
+                                           ::testing::Values(OutputMode::Average, OutputMode::WideSum)));
+
+TEST_P(BINNING_OUTPUT_MODE_TEST, Normal) {
+  const auto [params, output_mode] = GetParam();
+  const auto impl                  = std::get<0>(params);
+  const auto binning_x             = std::get<1>(params);
+  const auto binning_y             = std::get<2>(params);
+  const auto test_pattern          = std::get<3>(params);
+  const int32_t dst_type           = output_mode == OutputMode::WideSum ? CV_32SC1 : CV_16UC1;
+
+  // 奇数幅のROIにしてSIMDの端数処理も確認する
+  cv::Mat src = CreateTestData(test_pattern)(cv::Rect(0, 0, width - 3, height - 5));
+  cv::Mat ref = cv::Mat::zeros(cv::Size(src.cols / binning_x, src.rows / binning_y), dst_type);
+  cv::Mat dst = ref.clone();
+
+  Binning<Impl::Naive> ref_impl;
+  ref_impl.SetOutputMode(output_mode);
+  ref_impl.Execute(src, ref, binning_x, binning_y);
+  impl->SetOutputMode(output_mode);
+  impl->Execute(src, dst, binning_x, binning_y);
+  impl->SetOutputMode(OutputMode::SaturatingSum);
+
+  for (auto y : std::views::iota(0, ref.rows)) {
+    for (auto x : std::views::iota(0, ref.cols)) {
+      if (output_mode == OutputMode::WideSum) {
+        ASSERT_EQ(ref.ptr<int32_t>(y)[x], dst.ptr<int32_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+      } else {
+        ASSERT_EQ(ref.ptr<uint16_t>(y)[x], dst.ptr<uint16_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+      }
+    }
+  }
+}
+
+// Naiveの平均・32bit和を画素ごとの計算と比較する
+TEST(BINNING_OUTPUT_MODE, Naive) {
+  cv::Mat src = CreateTestData(TestData::rand)(cv::Rect(0, 0, 67, 35));
+  for (auto [binning_x, binning_y] : {std::pair{2u, 2u}, {3u, 3u}, {4u, 2u}, {8u, 8u}}) {
+    const cv::Size size(src.cols / binning_x, src.rows / binning_y);
+    cv::Mat average = cv::Mat::zeros(size, CV_16UC1);
+    cv::Mat sum     = cv::Mat::zeros(size, CV_32SC1);
+
+    Binning<Impl::Naive> binning;
+    binning.SetOutputMode(OutputMode::Average);
+    binning.Execute(src, average, binning_x, binning_y);
+    binning.SetOutputMode(OutputMode::WideSum);
+    binning.Execute(src, sum, binning_x, binning_y);
+
+    for (auto y : std::views::iota(0, size.height)) {
+      for (auto x : std::views::iota(0, size.width)) {
+        int64_t expected = 0;
+        for (auto y_b : std::views::iota(0u, binning_y)) {
+          for (auto x_b : std::views::iota(0u, binning_x)) {
+            expected += src.ptr<uint16_t>(y * binning_y + y_b)[x * binning_x + x_b];
+          }
+        }
+        const int64_t num_pixels = binning_x * binning_y;
+        ASSERT_EQ(expected, sum.ptr<int32_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+        ASSERT_EQ(std::llround(static_cast<double>(expected) / num_pixels), average.ptr<uint16_t>(y)[x])
+            << std::format("(y, x)=({}, {})", y, x);
+      }
+    }
+  }
+}
+
+class BINNING_BAYER_TEST : public ::testing::TestWithParam<TestParams> {};
+INSTANTIATE_TEST_CASE_P(, BINNING_BAYER_TEST, ::testing::Combine(TESTIMPL, BINNING_X, BINNING_Y, TESTDATA));
+
+TEST_P(BINNING_BAYER_TEST, Normal) {
+  const auto params       = GetParam();
+  const auto impl         = std::get<0>(params);
+  const auto binning_x    = std::get<1>(params);
+  const auto binning_y    = std::get<2>(params);
+  const auto test_pattern = std::get<3>(params);
+
+  // 奇数幅のROIにしてSIMDの端数処理も確認する
+  cv::Mat src = CreateTestData(test_pattern)(cv::Rect(0, 0, width - 3, height - 5));
+  cv::Mat ref =
+      cv::Mat::zeros(cv::Size(src.cols / (2 * binning_x) * 2, src.rows / (2 * binning_y) * 2), src.type());
+  cv::Mat dst = ref.clone();
+
+  Binning<Impl::Naive> ref_impl;
+  ref_impl.SetColorFilter(ColorFilter::Bayer);
+  ref_impl.Execute(src, ref, binning_x, binning_y);
+  impl->SetColorFilter(ColorFilter::Bayer);
+  impl->SetNumThreads(3);
+  impl->Execute(src, dst, binning_x, binning_y);
+  impl->SetNumThreads(1);
+  impl->SetColorFilter(ColorFilter::Mono);
+
+  for (auto y : std::views::iota(0, ref.rows)) {
+    for (auto x : std::views::iota(0, ref.cols)) {
+      ASSERT_EQ(ref.ptr<uint16_t>(y)[x], dst.ptr<uint16_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+    }
+  }
+}
+
+// 色ごとに異なる値のBayer配列をビニングしても，同じ配置のBayer配列になる
+TEST(BINNING_BAYER, Naive) {
+  constexpr uint16_t color[2][2] = {
+      {1, 2},
+      {3, 4}
+  };
+  cv::Mat src = cv::Mat::zeros(cv::Size(64, 48), CV_16UC1);
+  for (auto y : std::views::iota(0, src.rows)) {
+    for (auto x : std::views::iota(0, src.cols)) {
+      src.ptr<uint16_t>(y)[x] = color[y & 1][x & 1] * (1 + x / 8);
+    }
+  }
+
+  for (auto [binning_x, binning_y] : {std::pair{2u, 2u}, {4u, 2u}, {3u, 3u}}) {
+    const cv::Size size(src.cols / (2 * binning_x) * 2, src.rows / (2 * binning_y) * 2);
+    cv::Mat sum     = cv::Mat::zeros(size, CV_16UC1);
+    cv::Mat average = cv::Mat::zeros(size, CV_16UC1);
+
+    Binning<Impl::Naive> binning;
+    binning.SetColorFilter(ColorFilter::Bayer);
+    binning.Execute(src, sum, binning_x, binning_y);
+    binning.SetOutputMode(OutputMode::Average);
+    binning.Execute(src, average, binning_x, binning_y);
+
+    for (auto y : std::views::iota(0, size.height)) {
+      for (auto x : std::views::iota(0, size.width)) {
+        uint32_t expected = 0;
+        for (auto x_b : std::views::iota(0u, binning_x)) {
+          expected += color[y & 1][x & 1] * (1 + (((x >> 1) * binning_x + x_b) * 2 + (x & 1)) / 8) * binning_y;
+        }
+        ASSERT_EQ(expected, sum.ptr<uint16_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+        ASSERT_EQ((expected + binning_x * binning_y / 2) / (binning_x * binning_y), average.ptr<uint16_t>(y)[x])
+            << std::format("(y, x)=({}, {})", y, x);
+      }
+    }
+  }
+}
+
+class BINNING_PYRAMID_TEST
+    : public ::testing::TestWithParam<std::tuple<std::shared_ptr<BinningBase>, TestData, int32_t>> {};
+INSTANTIATE_TEST_CASE_P(, BINNING_PYRAMID_TEST, ::testing::Combine(TESTIMPL, TESTDATA, ::testing::Values(1, 4)));
+
+TEST_P(BINNING_PYRAMID_TEST, Normal) {
+  const auto [impl, test_pattern, num_threads] = GetParam();
+  constexpr int32_t num_levels                 = 3;
+
+  // 2^num_levelsで割り切れない高さにして下端の処理も確認する
+  cv::Mat src = CreateTestData(test_pattern)(cv::Rect(0, 0, width - 3, height - 5));
+  std::vector<cv::Mat> dst;
+  impl->SetNumThreads(num_threads);
+  impl->ExecutePyramid(src, dst, num_levels);
+  impl->SetNumThreads(1);
+  ASSERT_EQ(dst.size(), num_levels);
+
+  Binning<Impl::Naive> ref_impl;
+  for (auto level : std::views::iota(0, num_levels)) {
+    const uint32_t binning = 2u << level;
+    cv::Mat ref            = cv::Mat::zeros(cv::Size(src.cols / binning, src.rows / binning), src.type());
+    ref_impl.Execute(src, ref, binning, binning);
+    ASSERT_EQ(ref.size(), dst[level].size());
+    for (auto y : std::views::iota(0, ref.rows)) {
+      for (auto x : std::views::iota(0, ref.cols)) {
+        ASSERT_EQ(ref.ptr<uint16_t>(y)[x], dst[level].ptr<uint16_t>(y)[x])
+            << std::format("level={} (y, x)=({}, {})", level, y, x);
+      }
+    }
+  }
+}
+
+// SaturatingSum以外は段ごとのExecuteになる
+TEST(BINNING_PYRAMID, Average) {
+  cv::Mat src = CreateTestData(TestData::rand);
+  std::vector<cv::Mat> dst;
+  auto binning = BinningFactory::Create();
+  binning->SetOutputMode(OutputMode::Average);
+  binning->ExecutePyramid(src, dst, 2);
+  ASSERT_EQ(dst.size(), 2);
+
+  Binning<Impl::Naive> ref_impl;
+  ref_impl.SetOutputMode(OutputMode::Average);
+  for (auto level : std::views::iota(0, 2)) {
+    const uint32_t binning_xy = 2u << level;
+    cv::Mat ref = cv::Mat::zeros(cv::Size(src.cols / binning_xy, src.rows / binning_xy), src.type());
+    ref_impl.Execute(src, ref, binning_xy, binning_xy);
+    for (auto y : std::views::iota(0, ref.rows)) {
+      for (auto x : std::views::iota(0, ref.cols)) {
+        ASSERT_EQ(ref.ptr<uint16_t>(y)[x], dst[level].ptr<uint16_t>(y)[x])
+            << std::format("level={} (y, x)=({}, {})", level, y, x);
+      }
+    }
+  }
+}
+
+// 32bitの入力は段ごとのExecuteになり，直接Executeした結果と一致する
+TEST(BINNING_PYRAMID, Wide) {
+  constexpr int32_t num_levels = 3;
+  std::mt19937 engine(0);
+  for (auto type : {CV_32SC1, CV_32FC1}) {
+    cv::Mat src = cv::Mat::zeros(cv::Size(64, 48), type);
+    for (auto y : std::views::iota(0, src.rows)) {
+      for (auto x : std::views::iota(0, src.cols)) {
+        if (type == CV_32SC1) {
+          // 隣り合う2x2が正と負に飽和し，まとめて足すと打ち消し合う
+          src.ptr<int32_t>(y)[x] = ((x >> 1) + (y >> 1)) % 2 == 0 ? 0x40000000 : -0x40000000;
+        } else {
+          src.ptr<float>(y)[x] = std::uniform_real_distribution<float>(-1e4f, 1e4f)(engine);
+        }
+      }
+    }
+
+    auto binning = BinningFactory::Create();
+    std::vector<cv::Mat> dst;
+    binning->ExecutePyramid(src, dst, num_levels);
+    ASSERT_EQ(dst.size(), num_levels);
+    for (auto level : std::views::iota(0, num_levels)) {
+      const uint32_t binning_xy = 2u << level;
+      cv::Mat ref = cv::Mat::zeros(cv::Size(src.cols / binning_xy, src.rows / binning_xy), type);
+      binning->Execute(src, ref, binning_xy, binning_xy);
+      ASSERT_EQ(ref.size(), dst[level].size());
+      for (auto y : std::views::iota(0, ref.rows)) {
+        for (auto x : std::views::iota(0, ref.cols)) {
+          if (type == CV_32SC1) {
+            ASSERT_EQ(ref.ptr<int32_t>(y)[x], dst[level].ptr<int32_t>(y)[x])
+                << std::format("level={} (y, x)=({}, {})", level, y, x);
+          } else {
+            ASSERT_EQ(ref.ptr<float>(y)[x], dst[level].ptr<float>(y)[x])
+                << std::format("level={} (y, x)=({}, {})", level, y, x);
+          }
+        }
+      }
+    }
+  }
+}
+
+class BINNING_BATCH_TEST
+    : public ::testing::TestWithParam<std::tuple<std::shared_ptr<BinningBase>, uint32_t, uint32_t>> {};
+INSTANTIATE_TEST_CASE_P(, BINNING_BATCH_TEST, ::testing::Combine(TESTIMPL, BINNING_X, BINNING_Y));
+
+// ExecuteBatchの結果がフレームごとのNaiveと一致する．フレーム数がスレッド数より少ない場合と多い場合を確認する
+TEST_P(BINNING_BATCH_TEST, Normal) {
+  const auto [impl, binning_x, binning_y] = GetParam();
+
+  const cv::Mat data = CreateTestData(TestData::rand);
+  const cv::Size frame_size(133, 67);
+  const cv::Size dst_size(frame_size.width / binning_x, frame_size.height / binning_y);
+  for (auto num_frames : {2, 9}) {
+    // 各フレームは別の位置のROI
+    std::vector<cv::Mat> src(num_frames), ref(num_frames), dst(num_frames);
+    cv::Mat src_stack = cv::Mat(cv::Size(frame_size.width, frame_size.height * num_frames), CV_16UC1);
+    cv::Mat dst_stack = cv::Mat::zeros(cv::Size(dst_size.width, dst_size.height * num_frames), CV_16UC1);
+    Binning<Impl::Naive> ref_impl;
+    for (auto i : std::views::iota(0, num_frames)) {
+      src[i]          = data(cv::Rect(i * 7, i * 5, frame_size.width, frame_size.height));
+      ref[i]          = cv::Mat::zeros(dst_size, CV_16UC1);
+      dst[i]          = cv::Mat::zeros(dst_size, CV_16UC1);
+      cv::Mat src_roi = src_stack.rowRange(i * frame_size.height, (i + 1) * frame_size.height);
+      src[i].copyTo(src_roi);
+      ref_impl.Execute(src[i], ref[i], binning_x, binning_y);
+    }
+
+    impl->SetNumThreads(4);
+    impl->ExecuteBatch(src, dst, binning_x, binning_y);
+    impl->ExecuteBatch(src_stack, dst_stack, num_frames, binning_x, binning_y);
+    impl->SetNumThreads(1);
+
+    for (auto i : std::views::iota(0, num_frames)) {
+      for (auto y : std::views::iota(0, dst_size.height)) {
+        for (auto x : std::views::iota(0, dst_size.width)) {
+          ASSERT_EQ(ref[i].ptr<uint16_t>(y)[x], dst[i].ptr<uint16_t>(y)[x])
+              << std::format("frame={} (y, x)=({}, {})", i, y, x);
+          ASSERT_EQ(ref[i].ptr<uint16_t>(y)[x], dst_stack.ptr<uint16_t>(i * dst_size.height + y)[x])
+              << std::format("stack frame={} (y, x)=({}, {})", i, y, x);
+        }
+      }
+    }
+  }
+}
+
+// ランダムな行数のストリップで流し込んだ結果がフレーム全体のExecuteと一致する
+TEST(BINNING_STREAM, Push) {
+  std::mt19937 mt(0);
+  cv::Mat src = CreateTestData(TestData::rand)(cv::Rect(0, 0, 1021, 517));
+  for (auto color_filter : {ColorFilter::Mono, ColorFilter::Bayer}) {
+    for (auto [binning_x, binning_y] : {std::pair{1u, 1u}, {2u, 2u}, {3u, 3u}, {4u, 2u}, {8u, 8u}}) {
+      auto binning = BinningFactory::Create();
+      binning->SetColorFilter(color_filter);
+      const cv::Size dst_size = binning->GetOutputSize(src.size(), binning_x, binning_y);
+      cv::Mat ref             = cv::Mat::zeros(dst_size, CV_16UC1);
+      cv::Mat dst             = cv::Mat::zeros(dst_size, CV_16UC1);
+      binning->Execute(src, ref, binning_x, binning_y);
+
+      BinningStream stream(binning, src.cols, binning_x, binning_y);
+      int32_t next_y = 0;
+      auto callback  = [&](const cv::Mat& dst_rows, int32_t dst_y) {
+        ASSERT_EQ(dst_y, next_y);
+        for (auto y : std::views::iota(0, dst_rows.rows)) {
+          std::memcpy(dst.ptr<uint16_t>(dst_y + y), dst_rows.ptr<uint16_t>(y), dst.cols * sizeof(uint16_t));
+        }
+        next_y += dst_rows.rows;
+      };
+      for (int32_t y = 0; y < src.rows;) {
+        const int32_t num_rows = std::min<int32_t>(1 + mt() % 17, src.rows - y);
+        stream.Push(src.rowRange(y, y + num_rows), callback);
+        y += num_rows;
+      }
+      ASSERT_EQ(next_y, dst.rows);
+
+      for (auto y : std::views::iota(0, ref.rows)) {
+        for (auto x : std::views::iota(0, ref.cols)) {
+          ASSERT_EQ(ref.ptr<uint16_t>(y)[x], dst.ptr<uint16_t>(y)[x])
+              << std::format("{}x{} (y, x)=({}, {})", binning_x, binning_y, y, x);
+        }
+      }
+    }
+  }
+}
+
+// 端数のある幅・高さのROIを入出力にして，行末のマスク処理とstepの扱いを確認する
+TEST_P(BINNING_TEST, Roi) {
+  const auto params       = GetParam();
+  const auto impl         = std::get<0>(params);
+  const auto binning_x    = std::get<1>(params);
+  const auto binning_y    = std::get<2>(params);
+  const auto test_pattern = std::get<3>(params);
+
+  cv::Mat src_all = CreateTestData(test_pattern);
+  cv::Mat src     = src_all(cv::Rect(5, 3, width - 9, height - 7));
+  cv::Mat ref     = cv::Mat::zeros(cv::Size(src.cols / binning_x, src.rows / binning_y), src.type());
+
+  const cv::Rect roi(7, 2, ref.cols, ref.rows);
+  cv::Mat dst_all = cv::Mat::zeros(cv::Size(ref.cols + 16, ref.rows + 4), src.type());
+  cv::Mat dst     = dst_all(roi);
+
+  Binning<Impl::Naive> ref_impl;
+  ref_impl.Execute(src, ref, binning_x, binning_y);
+  impl->Execute(src, dst, binning_x, binning_y);
+
+  for (auto y : std::views::iota(0, dst_all.rows)) {
+    for (auto x : std::views::iota(0, dst_all.cols)) {
+      if (roi.contains(cv::Point(x, y))) {
+        ASSERT_EQ(ref.ptr<uint16_t>(y - roi.y)[x - roi.x], dst_all.ptr<uint16_t>(y)[x])
+            << std::format("(y, x)=({}, {})", y, x);
+      } else {
+        ASSERT_EQ(0, dst_all.ptr<uint16_t>(y)[x]) << std::format("out of roi (y, x)=({}, {})", y, x);
+      }
+    }
+  }
+}
+
+// 非テンポラルストアでも結果が変わらないことを確認する
+// dstの行の先頭が64byte境界に揃う場合と揃わない場合(ROI)の両方を通す
+TEST_P(BINNING_TEST, StreamingStore) {
+  const auto params       = GetParam();
+  const auto impl         = std::get<0>(params);
+  const auto binning_x    = std::get<1>(params);
+  const auto binning_y    = std::get<2>(params);
+  const auto test_pattern = std::get<3>(params);
+
+  for (auto output_mode : {OutputMode::SaturatingSum, OutputMode::Average, OutputMode::WideSum}) {
+    const int32_t dst_type = output_mode == OutputMode::WideSum ? CV_32SC1 : CV_16UC1;
+
+    cv::Mat src     = CreateTestData(test_pattern);
+    cv::Mat ref     = cv::Mat::zeros(cv::Size(src.cols / binning_x, src.rows / binning_y), dst_type);
+    cv::Mat dst     = ref.clone();
+    cv::Mat dst_all = cv::Mat::zeros(cv::Size(ref.cols + 3, ref.rows), dst_type);
+    cv::Mat dst_roi = dst_all(cv::Rect(3, 0, ref.cols, ref.rows));
+
+    Binning<Impl::Naive> ref_impl;
+    ref_impl.SetOutputMode(output_mode);
+    ref_impl.Execute(src, ref, binning_x, binning_y);
+    impl->SetOutputMode(output_mode);
+    impl->SetStreamingStore(true);
+    impl->SetNumThreads(4);
+    impl->Execute(src, dst, binning_x, binning_y);
+    impl->Execute(src, dst_roi, binning_x, binning_y);
+    impl->SetNumThreads(1);
+    impl->SetStreamingStore(false);
+    impl->SetOutputMode(OutputMode::SaturatingSum);
+
+    const size_t row_bytes = ref.cols * ref.elemSize();
+    for (auto y : std::views::iota(0, ref.rows)) {
+      ASSERT_EQ(0, std::memcmp(ref.ptr(y), dst.ptr(y), row_bytes)) << std::format("y={}", y);
+      ASSERT_EQ(0, std::memcmp(ref.ptr(y), dst_roi.ptr(y), row_bytes)) << std::format("roi y={}", y);
+    }
+  }
+}
+
+// CV_16UC1以外の画素型のテストデータ．int32_tは全範囲の乱数にして飽和と負の値の切り捨ても確認する
+cv::Mat CreatePixelTypeTestData(int32_t type) {
+  static std::map<int32_t, cv::Mat> cache;
+  auto it = cache.find(type);
+  if (it != cache.end()) {
+    return it->second;
+  }
+
+  std::mt19937 mt(type);
+  std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+  // 幅・高さはどのビニング係数でも端数が出るようにする
+  cv::Mat data = cv::Mat::zeros(cv::Size(1029, 261), type);
+  for (auto y : std::views::iota(0, data.rows)) {
+    for (auto x : std::views::iota(0, data.cols)) {
+      if (type == CV_8UC1) {
+        data.ptr<uint8_t>(y)[x] = mt() & 0xFF;
+      } else if (type == CV_32SC1) {
+        data.ptr<int32_t>(y)[x] = static_cast<int32_t>(mt());
+      } else {
+        data.ptr<float>(y)[x] = dist(mt);
+      }
+    }
+  }
+  return cache.emplace(type, data).first->second;
+}
+
+class BINNING_PIXEL_TYPE_TEST
+    : public ::testing::TestWithParam<
+          std::tuple<std::shared_ptr<BinningBase>, uint32_t, uint32_t, int32_t, OutputMode>> {};
+INSTANTIATE_TEST_CASE_P(, BINNING_PIXEL_TYPE_TEST,
+                        ::testing::Combine(TESTIMPL, BINNING_X, BINNING_Y,
+                                           ::testing::Values(CV_8UC1, CV_32SC1, CV_32FC1),
+                                           ::testing::Values(OutputMode::SaturatingSum, OutputMode::Average,
+                                                             OutputMode::WideSum)));
+
+TEST_P(BINNING_PIXEL_TYPE_TEST, Normal) {
+  const auto [impl, binning_x, binning_y, type, output_mode] = GetParam();
+
+  cv::Mat src = CreatePixelTypeTestData(type);
+  for (auto color_filter : {ColorFilter::Mono, ColorFilter::Bayer}) {
+    Binning<Impl::Naive> ref_impl;
+    ref_impl.SetOutputMode(output_mode);
+    ref_impl.SetColorFilter(color_filter);
+    const cv::Size dst_size = ref_impl.GetOutputSize(src.size(), binning_x, binning_y);
+    const int32_t dst_type  = ref_impl.GetOutputType(type);
+    cv::Mat ref             = cv::Mat::zeros(dst_size, dst_type);
+    cv::Mat dst             = cv::Mat::zeros(dst_size, dst_type);
+
+    ref_impl.Execute(src, ref, binning_x, binning_y);
+    impl->SetOutputMode(output_mode);
+    impl->SetColorFilter(color_filter);
+    impl->SetNumThreads(3);
+    impl->Execute(src, dst, binning_x, binning_y);
+    impl->SetNumThreads(1);
+    impl->SetColorFilter(ColorFilter::Mono);
+    impl->SetOutputMode(OutputMode::SaturatingSum);
+
+    // floatは足す順番が実装ごとに異なるので誤差を許す
+    const float tolerance = output_mode == OutputMode::Average ? 1e-2f : 1e-2f * binning_x * binning_y;
+    for (auto y : std::views::iota(0, ref.rows)) {
+      for (auto x : std::views::iota(0, ref.cols)) {
+        if (dst_type == CV_32FC1) {
+          ASSERT_NEAR(ref.ptr<float>(y)[x], dst.ptr<float>(y)[x], tolerance) << std::format("(y, x)=({}, {})", y, x);
+        } else if (dst_type == CV_32SC1) {
+          ASSERT_EQ(ref.ptr<int32_t>(y)[x], dst.ptr<int32_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+        } else {
+          ASSERT_EQ(ref.ptr<uint8_t>(y)[x], dst.ptr<uint8_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+        }
+      }
+    }
+  }
+}
+
+// Naiveの画素型ごとの飽和・平均の丸め・出力型を確認する
+TEST(BINNING_PIXEL_TYPE, Naive) {
+  Binning<Impl::Naive> binning;
+
+  cv::Mat u8 = cv::Mat::zeros(cv::Size(4, 2), CV_8UC1);
+  std::fill(u8.begin<uint8_t>(), u8.end<uint8_t>(), 200);
+  u8.ptr<uint8_t>(0)[3] = 1;
+  const std::tuple<OutputMode, int32_t, int32_t, int32_t> u8_cases[] = {
+      {OutputMode::SaturatingSum, CV_8UC1, 255, 255},
+      {OutputMode::Average, CV_8UC1, 200, 150},
+      {OutputMode::WideSum, CV_32SC1, 800, 601},
+  };
+  for (auto [output_mode, type, left, right] : u8_cases) {
+    binning.SetOutputMode(output_mode);
+    ASSERT_EQ(type, binning.GetOutputType(CV_8UC1));
+    cv::Mat dst = cv::Mat::zeros(cv::Size(2, 1), type);
+    binning.Execute(u8, dst, 2, 2);
+    auto at = [&](int32_t x) -> int32_t {
+      return type == CV_8UC1 ? dst.ptr<uint8_t>(0)[x] : dst.ptr<int32_t>(0)[x];
+    };
+    EXPECT_EQ(left, at(0));
+    EXPECT_EQ(right, at(1));
+  }
+
+  // 和: -9, INT32_MAX * 4
+  cv::Mat i32 = cv::Mat::zeros(cv::Size(4, 2), CV_32SC1);
+  const int32_t i32_values[] = {-3, -2, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max(),
+                                -2, -2, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max()};
+  for (auto i : std::views::iota(0, 8)) {
+    i32.ptr<int32_t>(i / 4)[i % 4] = i32_values[i];
+  }
+  cv::Mat i32_dst = cv::Mat::zeros(cv::Size(2, 1), CV_32SC1);
+  binning.SetOutputMode(OutputMode::Average);
+  ASSERT_EQ(CV_32SC1, binning.GetOutputType(CV_32SC1));
+  binning.Execute(i32, i32_dst, 2, 2);
+  EXPECT_EQ(-2, i32_dst.ptr<int32_t>(0)[0]); // (-9 + 2) / 4 = -1.75を切り捨てる
+  EXPECT_EQ(std::numeric_limits<int32_t>::max(), i32_dst.ptr<int32_t>(0)[1]);
+  binning.SetOutputMode(OutputMode::WideSum);
+  ASSERT_EQ(CV_32SC1, binning.GetOutputType(CV_32SC1));
+  binning.Execute(i32, i32_dst, 2, 2);
+  EXPECT_EQ(-9, i32_dst.ptr<int32_t>(0)[0]);
+  EXPECT_EQ(std::numeric_limits<int32_t>::max(), i32_dst.ptr<int32_t>(0)[1]);
+
+  cv::Mat f32 = cv::Mat::zeros(cv::Size(2, 2), CV_32FC1);
+  std::fill(f32.begin<float>(), f32.end<float>(), 0.25f);
+  f32.ptr<float>(1)[1] = -1.0f;
+  cv::Mat f32_dst = cv::Mat::zeros(cv::Size(1, 1), CV_32FC1);
+  binning.SetOutputMode(OutputMode::SaturatingSum);
+  ASSERT_EQ(CV_32FC1, binning.GetOutputType(CV_32FC1));
+  binning.Execute(f32, f32_dst, 2, 2);
+  EXPECT_FLOAT_EQ(-0.25f, f32_dst.ptr<float>(0)[0]);
+  binning.SetOutputMode(OutputMode::Average);
+  binning.Execute(f32, f32_dst, 2, 2);
+  EXPECT_FLOAT_EQ(-0.0625f, f32_dst.ptr<float>(0)[0]);
+}
+
+TEST(BINNING_FACTORY, Create) {
+  using IIIS   = InstructionInfo::InstructionSet;
+  auto binning = BinningFactory::Create();
+  ASSERT_NE(binning, nullptr);
+  if (InstructionInfo::IsSupported(IIIS::AVX512BW)) {
+    EXPECT_EQ(binning->GetImpl(), Impl::Avx512UnrollAll);
+  } else if (InstructionInfo::IsSupported(IIIS::AVX2)) {
+    EXPECT_EQ(binning->GetImpl(), Impl::Avx2);
+  } else {
+    EXPECT_EQ(binning->GetImpl(), Impl::Naive);
+  }
+}
+
+TEST(BINNING_AUTOTUNER, Execute) {
+  const auto profile_path = std::filesystem::temp_directory_path() / "binning_autotuner_test.txt";
+  std::filesystem::remove(profile_path);
+
+  cv::Mat src = CreateTestData(TestData::rand);
+  std::map<std::pair<uint32_t, uint32_t>, Impl> selected;
+  {
+    BinningAutoTuner tuner(profile_path.string());
+    for (auto [binning_x, binning_y] : {std::pair{2u, 2u}, {3u, 3u}, {4u, 4u}}) {
+      cv::Mat ref = cv::Mat::zeros(cv::Size(src.cols / binning_x, src.rows / binning_y), src.type());
+      cv::Mat dst = ref.clone();
+      EXPECT_EQ(tuner.GetSelectedImpl(binning_x, binning_y, src.size()), Impl::None);
+
+      Binning<Impl::Naive>().Execute(src, ref, binning_x, binning_y);
+      tuner.Execute(src, dst, binning_x, binning_y);
+
+      for (auto y : std::views::iota(0, ref.rows)) {
+        for (auto x : std::views::iota(0, ref.cols)) {
+          ASSERT_EQ(ref.ptr<uint16_t>(y)[x], dst.ptr<uint16_t>(y)[x]) << std::format("(y, x)=({}, {})", y, x);
+        }
+      }
+      const Impl impl                  = tuner.GetSelectedImpl(binning_x, binning_y, src.size());
+      selected[{binning_x, binning_y}] = impl;
+      EXPECT_NE(impl, Impl::None);
+    }
+  }
+
+  // 保存したプロファイルから計測せずに同じ実装が選ばれる
+  BinningAutoTuner tuner(profile_path.string());
+  for (const auto& [factor, impl] : selected) {
+    EXPECT_EQ(tuner.GetSelectedImpl(factor.first, factor.second, src.size()), impl);
+  }
+  std::filesystem::remove(profile_path);
+}
+
+TEST(BINNING_AUTOTUNER, LoadProfileRejectsInvalidEnum) {
+  const auto profile_path = std::filesystem::temp_directory_path() / "binning_autotuner_enum_test.txt";
+  {
+    // output_mode, color_filterが範囲外の行は読み飛ばす
+    std::ofstream ofs(profile_path, std::ios::trunc);
+    ofs << std::format("2 2 64 64 {} 0 0 1 0 Naive\n", CV_16UC1);
+    ofs << std::format("3 3 64 64 {} 7 0 1 0 Naive\n", CV_16UC1);
+    ofs << std::format("4 4 64 64 {} 0 -1 1 0 Naive\n", CV_16UC1);
+  }
+  BinningAutoTuner tuner(profile_path.string());
+  EXPECT_EQ(tuner.GetSelectedImpl(2, 2, cv::Size(64, 64)), Impl::Naive);
+  EXPECT_EQ(tuner.GetSelectedImpl(3, 3, cv::Size(64, 64)), Impl::None);
+  EXPECT_EQ(tuner.GetSelectedImpl(4, 4, cv::Size(64, 64)), Impl::None);
+  std::filesystem::remove(profile_path);
+}
@@ -1,16 +1,66 @@
 #include "histo.h"
 
+#include "instruction_info.h"
+
 #include <cassert>
 #include <memory>
 
-MyHisto::MyHisto(int32_t range_max) {
-  assert(parallel_size_ % 2 == 0);
+#include <omp.h>
+
+MyHisto::MyHisto(int32_t range_max, int32_t parallel_size) {
+  assert(parallel_size >= 0);
+  parallel_size_           = parallel_size > 0 ? parallel_size : omp_get_max_threads();
   const int32_t alloc_size = range_max + 1;
+  // 部分ヒストグラムの先頭をキャッシュラインに揃え，さらに1ライン空けて4Kエイリアシングを避ける
+  constexpr int32_t line = 64 / sizeof(int32_t);
+  histo_stride_          = (alloc_size + line - 1) / line * line + line;
+  subhisto_stride_       = histo_stride_;
 #ifdef _MSC_VER
-  histo_ptr_ = std::make_shared<int32_t[]>(alloc_size * parallel_size_);
+  histo_ptr_    = std::make_shared<int32_t[]>(histo_stride_ * parallel_size_);
+  subhisto_ptr_ = std::make_shared<int32_t[]>(subhisto_stride_ * MULTI_WAYS);
 #else
-  histo_ptr_ = std::shared_ptr<int32_t[]>(new (std::align_val_t(64)) int32_t[alloc_size * parallel_size_]);
+  histo_ptr_    = std::shared_ptr<int32_t[]>(new (std::align_val_t(64)) int32_t[histo_stride_ * parallel_size_]);
+  subhisto_ptr_ = std::shared_ptr<int32_t[]>(new (std::align_val_t(64)) int32_t[subhisto_stride_ * MULTI_WAYS]);
 #endif
   histo_     = std::span<int32_t>(histo_ptr_.get(), range_max + 1);
-  histo_all_ = std::span<int32_t>(histo_ptr_.get(), alloc_size * parallel_size_);
+  histo_all_ = std::span<int32_t>(histo_ptr_.get(), histo_stride_ * parallel_size_);
+  subhisto_  = std::span<int32_t>(subhisto_ptr_.get(), subhisto_stride_ * MULTI_WAYS);
+
+  ImplSelector();
+}
+
+void MyHisto::ImplSelector() {
+  // 8-wayは部分ヒストグラムがL2に収まりにくく，4-wayより速くならない
+  if (InstructionInfo::IsSupported(InstructionInfo::InstructionSet::AVX2)) {
+    CreateMultiWay_AutoImpl = &MyHisto::Create_Impl<Method::AVX2_MultiWay4>;
+  } else {
+    CreateMultiWay_AutoImpl = &MyHisto::Create_Impl<Method::MultiWay4>;
+  }
+}
+
+bool MyHisto::HasNearDuplicates(const uint16_t* source, int32_t data_size) {
+  if (data_size < PROBE_SIZE * PROBE_BLOCKS) {
+    return false;
+  }
+  int32_t duplicates = 0;
+  for (int32_t b = 0; b < PROBE_BLOCKS; b++) {
+    const uint16_t* block = source + static_cast<int64_t>(data_size - PROBE_SIZE) * b / (PROBE_BLOCKS - 1);
+    for (int32_t i = PROBE_DISTANCE; i < PROBE_SIZE; i++) {
+      bool duplicate = false;
+      for (int32_t d = 1; d <= PROBE_DISTANCE; d++) {
+        duplicate |= block[i] == block[i - d];
+      }
+      duplicates += duplicate;
+    }
+  }
+  return duplicates * PROBE_RATIO >= PROBE_SIZE * PROBE_BLOCKS;
+}
+
+void MyHisto::Create(uint16_t* source, int32_t data_size) {
+  // MultiWay系は部分ヒストグラムの分だけキャッシュを使うので，値が散らばっている画像ではNaiveより遅い
+  if (HasNearDuplicates(source, data_size)) {
+    (this->*CreateMultiWay_AutoImpl)(source, data_size);
+  } else {
+    Create_Impl<Method::Naive>(source, data_size);
+  }
 }
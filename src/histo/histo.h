@@ -8,13 +8,27 @@ class MyHisto {
 public:
   std::shared_ptr<int32_t[]> histo_ptr_ = nullptr;
   std::span<int32_t> histo_;
+  // Naive_MultiSubloopのスレッドごとの部分ヒストグラム．parallel_size_個をhisto_stride_ずつ並べ，先頭がhisto_
   std::span<int32_t> histo_all_;
-  const int32_t parallel_size_ = 2;
+  int32_t histo_stride_  = 0;
+  int32_t parallel_size_ = 0;
+  // Naive_MultiSubloopの集計で一度に足し込むビン数
+  static constexpr int32_t MERGE_BLOCK = 1024;
+
+  // MultiWay系の作業領域．MULTI_WAYS個の部分ヒストグラムをsubhisto_stride_ずつ並べる
+  static constexpr int32_t MULTI_WAYS = 8;
+  std::shared_ptr<int32_t[]> subhisto_ptr_ = nullptr;
+  std::span<int32_t> subhisto_;
+  int32_t subhisto_stride_ = 0;
 
   enum class Method {
     Naive,
     NaiveUnroll,
     Naive_MultiSubloop,
+    MultiWay4,
+    MultiWay8,
+    AVX2_MultiWay4,
+    AVX2_MultiWay8,
     AVX512VPOPCNTDQ,
     AVX512VPOPCNTDQ_Order,
   };
@@ -22,5 +36,21 @@ public:
 public:
   template<Method m>
   void Create_Impl(uint16_t* source, int32_t data_size);
-  MyHisto(int32_t range_max);
+  // parallel_size: Naive_MultiSubloopのスレッド数．0ならomp_get_max_threads()
+  MyHisto(int32_t range_max, int32_t parallel_size = 0);
+
+  // histo_を作る．近くに同じ値が続く画像はCPUに合わせて選んだMultiWay系，それ以外はNaiveを使う
+  void Create(uint16_t* source, int32_t data_size);
+
+private:
+  // sourceから間隔を空けてPROBE_BLOCKS個のPROBE_SIZE画素を調べ，直前PROBE_DISTANCE画素以内と同じ値の画素が
+  // 1/PROBE_RATIO以上あればMultiWay系を使う
+  static constexpr int32_t PROBE_SIZE     = 256;
+  static constexpr int32_t PROBE_BLOCKS   = 4;
+  static constexpr int32_t PROBE_DISTANCE = 3;
+  static constexpr int32_t PROBE_RATIO    = 8;
+
+  void ImplSelector();
+  static bool HasNearDuplicates(const uint16_t* source, int32_t data_size);
+  void (MyHisto::*CreateMultiWay_AutoImpl)(uint16_t*, int32_t);
 };
@@ -0,0 +1,46 @@
+#include "histo.h"
+#include "histo_multiway.h"
+
+#include <algorithm>
+
+#include <immintrin.h>
+
+namespace {
+// ways個の部分ヒストグラムに数えてから8要素ずつ足し合わせる
+template<int32_t ways>
+void CreateMultiWay(uint16_t* source, int32_t data_size, std::span<int32_t> histo, std::span<int32_t> subhisto,
+                    int32_t stride) {
+  std::fill_n(subhisto.begin(), ways * stride, 0);
+  CountMultiWay<ways>(source, data_size, subhisto.data(), stride);
+
+  constexpr int32_t step   = 256 / 8 / sizeof(int32_t);
+  const int32_t range_size = histo.size();
+  const int32_t simd_end   = range_size / step * step;
+  const int32_t* sptr      = subhisto.data();
+  int32_t v                = 0;
+  for (; v < simd_end; v += step) {
+    __m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptr + v));
+    for (int32_t w = 1; w < ways; w++) {
+      sum = _mm256_add_epi32(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptr + w * stride + v)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(histo.data() + v), sum);
+  }
+  for (; v < range_size; v++) {
+    int32_t sum = 0;
+    for (int32_t w = 0; w < ways; w++) {
+      sum += sptr[w * stride + v];
+    }
+    histo[v] = sum;
+  }
+}
+} // namespace
+
+template<>
+void MyHisto::Create_Impl<MyHisto::Method::AVX2_MultiWay4>(uint16_t* source, int32_t data_size) {
+  CreateMultiWay<4>(source, data_size, histo_, subhisto_, subhisto_stride_);
+}
+
+template<>
+void MyHisto::Create_Impl<MyHisto::Method::AVX2_MultiWay8>(uint16_t* source, int32_t data_size) {
+  CreateMultiWay<8>(source, data_size, histo_, subhisto_, subhisto_stride_);
+}
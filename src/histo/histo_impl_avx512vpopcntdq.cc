@@ -0,0 +1,88 @@
+#pragma GCC target("avx512f,avx512bw,avx512cd,avx512vpopcntdq")
+
+#include "histo.h"
+
+#include <algorithm>
+#include <ranges>
+
+#include <immintrin.h>
+
+template<>
+void MyHisto::Create_Impl<MyHisto::Method::AVX512VPOPCNTDQ>(uint16_t* source, int32_t data_size) {
+  std::ranges::fill(histo_, 0);
+
+  constexpr int32_t step         = 512 / 8 / sizeof(uint16_t);
+  constexpr int32_t half_step    = step >> 1;
+  constexpr int32_t gather_scale = sizeof(int32_t);
+
+  const __m512i zero_v = _mm512_setzero_si512();
+  const __m512i one_v  = _mm512_set1_epi32(1);
+
+  int32_t* hptr = histo_.data();
+
+  const int32_t loop_end = data_size - step + 1;
+  int32_t i              = 0;
+  for (; i < loop_end; i += step) {
+    const __m512i src_v = _mm512_loadu_si512(reinterpret_cast<const void*>(source + i));
+
+    __m512i src_half  = _mm512_unpacklo_epi16(src_v, zero_v);
+    __m512i conflict  = _mm512_conflict_epi32(src_half);
+    __m512i histo_val = _mm512_i32gather_epi32(src_half, hptr, gather_scale);
+    conflict          = _mm512_popcnt_epi32(conflict);
+    histo_val         = _mm512_add_epi32(_mm512_add_epi32(histo_val, conflict), one_v);
+    _mm512_i32scatter_epi32(hptr, src_half, histo_val, gather_scale);
+
+    src_half  = _mm512_unpackhi_epi16(src_v, zero_v);
+    conflict  = _mm512_conflict_epi32(src_half);
+    histo_val = _mm512_i32gather_epi32(src_half, hptr, gather_scale);
+    conflict  = _mm512_popcnt_epi32(conflict);
+    histo_val = _mm512_add_epi32(_mm512_add_epi32(histo_val, conflict), one_v);
+    _mm512_i32scatter_epi32(hptr, src_half, histo_val, gather_scale);
+  }
+  for (; i < data_size; i++) {
+    hptr[source[i]]++;
+  }
+}
+
+template<>
+void MyHisto::Create_Impl<MyHisto::Method::AVX512VPOPCNTDQ_Order>(uint16_t* source, int32_t data_size) {
+  std::ranges::fill(histo_, 0);
+
+  constexpr int32_t step         = 512 / 8 / sizeof(uint16_t);
+  constexpr int32_t half_step    = step >> 1;
+  constexpr int32_t gather_scale = sizeof(int32_t);
+
+  const __m512i zero_v = _mm512_setzero_si512();
+  const __m512i one_v  = _mm512_set1_epi32(1);
+
+  int32_t* hptr = histo_.data();
+
+  const int32_t loop_end = data_size - step + 1;
+  int32_t i              = 0;
+
+  // 次の1ベクトルを先に読んでおく．範囲外を読まないよう，読むのはloop_endより前だけ
+  __m512i src_v = data_size >= step ? _mm512_stream_load_si512(source) : zero_v;
+  for (i = 0; i < loop_end; i += step) {
+    __m512i src_lo       = _mm512_unpacklo_epi16(src_v, zero_v);
+    __m512i src_hi       = _mm512_unpackhi_epi16(src_v, zero_v);
+    __m512i histo_val_lo = _mm512_i32gather_epi32(src_lo, hptr, gather_scale);
+    __m512i conflict_lo  = _mm512_conflict_epi32(src_lo);
+    __m512i conflict_hi  = _mm512_conflict_epi32(src_hi);
+    conflict_lo          = _mm512_popcnt_epi32(conflict_lo);
+    conflict_lo          = _mm512_add_epi32(conflict_lo, one_v);
+    histo_val_lo         = _mm512_add_epi32(histo_val_lo, conflict_lo);
+    _mm512_i32scatter_epi32(hptr, src_lo, histo_val_lo, gather_scale);
+
+    __m512i histo_val_hi = _mm512_i32gather_epi32(src_hi, hptr, gather_scale);
+    conflict_hi          = _mm512_popcnt_epi32(conflict_hi);
+    conflict_hi          = _mm512_add_epi32(conflict_hi, one_v);
+    histo_val_hi         = _mm512_add_epi32(histo_val_hi, conflict_hi);
+    _mm512_i32scatter_epi32(hptr, src_hi, histo_val_hi, gather_scale);
+    if (i + step < loop_end) {
+      src_v = _mm512_stream_load_si512(source + i + step);
+    }
+  }
+  for (; i < data_size; i++) {
+    hptr[source[i]]++;
+  }
+}
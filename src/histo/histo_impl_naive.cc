@@ -1,11 +1,28 @@
 #include "histo.h"
+#include "histo_multiway.h"
 
 #include <algorithm>
 #include <ranges>
 
-#include <immintrin.h>
 #include <omp.h>
 
+namespace {
+// ways個の部分ヒストグラムに数えてから要素ごとに足し合わせる
+template<int32_t ways>
+void CreateMultiWay(uint16_t* source, int32_t data_size, std::span<int32_t> histo, std::span<int32_t> subhisto,
+                    int32_t stride) {
+  std::fill_n(subhisto.begin(), ways * stride, 0);
+  CountMultiWay<ways>(source, data_size, subhisto.data(), stride);
+  for (int32_t v = 0; v < static_cast<int32_t>(histo.size()); v++) {
+    int32_t sum = 0;
+    for (int32_t w = 0; w < ways; w++) {
+      sum += subhisto[w * stride + v];
+    }
+    histo[v] = sum;
+  }
+}
+} // namespace
+
 template<>
 void MyHisto::Create_Impl<MyHisto::Method::Naive>(uint16_t* source, int32_t data_size) {
   std::ranges::fill(histo_, 0);
@@ -35,109 +52,54 @@ void MyHisto::Create_Impl<MyHisto::Method::NaiveUnroll>(uint16_t* source, int32_
 }
 
 template<>
-void MyHisto::Create_Impl<MyHisto::Method::AVX512VPOPCNTDQ>(uint16_t* source, int32_t data_size) {
-  std::ranges::fill(histo_, 0);
-
-  constexpr int32_t step         = 512 / 8 / sizeof(uint16_t);
-  constexpr int32_t half_step    = step >> 1;
-  constexpr int32_t gather_scale = sizeof(int32_t);
-
-  const __m512i zero_v = _mm512_setzero_si512();
-  const __m512i one_v  = _mm512_set1_epi32(1);
-
-  int32_t* hptr = histo_.data();
-
-  const int32_t loop_end = data_size - step + 1;
-  int32_t i              = 0;
-  for (; i < loop_end; i += step) {
-    const __m512i src_v = _mm512_loadu_si512(reinterpret_cast<const void*>(source + i));
+void MyHisto::Create_Impl<MyHisto::Method::Naive_MultiSubloop>(uint16_t* source, int32_t data_size) {
+  const int32_t range_size = histo_.size();
+  const int32_t stride     = histo_stride_;
+  int32_t* hptr            = histo_all_.data();
 
-    __m512i src_half  = _mm512_unpacklo_epi16(src_v, zero_v);
-    __m512i conflict  = _mm512_conflict_epi32(src_half);
-    __m512i histo_val = _mm512_i32gather_epi32(src_half, hptr, gather_scale);
-    conflict          = _mm512_popcnt_epi32(conflict);
-    histo_val         = _mm512_add_epi32(_mm512_add_epi32(histo_val, conflict), one_v);
-    _mm512_i32scatter_epi32(hptr, src_half, histo_val, gather_scale);
+#pragma omp parallel num_threads(parallel_size_)
+  {
+    // 実際のスレッド数はparallel_size_より少ないことがある
+    const int32_t num_threads = omp_get_num_threads();
+    const int32_t thread_id   = omp_get_thread_num();
+
+    int32_t* sub = hptr + thread_id * stride;
+    std::fill_n(sub, range_size, 0);
+    const int32_t begin = static_cast<int64_t>(data_size) * thread_id / num_threads;
+    const int32_t end   = static_cast<int64_t>(data_size) * (thread_id + 1) / num_threads;
+    for (int32_t i = begin; i < end; i++) {
+      sub[source[i]]++;
+    }
+#pragma omp barrier
 
-    src_half  = _mm512_unpackhi_epi16(src_v, zero_v);
-    conflict  = _mm512_conflict_epi32(src_half);
-    histo_val = _mm512_i32gather_epi32(src_half, hptr, gather_scale);
-    conflict  = _mm512_popcnt_epi32(conflict);
-    histo_val = _mm512_add_epi32(_mm512_add_epi32(histo_val, conflict), one_v);
-    _mm512_i32scatter_epi32(hptr, src_half, histo_val, gather_scale);
+    // ビンの範囲をスレッド数で分け，各スレッドが担当範囲に全スレッドの部分ヒストグラムを足し込む．
+    // 範囲の境目はキャッシュラインに揃え，隣のスレッドと同じラインに書かない．
+    // 足し込む先はL1に収まるMERGE_BLOCKビンずつ区切り，部分ヒストグラムごとに読み直さない
+    constexpr int32_t line   = 64 / sizeof(int32_t);
+    const int32_t chunk_size = (range_size + num_threads * line - 1) / (num_threads * line) * line;
+#pragma omp for schedule(static)
+    for (int32_t chunk = 0; chunk < range_size; chunk += chunk_size) {
+      const int32_t chunk_end = std::min(chunk + chunk_size, range_size);
+      for (int32_t block = chunk; block < chunk_end; block += MERGE_BLOCK) {
+        const int32_t block_end = std::min(block + MERGE_BLOCK, chunk_end);
+        for (int32_t t = 1; t < num_threads; t++) {
+          const int32_t* src = hptr + t * stride;
+#pragma omp simd
+          for (int32_t v = block; v < block_end; v++) {
+            hptr[v] += src[v];
+          }
+        }
+      }
+    }
   }
 }
 
 template<>
-void MyHisto::Create_Impl<MyHisto::Method::AVX512VPOPCNTDQ_Order>(uint16_t* source, int32_t data_size) {
-  std::ranges::fill(histo_, 0);
-  __m512i src_v = _mm512_stream_load_si512(source);
-
-  constexpr int32_t step         = 512 / 8 / sizeof(uint16_t);
-  constexpr int32_t half_step    = step >> 1;
-  constexpr int32_t gather_scale = sizeof(int32_t);
-
-  const __m512i zero_v = _mm512_setzero_si512();
-  const __m512i one_v  = _mm512_set1_epi32(1);
-
-  int32_t* hptr = histo_.data();
-
-  const int32_t loop_end = data_size - step + 1;
-  int32_t i              = 0;
-
-  for (i = 0; i < loop_end; i += step) {
-    __m512i src_lo       = _mm512_unpacklo_epi16(src_v, zero_v);
-    __m512i src_hi       = _mm512_unpackhi_epi16(src_v, zero_v);
-    __m512i histo_val_lo = _mm512_i32gather_epi32(src_lo, hptr, gather_scale);
-    __m512i conflict_lo  = _mm512_conflict_epi32(src_lo);
-    __m512i conflict_hi  = _mm512_conflict_epi32(src_hi);
-    conflict_lo          = _mm512_popcnt_epi32(conflict_lo);
-    conflict_lo          = _mm512_add_epi32(conflict_lo, one_v);
-    histo_val_lo         = _mm512_add_epi32(histo_val_lo, conflict_lo);
-    _mm512_i32scatter_epi32(hptr, src_lo, histo_val_lo, gather_scale);
-
-    __m512i histo_val_hi = _mm512_i32gather_epi32(src_hi, hptr, gather_scale);
-    conflict_hi          = _mm512_popcnt_epi32(conflict_hi);
-    conflict_hi          = _mm512_add_epi32(conflict_hi, one_v);
-    histo_val_hi         = _mm512_add_epi32(histo_val_hi, conflict_hi);
-    _mm512_i32scatter_epi32(hptr, src_hi, histo_val_hi, gather_scale);
-    src_v = _mm512_stream_load_si512(source + i + step);
-  }
+void MyHisto::Create_Impl<MyHisto::Method::MultiWay4>(uint16_t* source, int32_t data_size) {
+  CreateMultiWay<4>(source, data_size, histo_, subhisto_, subhisto_stride_);
 }
 
-// TODO: Multi Naive + Naive Conv
 template<>
-void MyHisto::Create_Impl<MyHisto::Method::Naive_MultiSubloop>(uint16_t* source, int32_t data_size) {
-  const int32_t range_max     = histo_.size();
-  const int32_t sub_data_end  = data_size / parallel_size_;
-  const int32_t sub_range_end = range_max / parallel_size_;
-  std::ranges::fill(histo_all_, 0);
-
-  int32_t* hptr = histo_.data();
-#pragma omp parallel num_threads(2)
-  {
-#pragma omp for nowait
-    for (int32_t j = 0; j < data_size; j += 8) {
-      hptr[omp_get_thread_num() * range_max + source[j]]++;
-      hptr[omp_get_thread_num() * range_max + source[j + 1]]++;
-      hptr[omp_get_thread_num() * range_max + source[j + 2]]++;
-      hptr[omp_get_thread_num() * range_max + source[j + 3]]++;
-      hptr[omp_get_thread_num() * range_max + source[j + 4]]++;
-      hptr[omp_get_thread_num() * range_max + source[j + 5]]++;
-      hptr[omp_get_thread_num() * range_max + source[j + 6]]++;
-      hptr[omp_get_thread_num() * range_max + source[j + 7]]++;
-    }
-
-#pragma omp barrier
-    const int32_t step = 512 / 8 / sizeof(int32_t);
-
-#pragma omp for nowait
-    for (int32_t j = 0; j < range_max; j += step) {
-      __m512i tmp = _mm512_loadu_si512(reinterpret_cast<const void*>(hptr + range_max + j));
-      __m512i src = _mm512_loadu_si512(reinterpret_cast<const void*>(hptr + j));
-      _mm512_storeu_si512(hptr + j, _mm512_add_epi32(tmp, src));
-    }
-  }
+void MyHisto::Create_Impl<MyHisto::Method::MultiWay8>(uint16_t* source, int32_t data_size) {
+  CreateMultiWay<8>(source, data_size, histo_, subhisto_, subhisto_stride_);
 }
-// TODO: Multi Naive + AVX CONV
-// TODO: conflict popcnt 確認せずに並列数ヒストグラム作り，最後に各要素で水平加算
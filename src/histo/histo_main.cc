@@ -4,6 +4,7 @@
 #include <cmath>
 #include <concepts>
 #include <format>
+#include <functional>
 #include <iostream>
 #include <new>
 #include <random>
@@ -11,7 +12,9 @@
 #include <valarray>
 
 #include <histo.h>
+#include <instruction_info.h>
 
+#include <omp.h>
 #include <opencv2/opencv.hpp>
 
 template<typename T, typename U>
@@ -29,6 +32,13 @@ double CalcMse(std::span<T> t, std::span<U> u) {
   return diff;
 }
 
+using CreateFunc = void (*)(MyHisto&, uint16_t*, int32_t);
+
+template<MyHisto::Method m>
+void CreateBy(MyHisto& histo, uint16_t* source, int32_t data_size) {
+  histo.Create_Impl<m>(source, data_size);
+}
+
 auto main() -> int {
   constexpr int32_t ALIGN_SIZE = 64;
   constexpr int32_t RANGE_MAX  = 0xFFFF;
@@ -39,10 +49,18 @@ auto main() -> int {
   std::valarray<int32_t> resolution_list = {1024, 2048};
   // std::valarray<int32_t> resolution_list = {8192};
 
+  using IIIS                     = InstructionInfo::InstructionSet;
+  const bool supported_avx2      = InstructionInfo::IsSupported(IIIS::AVX2);
+  const bool supported_vpopcntdq = InstructionInfo::IsSupported(IIIS::AVX512F) &&
+                                   InstructionInfo::IsSupported(IIIS::AVX512BW) &&
+                                   InstructionInfo::IsSupported(IIIS::AVX512CD) &&
+                                   InstructionInfo::IsSupported(IIIS::AVX512_VPOPCNTDQ);
+
   decltype(std::chrono::high_resolution_clock::now()) start, end;
   std::random_device seed;
   std::mt19937 engine(seed());
   std::normal_distribution<> norm_dist(RANGE_SIZE >> 1, RANGE_SIZE / 10);
+  std::normal_distribution<> narrow_dist(RANGE_SIZE >> 1, 2);
 
 #ifdef _MSC_VER
   auto src_ptr = std::make_shared<uint16_t[]>(resolution_list.max() * resolution_list.max());
@@ -54,65 +72,62 @@ auto main() -> int {
 #endif
   std::span<int32_t> ref(ref_ptr.get(), RANGE_SIZE);
 
-  for (auto resolution : resolution_list) {
-    std::cout << std::format("data_size: {1}x{1}", resolution, resolution) << std::endl;
-    const int32_t data_size = resolution * resolution;
-    std::span<uint16_t> src(src_ptr.get(), data_size);
-
-    cv::Mat mat_src(cv::Size(resolution, resolution), CV_16UC1);
-    uint16_t* msptr = mat_src.ptr<uint16_t>(0, 0);
-
-    for (auto& elem : src) {
-      elem = static_cast<int32_t>(norm_dist(engine)) & RANGE_MAX;
-    }
-    for (int32_t i = 0; i < data_size; i++) {
-      msptr[i] = src[i];
-    }
-    std::ranges::fill(ref, 0);
-    for (auto& elem : src) {
-      ref[elem]++;
-    }
-
-    MyHisto myhisto(RANGE_SIZE);
-    start = std::chrono::high_resolution_clock::now();
-    for (auto loop_i : std::views::iota(0, LOOP_COUNT)) {
-      myhisto.Create_Impl<MyHisto::Method::Naive>(src.data(), src.size());
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
-    std::cout << CalcMse(myhisto.histo_, ref) << std::endl;
+  // 値の散らばり方ごとの画素値．narrowとflatは同じ値が続くのでNaiveがストアからロードへのフォワーディング待ちで遅くなる
+  const std::pair<const char*, std::function<uint16_t()>> distribution_list[] = {
+      {"normal", [&] { return static_cast<int32_t>(norm_dist(engine)) & RANGE_MAX; } },
+      {"narrow", [&] { return static_cast<int32_t>(narrow_dist(engine)) & RANGE_MAX; }},
+      {"flat",   [&] { return RANGE_SIZE >> 1; }                                     },
+  };
 
+  MyHisto myhisto(RANGE_MAX);
+  auto measure = [&](const char* name, std::span<uint16_t> src, CreateFunc create) {
     start = std::chrono::high_resolution_clock::now();
     for (auto loop_i : std::views::iota(0, LOOP_COUNT)) {
-      myhisto.Create_Impl<MyHisto::Method::NaiveUnroll>(src.data(), src.size());
+      create(myhisto, src.data(), src.size());
     }
     end = std::chrono::high_resolution_clock::now();
-    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
-    std::cout << CalcMse(myhisto.histo_, ref) << std::endl;
+    std::cout << std::format("{:22}: {:6} ms, mse {}", name,
+                             std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(),
+                             CalcMse(myhisto.histo_, ref))
+              << std::endl;
+  };
 
-    start = std::chrono::high_resolution_clock::now();
-    for (auto loop_i : std::views::iota(0, LOOP_COUNT)) {
-      myhisto.Create_Impl<MyHisto::Method::AVX512VPOPCNTDQ>(src.data(), src.size());
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
-    std::cout << CalcMse(myhisto.histo_, ref) << std::endl;
-
-    start = std::chrono::high_resolution_clock::now();
-    for (auto loop_i : std::views::iota(0, LOOP_COUNT)) {
-      myhisto.Create_Impl<MyHisto::Method::AVX512VPOPCNTDQ_Order>(src.data(), src.size());
-    }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
-    std::cout << CalcMse(myhisto.histo_, ref) << std::endl;
+  for (auto resolution : resolution_list) {
+    const int32_t data_size = resolution * resolution;
+    std::span<uint16_t> src(src_ptr.get(), data_size);
 
-    start = std::chrono::high_resolution_clock::now();
-    for (auto loop_i : std::views::iota(0, LOOP_COUNT)) {
-      myhisto.Create_Impl<MyHisto::Method::Naive_MultiSubloop>(src.data(), src.size());
+    for (const auto& [dist_name, generate] : distribution_list) {
+      std::cout << std::format("data_size: {0}x{0}, {1}", resolution, dist_name) << std::endl;
+
+      cv::Mat mat_src(cv::Size(resolution, resolution), CV_16UC1);
+      uint16_t* msptr = mat_src.ptr<uint16_t>(0, 0);
+
+      for (auto& elem : src) {
+        elem = generate();
+      }
+      for (int32_t i = 0; i < data_size; i++) {
+        msptr[i] = src[i];
+      }
+      std::ranges::fill(ref, 0);
+      for (auto& elem : src) {
+        ref[elem]++;
+      }
+
+      measure("Naive", src, CreateBy<MyHisto::Method::Naive>);
+      measure("NaiveUnroll", src, CreateBy<MyHisto::Method::NaiveUnroll>);
+      if (supported_vpopcntdq) {
+        measure("AVX512VPOPCNTDQ", src, CreateBy<MyHisto::Method::AVX512VPOPCNTDQ>);
+        measure("AVX512VPOPCNTDQ_Order", src, CreateBy<MyHisto::Method::AVX512VPOPCNTDQ_Order>);
+      }
+      measure("Naive_MultiSubloop", src, CreateBy<MyHisto::Method::Naive_MultiSubloop>);
+      measure("MultiWay4", src, CreateBy<MyHisto::Method::MultiWay4>);
+      measure("MultiWay8", src, CreateBy<MyHisto::Method::MultiWay8>);
+      if (supported_avx2) {
+        measure("AVX2_MultiWay4", src, CreateBy<MyHisto::Method::AVX2_MultiWay4>);
+        measure("AVX2_MultiWay8", src, CreateBy<MyHisto::Method::AVX2_MultiWay8>);
+      }
+      measure("Create", src, [](MyHisto& histo, uint16_t* source, int32_t size) { histo.Create(source, size); });
     }
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << std::endl;
-    std::cout << CalcMse(myhisto.histo_, ref) << std::endl;
 
     // for (int i = 0; i < RANGE_SIZE; i++) {
     //   std::cout << std::format("{:3}: {:6}, {:6}", i, ref[i], myhisto.histo_[i]) <<
@@ -133,5 +148,42 @@ auto main() -> int {
     // std::cout << CalcMse(myhisto.histo_, ref) << std::endl;
   }
 
+  // 8K画像でのNaive_MultiSubloopのスレッド数ごとの速度
+  {
+    constexpr int32_t RESOLUTION_8K = 8192;
+    constexpr int32_t LOOP_COUNT_8K = 20;
+    const int32_t data_size         = RESOLUTION_8K * RESOLUTION_8K;
+#ifdef _MSC_VER
+    auto src8k_ptr = std::make_shared<uint16_t[]>(data_size);
+#else
+    auto src8k_ptr = std::shared_ptr<uint16_t[]>(new (std::align_val_t(ALIGN_SIZE)) uint16_t[data_size]);
+#endif
+    std::span<uint16_t> src(src8k_ptr.get(), data_size);
+    for (auto& elem : src) {
+      elem = static_cast<int32_t>(norm_dist(engine)) & RANGE_MAX;
+    }
+    std::ranges::fill(ref, 0);
+    for (auto& elem : src) {
+      ref[elem]++;
+    }
+
+    for (int32_t threads = 1;; threads = std::min(threads * 2, omp_get_max_threads())) {
+      MyHisto histo8k(RANGE_MAX, threads);
+      start = std::chrono::high_resolution_clock::now();
+      for (auto loop_i : std::views::iota(0, LOOP_COUNT_8K)) {
+        histo8k.Create_Impl<MyHisto::Method::Naive_MultiSubloop>(src.data(), src.size());
+      }
+      end = std::chrono::high_resolution_clock::now();
+      std::cout << std::format("data_size: {0}x{0}, Naive_MultiSubloop {1:2} threads: {2:6} ms, mse {3}",
+                               RESOLUTION_8K, threads,
+                               std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(),
+                               CalcMse(histo8k.histo_, ref))
+                << std::endl;
+      if (threads == omp_get_max_threads()) {
+        break;
+      }
+    }
+  }
+
   return 0;
 }
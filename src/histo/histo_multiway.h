@@ -0,0 +1,21 @@
+#pragma once
+
+// histo_impl_*.cc 専用．MultiWay系の部分ヒストグラムの数え上げ
+
+#include <cstdint>
+#include <utility>
+
+// 連続するways画素をそれぞれ別の部分ヒストグラム(strideずつ離れている)に数える．端数は0番に数える
+// 同じ値が続いても隣の画素は別のアドレスを更新するので，ストアからロードへのフォワーディング待ちが連鎖しない
+template<int32_t ways>
+inline void CountMultiWay(const uint16_t* source, int32_t data_size, int32_t* subhisto, int32_t stride) {
+  int32_t i = 0;
+  for (; i + ways <= data_size; i += ways) {
+    [&]<int32_t... w>(std::integer_sequence<int32_t, w...>) {
+      ((subhisto[w * stride + source[i + w]]++), ...);
+    }(std::make_integer_sequence<int32_t, ways>{});
+  }
+  for (; i < data_size; i++) {
+    subhisto[source[i]]++;
+  }
+}
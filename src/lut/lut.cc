@@ -1,28 +1,754 @@
 #include "lut.h"
 
-#include <InstructionInfo.h>
+#include "instruction_info.h"
 
-LUT::LUT(int32_t range_max) : range_max_(range_max) {
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <span>
+#include <sstream>
+
+#include <omp.h>
+
+namespace {
+// 64byteに揃えて0で初期化した配列
+template<typename T>
+std::shared_ptr<T[]> MakeAlignedArray(int32_t size) {
 #ifdef _MSC_VER
-  lut_ = std::shared_ptr<uint32_t[]>(new uint32_t[range_max]);
+  return std::shared_ptr<T[]>(new T[size]());
 #else
-  lut_ = std::shared_ptr<uint32_t[]>(new (std::align_val_t(64)) uint32_t[range_max]);
+  return std::shared_ptr<T[]>(new (std::align_val_t(64)) T[size]());
 #endif
+}
+
+// lut8_はgatherで末尾から4byte読む分と，avx512vbmi_lut8_permuteで256byte読む分の余白を取る
+int32_t Lut8Size(int32_t range_max) {
+  return std::max(range_max, 256) + 64;
+}
+} // namespace
+
+LUT::LUT(int32_t range_max, Storage storage) : range_max_(range_max), storage_(storage) {
+  lut_            = MakeAlignedArray<uint32_t>(range_max);
+  lut8_           = MakeAlignedArray<uint8_t>(Lut8Size(range_max));
+  palette_        = MakeAlignedArray<uint32_t>(256);
+  palette_planes_ = MakeAlignedArray<uint8_t>(4 * 256);
+  lut256_         = MakeAlignedArray<uint8_t>(256);
+  build_end_      = range_max;
+  SetColormap(MakeColormap(Colormap::Gray));
   ImplSelector();
 }
 
 void LUT::ImplSelector() {
+  const bool byte = storage_ == Storage::Byte;
   if (InstructionInfo::IsSupported(InstructionInfo::InstructionSet::AVX512_VBMI)) {
-    Create_AutoImpl  = &LUT::Create_Impl<Method::naive_calc>;
-    Convert_AutoImpl = &LUT::Convert_Impl<Method::avx512vbmi_calc>;
+    Create_AutoImpl      = &LUT::Create_Impl<Method::naive_calc>;
+    // uint8_tの曲線は区間ごとのmemsetなので，AVX-512の版はない
+    CreateCurve_AutoImpl =
+        byte ? &LUT::CreateCurve_Impl<Method::avx2_lut8> : &LUT::CreateCurve_Impl<Method::avx512f_lut>;
+    Convert_LinearImpl   = &LUT::Convert_Impl<Method::avx512vbmi_calc>;
+    Convert_TableImpl    =
+        byte ? &LUT::Convert_Impl<Method::avx512vbmi_lut8> : &LUT::Convert_Impl<Method::avx512vbmi_lut>;
+    if (byte && range_max_ <= 256) {
+      Convert_TableImpl = &LUT::Convert_Impl<Method::avx512vbmi_lut8_permute>;
+    }
+    Convert_IntWeightEpu16Impl = &LUT::Convert_Impl<Method::avx512vbmi_calc_intweight_epu16>;
+    Convert_IntWeightEpi32Impl = nullptr; // avx512vbmi_calcと同程度なので使わない
+    ExpandPalette_AutoImpl     = &LUT::ExpandPalette_Impl<Method::avx512vbmi_palette>;
+    Convert8_AutoImpl          = &LUT::Convert8_Impl<Method::avx512vbmi_src8_permute>;
   } else if (InstructionInfo::IsSupported(InstructionInfo::InstructionSet::AVX512F)) {
-    Create_AutoImpl  = &LUT::Create_Impl<Method::naive_calc>;
-    Convert_AutoImpl = &LUT::Convert_Impl<Method::avx512f_calc>;
+    Create_AutoImpl      = &LUT::Create_Impl<Method::naive_calc>;
+    CreateCurve_AutoImpl =
+        byte ? &LUT::CreateCurve_Impl<Method::avx2_lut8> : &LUT::CreateCurve_Impl<Method::avx512f_lut>;
+    Convert_LinearImpl   = &LUT::Convert_Impl<Method::avx512f_calc>;
+    Convert_TableImpl    = byte ? &LUT::Convert_Impl<Method::avx512f_lut8> : &LUT::Convert_Impl<Method::avx512f_lut>;
+    // AVX-512Fだけではepu16の乗算がないのでAVX2版を使う．それでもavx512f_calcより速い
+    Convert_IntWeightEpu16Impl = &LUT::Convert_Impl<Method::avx2_calc_intweight_epu16>;
+    Convert_IntWeightEpi32Impl = nullptr;
+    ExpandPalette_AutoImpl     = &LUT::ExpandPalette_Impl<Method::avx512f_palette>;
+    Convert8_AutoImpl          = &LUT::Convert8_Impl<Method::avx2_src8_pshufb>;
   } else if (InstructionInfo::IsSupported(InstructionInfo::InstructionSet::AVX2)) {
-    Create_AutoImpl  = &LUT::Create_Impl<Method::avx2_lut>;
-    Convert_AutoImpl = &LUT::Convert_Impl<Method::avx2_lut>;
+    Create_AutoImpl      = byte ? &LUT::Create_Impl<Method::avx2_lut8> : &LUT::Create_Impl<Method::avx2_lut>;
+    CreateCurve_AutoImpl = byte ? &LUT::CreateCurve_Impl<Method::avx2_lut8> : &LUT::CreateCurve_Impl<Method::avx2_lut>;
+    Convert_LinearImpl   = byte ? &LUT::Convert_Impl<Method::avx2_lut8> : &LUT::Convert_Impl<Method::avx2_lut>;
+    Convert_TableImpl    = Convert_LinearImpl;
+    Convert_IntWeightEpu16Impl = &LUT::Convert_Impl<Method::avx2_calc_intweight_epu16>;
+    Convert_IntWeightEpi32Impl = &LUT::Convert_Impl<Method::avx2_calc_intweight_epi32>;
+    ExpandPalette_AutoImpl     = &LUT::ExpandPalette_Impl<Method::avx2_palette>;
+    Convert8_AutoImpl          = &LUT::Convert8_Impl<Method::avx2_src8_pshufb>;
+  } else {
+    Create_AutoImpl      = byte ? &LUT::Create_Impl<Method::naive_lut8> : &LUT::Create_Impl<Method::naive_lut>;
+    CreateCurve_AutoImpl =
+        byte ? &LUT::CreateCurve_Impl<Method::naive_lut8> : &LUT::CreateCurve_Impl<Method::naive_lut>;
+    Convert_LinearImpl   = byte ? &LUT::Convert_Impl<Method::naive_lut8> : &LUT::Convert_Impl<Method::naive_lut>;
+    Convert_TableImpl    = Convert_LinearImpl;
+    Convert_IntWeightEpu16Impl = nullptr;
+    Convert_IntWeightEpi32Impl = nullptr;
+    ExpandPalette_AutoImpl     = &LUT::ExpandPalette_Impl<Method::naive_palette>;
+    Convert8_AutoImpl          = &LUT::Convert8_Impl<Method::naive_src8>;
+  }
+  Convert_AutoImpl   = Convert_LinearImpl;
+  create_uses_table_ = Create_AutoImpl != &LUT::Create_Impl<Method::naive_calc>;
+}
+
+std::vector<LUT::CalibrationCandidate> LUT::CalibrationCandidates() const {
+  using IS          = InstructionInfo::InstructionSet;
+  const bool avx2   = InstructionInfo::IsSupported(IS::AVX2);
+  const bool avx512 = InstructionInfo::IsSupported(IS::AVX512F) && InstructionInfo::IsSupported(IS::AVX512BW) &&
+                      InstructionInfo::IsSupported(IS::AVX512VL);
+  const bool vbmi = avx512 && InstructionInfo::IsSupported(IS::AVX512_VBMI);
+  const bool byte = storage_ == Storage::Byte;
+
+  // *_lut, *_lut8のテーブルはSIMDの版があればそれで作る(どれもnaive_lut(8)と一致する)
+  const auto create_lut  = byte ? &LUT::Create_Impl<Method::naive_lut8> : &LUT::Create_Impl<Method::naive_lut>;
+  auto create_simd       = create_lut;
+  if (avx512) {
+    create_simd = byte ? &LUT::Create_Impl<Method::avx512f_lut8> : &LUT::Create_Impl<Method::avx512f_lut>;
+  } else if (avx2) {
+    create_simd = byte ? &LUT::Create_Impl<Method::avx2_lut8> : &LUT::Create_Impl<Method::avx2_lut>;
+  }
+  const auto create_calc = &LUT::Create_Impl<Method::naive_calc>;
+
+  // linearの候補はnaive_lut(8)と一致するテーブル参照だけにする．*_calcはnaive_lutと1ずれることがあり，
+  // 計測の揺れで選ばれると同じ窓でも出力が変わる．linearが一致するので，intweightを使わない(none)場合も一致する
+  std::vector<CalibrationCandidate> candidates;
+  auto add = [&](bool supported, std::string_view role, std::string_view name, auto create, auto convert) {
+    if (supported) {
+      candidates.push_back({role, name, create, convert});
+    }
+  };
+  if (byte) {
+    add(true, "linear", "naive_lut8", create_lut, &LUT::Convert_Impl<Method::naive_lut8>);
+    add(avx2, "linear", "avx2_lut8", create_simd, &LUT::Convert_Impl<Method::avx2_lut8>);
+    add(avx512, "linear", "avx512f_lut8", create_simd, &LUT::Convert_Impl<Method::avx512f_lut8>);
+    add(vbmi, "linear", "avx512vbmi_lut8", create_simd, &LUT::Convert_Impl<Method::avx512vbmi_lut8>);
+    add(true, "table", "naive_lut8", create_lut, &LUT::Convert_Impl<Method::naive_lut8>);
+    add(avx2, "table", "avx2_lut8", create_lut, &LUT::Convert_Impl<Method::avx2_lut8>);
+    add(avx512, "table", "avx512f_lut8", create_lut, &LUT::Convert_Impl<Method::avx512f_lut8>);
+    add(vbmi, "table", "avx512vbmi_lut8", create_lut, &LUT::Convert_Impl<Method::avx512vbmi_lut8>);
+    if (range_max_ <= 256) {
+      add(vbmi, "linear", "avx512vbmi_lut8_permute", create_simd, &LUT::Convert_Impl<Method::avx512vbmi_lut8_permute>);
+      add(vbmi, "table", "avx512vbmi_lut8_permute", create_lut, &LUT::Convert_Impl<Method::avx512vbmi_lut8_permute>);
+    }
   } else {
-    Create_AutoImpl  = &LUT::Create_Impl<Method::naive_lut>;
-    Convert_AutoImpl = &LUT::Convert_Impl<Method::naive_lut>;
+    add(true, "linear", "naive_lut", create_lut, &LUT::Convert_Impl<Method::naive_lut>);
+    add(avx2, "linear", "avx2_lut", create_simd, &LUT::Convert_Impl<Method::avx2_lut>);
+    add(avx512, "linear", "avx512f_lut", create_simd, &LUT::Convert_Impl<Method::avx512f_lut>);
+    add(vbmi, "linear", "avx512vbmi_lut", create_simd, &LUT::Convert_Impl<Method::avx512vbmi_lut>);
+    add(true, "table", "naive_lut", create_lut, &LUT::Convert_Impl<Method::naive_lut>);
+    add(avx2, "table", "avx2_lut", create_lut, &LUT::Convert_Impl<Method::avx2_lut>);
+    add(avx512, "table", "avx512f_lut", create_lut, &LUT::Convert_Impl<Method::avx512f_lut>);
+    add(vbmi, "table", "avx512vbmi_lut", create_lut, &LUT::Convert_Impl<Method::avx512vbmi_lut>);
   }
+
+  using ConvertImpl = void (LUT::*)(uint16_t*, uint8_t*, int32_t);
+  add(true, "intweight_epu16", "none", create_calc, ConvertImpl{nullptr});
+  add(avx2, "intweight_epu16", "avx2_calc_intweight_epu16",
+      &LUT::Create_Impl<Method::avx2_calc_intweight_epu16>, &LUT::Convert_Impl<Method::avx2_calc_intweight_epu16>);
+  add(vbmi, "intweight_epu16", "avx512vbmi_calc_intweight_epu16",
+      &LUT::Create_Impl<Method::avx512vbmi_calc_intweight_epu16>,
+      &LUT::Convert_Impl<Method::avx512vbmi_calc_intweight_epu16>);
+  add(true, "intweight_epi32", "none", create_calc, ConvertImpl{nullptr});
+  add(avx2, "intweight_epi32", "avx2_calc_intweight_epi32",
+      &LUT::Create_Impl<Method::avx2_calc_intweight_epi32>, &LUT::Convert_Impl<Method::avx2_calc_intweight_epi32>);
+  add(vbmi, "intweight_epi32", "avx512vbmi_calc_intweight_epi32",
+      &LUT::Create_Impl<Method::avx512vbmi_calc_intweight_epi32>,
+      &LUT::Convert_Impl<Method::avx512vbmi_calc_intweight_epi32>);
+  return candidates;
+}
+
+void LUT::ApplyCalibration(const CalibrationCandidate& candidate) {
+  if (candidate.role == "linear") {
+    Create_AutoImpl    = candidate.create;
+    Convert_LinearImpl = candidate.convert;
+  } else if (candidate.role == "table") {
+    Convert_TableImpl = candidate.convert;
+  } else if (candidate.role == "intweight_epu16") {
+    Convert_IntWeightEpu16Impl = candidate.convert;
+  } else if (candidate.role == "intweight_epi32") {
+    Convert_IntWeightEpi32Impl = candidate.convert;
+  }
+  Convert_AutoImpl   = Convert_LinearImpl;
+  create_uses_table_ = Create_AutoImpl != &LUT::Create_Impl<Method::naive_calc>;
+  lut256_valid_      = false;
+  // テーブルを作るカーネルが変わると同じ窓でも値が変わることがある
+  ClearTableCache();
+}
+
+// paramsはcreated_curve_自身のこともあるので，tableは一旦コピーしてから置き換える
+void LUT::RememberCreate(int32_t lut_min, int32_t lut_max, const CurveParams& params) {
+  std::vector<uint8_t> table(params.table.begin(), params.table.end());
+  created_             = true;
+  created_min_         = lut_min;
+  created_max_         = lut_max;
+  created_curve_       = params;
+  created_table_       = std::move(table);
+  created_curve_.table = created_table_;
+}
+
+// 1行1エントリ: range_max storage role name
+// 乱数の入力(CALIBRATION_SIZE要素)と値域の中央半分の窓で，roleごとに最短時間の候補を選ぶ
+// Createは窓を変えたときだけでテーブルはキャッシュもするので，Convertの時間だけで比べる
+// intweight_*はlinearより遅ければ使わない(none)
+void LUT::Calibrate(const std::string& profile_path) {
+  constexpr std::array<std::string_view, 4> roles = {"linear", "table", "intweight_epu16", "intweight_epi32"};
+  const auto candidates                           = CalibrationCandidates();
+  const int32_t storage                           = static_cast<int32_t>(storage_);
+
+  auto find = [&](std::string_view role, std::string_view name) {
+    return std::ranges::find_if(candidates, [&](const auto& c) { return c.role == role && c.name == name; });
+  };
+
+  // 他のrange_max, Storageの行は保存時にそのまま残す
+  std::vector<std::string> other_lines;
+  std::vector<const CalibrationCandidate*> selected;
+  bool valid = true;
+  if (!profile_path.empty()) {
+    std::ifstream ifs(profile_path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      std::istringstream iss(line);
+      int32_t range_max, line_storage;
+      std::string role, name, rest;
+      // 読めない行は捨てて計測し直す
+      if (!(iss >> range_max >> line_storage >> role >> name) || (iss >> rest)) {
+        valid = false;
+        continue;
+      }
+      if (range_max != range_max_ || line_storage != storage) {
+        other_lines.push_back(line);
+        continue;
+      }
+      // この環境で使えない候補や，同じroleが2回以上記録されている場合は計測し直す
+      auto it = find(role, name);
+      if (it == candidates.end() || std::ranges::any_of(selected, [&](const auto* c) { return c->role == role; })) {
+        valid = false;
+        continue;
+      }
+      selected.push_back(&*it);
+    }
+  }
+  const bool loaded = valid && std::ranges::all_of(roles, [&](std::string_view role) {
+                        return std::ranges::any_of(selected, [&](const auto* c) { return c->role == role; });
+                      });
+
+  if (!loaded) {
+    constexpr int32_t loop_time = 3;
+
+    std::vector<uint16_t> src(CALIBRATION_SIZE);
+    std::vector<uint8_t> dst(CALIBRATION_SIZE);
+    std::mt19937 engine(0);
+    std::uniform_int_distribution<int32_t> dist(0, range_max_ - 1);
+    for (auto& v : src) {
+      v = static_cast<uint16_t>(dist(engine));
+    }
+    const int32_t lut_min = range_max_ / 4;
+    const int32_t lut_max = std::max(range_max_ * 3 / 4 - 1, lut_min);
+
+    auto measure = [&](const CalibrationCandidate& candidate) {
+      (this->*candidate.create)(lut_min, lut_max);
+      (this->*candidate.convert)(src.data(), dst.data(), CALIBRATION_SIZE); // warm up
+
+      auto time = std::chrono::steady_clock::duration::max();
+      for ([[maybe_unused]] auto i : std::views::iota(0, loop_time)) {
+        const auto start = std::chrono::steady_clock::now();
+        (this->*candidate.convert)(src.data(), dst.data(), CALIBRATION_SIZE);
+        time = std::min(time, std::chrono::steady_clock::now() - start);
+      }
+      return time;
+    };
+
+    selected.clear();
+    auto linear_time = std::chrono::steady_clock::duration::max();
+    for (const auto role : roles) {
+      const CalibrationCandidate* fastest = nullptr;
+      auto fastest_time                   = std::chrono::steady_clock::duration::max();
+      for (const auto& candidate : candidates) {
+        if (candidate.role != role || candidate.convert == nullptr) {
+          continue;
+        }
+        const auto time = measure(candidate);
+        if (time < fastest_time) {
+          fastest      = &candidate;
+          fastest_time = time;
+        }
+      }
+      if (role == "linear") {
+        linear_time = fastest_time;
+      } else if (role.starts_with("intweight") && !(fastest_time < linear_time)) {
+        fastest = &*find(role, "none");
+      }
+      if (fastest != nullptr) {
+        selected.push_back(fastest);
+      }
+    }
+
+    if (!profile_path.empty()) {
+      std::ofstream ofs(profile_path, std::ios::trunc);
+      for (const auto& line : other_lines) {
+        ofs << line << '\n';
+      }
+      for (const auto* candidate : selected) {
+        ofs << range_max_ << ' ' << storage << ' ' << candidate->role << ' ' << candidate->name << '\n';
+      }
+    }
+  }
+
+  for (const auto* candidate : selected) {
+    ApplyCalibration(*candidate);
+  }
+  // 計測の窓とカーネルの変更で，テーブルやintweightのパラメータが呼び出し側の窓のものでなくなっている
+  if (created_) {
+    Create(created_min_, created_max_, created_curve_);
+  }
+}
+
+// 固定小数点がnaive_lutと一致する窓では，テーブルを作らずintweightのカーネルで変換する
+void LUT::Create(int32_t lut_min, int32_t lut_max) {
+  RememberCreate(lut_min, lut_max, CurveParams{});
+  lut256_valid_ = false;
+  if (Convert_IntWeightEpu16Impl != nullptr || Convert_IntWeightEpi32Impl != nullptr) {
+    CreateIntWeight(lut_min, lut_max);
+    if (Convert_IntWeightEpu16Impl != nullptr && intweight_epu16_.exact) {
+      Convert_AutoImpl = Convert_IntWeightEpu16Impl;
+      return;
+    }
+    if (Convert_IntWeightEpi32Impl != nullptr && intweight_epi32_.exact) {
+      Convert_AutoImpl = Convert_IntWeightEpi32Impl;
+      return;
+    }
+  }
+  if (create_uses_table_) {
+    CreateTable(lut_min, lut_max, CurveParams{});
+  } else {
+    (this->*Create_AutoImpl)(lut_min, lut_max);
+  }
+  Convert_AutoImpl = Convert_LinearImpl;
+}
+
+namespace {
+// x in [0, max]でmin((x * mul) >> shift, 255)の段の境界がthresholdsと一致するmul(最小のもの)
+// thresholds[k]はnaive_lutの出力がk以上になる最小のx(k = 1..levels)．maxでの出力はlevels
+std::optional<uint32_t> SolveIntWeight(std::span<const int32_t> thresholds, int32_t levels, int32_t max,
+                                       int32_t shift, uint64_t mul_limit) {
+  const int64_t one = int64_t{1} << shift;
+  int64_t lo        = 0;
+  int64_t hi        = std::numeric_limits<int64_t>::max();
+  if (levels < 255 && max > 0) {
+    // 255で頭打ちにならないので，maxでlevelsを超えない
+    hi = ((levels + 1) * one - 1) / max;
+  }
+  for (int32_t k = 1; k <= levels; k++) {
+    // (t - 1) * mul < k * one <= t * mul
+    const int64_t t = thresholds[k];
+    lo              = std::max(lo, (k * one + t - 1) / t);
+    if (t > 1) {
+      hi = std::min(hi, (k * one - 1) / (t - 1));
+    }
+  }
+  hi = std::min<int64_t>(hi, mul_limit);
+  return lo <= hi ? std::optional<uint32_t>(lo) : std::nullopt;
+}
+} // namespace
+
+// naive_lutの出力の段の境界を求め，それと一致する固定小数点の係数を探す
+// 一致するものがない場合はexact = falseとし，近い係数を入れておく(±1ずれる)
+void LUT::CreateIntWeight(int32_t lut_min, int32_t lut_max) {
+  const float coeff = 256.0 / (lut_max - lut_min + 1);
+  auto naive        = [&](int32_t x) { return std::clamp(static_cast<int32_t>(coeff * x), 0, 255); };
+
+  coeff_           = coeff;
+  lut_min_         = lut_min;
+  lut_max_         = lut_max;
+  intweight_epu16_ = {};
+  intweight_epi32_ = {};
+  if (lut_min < 0 || lut_min >= range_max_) {
+    // subs_epu16で負のlut_minは扱えない．lut_minが値域外の場合は全て0
+    intweight_epu16_.exact = lut_min >= range_max_;
+    intweight_epi32_.exact = lut_min >= range_max_;
+    return;
+  }
+
+  const int32_t x_limit = range_max_ - 1 - lut_min;
+  const int32_t levels  = naive(x_limit);
+  std::array<int32_t, 256> thresholds{};
+  for (int32_t k = 1; k <= levels; k++) {
+    int32_t t = std::clamp(static_cast<int32_t>(std::ceil(k / coeff)), 1, x_limit);
+    while (t > 1 && naive(t - 1) >= k) {
+      t--;
+    }
+    while (naive(t) < k) {
+      t++;
+    }
+    thresholds[k] = t;
+  }
+  const int32_t max = levels == 255 ? thresholds[255] : x_limit;
+
+  // epi32: max * mul が32bitに収まる範囲で，なるべく大きいshift
+  intweight_epi32_.max = max;
+  for (int32_t shift = 24; shift >= 0; shift--) {
+    const uint64_t mul_limit = max > 0 ? 0xFFFFFFFFull / max : 0xFFFFFFFFull;
+    if (auto mul = SolveIntWeight(thresholds, levels, max, shift, mul_limit)) {
+      intweight_epi32_ = {true, max, *mul, 0, shift};
+      break;
+    }
+  }
+  if (!intweight_epi32_.exact) {
+    intweight_epi32_.shift = 16;
+    intweight_epi32_.mul   = static_cast<uint32_t>(std::ceil(coeff * 0x10000));
+  }
+
+  // epu16: max << pre_shiftとmulが16bitに収まる範囲．(x << pre_shift) * mul >> (16 + shift)
+  int32_t pre_shift = 0;
+  while (pre_shift < 16 && (static_cast<int64_t>(max) << (pre_shift + 1)) <= 0xFFFF) {
+    pre_shift++;
+  }
+  intweight_epu16_.max       = max;
+  intweight_epu16_.pre_shift = pre_shift;
+  for (int32_t shift = 15; shift >= 0; shift--) {
+    const int32_t total_shift = 16 + shift - pre_shift;
+    if (auto mul = SolveIntWeight(thresholds, levels, max, total_shift, 0xFFFF)) {
+      intweight_epu16_ = {true, max, *mul, pre_shift, shift};
+      break;
+    }
+  }
+  if (!intweight_epu16_.exact) {
+    intweight_epu16_.shift = 0;
+    intweight_epu16_.mul   = std::min(static_cast<uint32_t>(std::ceil(std::ldexp(coeff, 16 - pre_shift))), 0xFFFFu);
+  }
+}
+
+// Linearは従来のCreateと同じ(calcのカーネルを使える)．それ以外はテーブルを作り，テーブル参照のカーネルで変換する
+void LUT::Create(int32_t lut_min, int32_t lut_max, const CurveParams& params) {
+  lut256_valid_ = false;
+  if (params.curve == Curve::Linear) {
+    Create(lut_min, lut_max);
+    return;
+  }
+  RememberCreate(lut_min, lut_max, params);
+  CreateTable(lut_min, lut_max, params);
+  Convert_AutoImpl = Convert_TableImpl;
+}
+
+namespace {
+// 窓以外のパラメータが同じ: 窓の外側(下は曲線の0，上は1の値)が一致する
+bool SameCurve(const LUT::TableCacheEntry& entry, const LUT::CurveParams& params) {
+  if (entry.curve != params.curve) {
+    return false;
+  }
+  switch (params.curve) {
+  case LUT::Curve::Gamma:
+    return entry.gamma == params.gamma;
+  case LUT::Curve::Log:
+  case LUT::Curve::Sigmoid:
+    return entry.gain == params.gain;
+  case LUT::Curve::Table:
+    return std::ranges::equal(entry.table, params.table);
+  default:
+    return true;
+  }
+}
+} // namespace
+
+// キャッシュにあればそのテーブルに切り替える．なければ最も古いエントリのテーブルを作り直す
+// 曲線が同じなら，2つの窓を合わせた範囲の外側は値が変わらないので，その範囲だけ書き換える
+void LUT::CreateTable(int32_t lut_min, int32_t lut_max, const CurveParams& params) {
+  const bool byte = storage_ == Storage::Byte;
+  table_cache_clock_++;
+
+  auto use = [&](TableCacheEntry& entry) {
+    entry.last_used = table_cache_clock_;
+    if (byte) {
+      lut8_ = entry.lut8;
+    } else {
+      lut_ = entry.lut;
+    }
+  };
+
+  for (auto& entry : table_cache_) {
+    if (entry.lut_min == lut_min && entry.lut_max == lut_max && SameCurve(entry, params)) {
+      use(entry);
+      return;
+    }
+  }
+
+  TableCacheEntry* entry;
+  if (table_cache_.size() < TABLE_CACHE_SIZE) {
+    entry = &table_cache_.emplace_back();
+    if (byte) {
+      entry->lut8 = MakeAlignedArray<uint8_t>(Lut8Size(range_max_));
+    } else {
+      entry->lut = MakeAlignedArray<uint32_t>(range_max_);
+    }
+  } else {
+    entry = &*std::ranges::min_element(table_cache_, {}, &TableCacheEntry::last_used);
+    if (SameCurve(*entry, params)) {
+      build_begin_ = std::clamp(std::min(entry->lut_min, lut_min), 0, range_max_);
+      build_end_   = std::clamp(std::max(entry->lut_max, lut_max) + 1, build_begin_, range_max_);
+    }
+  }
+  entry->lut_min = lut_min;
+  entry->lut_max = lut_max;
+  entry->curve   = params.curve;
+  entry->gamma   = params.gamma;
+  entry->gain    = params.gain;
+  entry->table.assign(params.table.begin(), params.table.end());
+  use(*entry);
+
+  if (params.curve == Curve::Linear) {
+    (this->*Create_AutoImpl)(lut_min, lut_max);
+  } else {
+    (this->*CreateCurve_AutoImpl)(lut_min, lut_max, params);
+  }
+  build_begin_ = 0;
+  build_end_   = range_max_;
+}
+
+void LUT::ClearTableCache() {
+  table_cache_.clear();
+}
+
+void LUT::SetNumThreads(int32_t num_threads) {
+  num_threads_ = num_threads > 0 ? num_threads : omp_get_max_threads();
+}
+
+// CONVERT_CHUNK_SIZE毎に分けてスレッドへ配る．カーネルはConvert_AutoImplで選んだものをそのまま使う
+// 最後のチャンク以外は各カーネルのstep(32/64)の倍数なので，端数の扱いはシングルスレッドと同じになる
+void LUT::Convert_Parallel(uint16_t* src, uint8_t* dst, int32_t data_size) {
+  const int32_t num_chunks = (data_size + CONVERT_CHUNK_SIZE - 1) / CONVERT_CHUNK_SIZE;
+#pragma omp parallel for num_threads(std::min(num_threads_, num_chunks)) schedule(dynamic)
+  for (int32_t chunk = 0; chunk < num_chunks; chunk++) {
+    const int32_t begin = chunk * CONVERT_CHUNK_SIZE;
+    const int32_t size  = std::min(CONVERT_CHUNK_SIZE, data_size - begin);
+    (this->*Convert_AutoImpl)(src + begin, dst + begin, size);
+  }
+}
+
+// 入力0..255を今のConvert_AutoImplで変換して，8bitの入力用のテーブルにする
+void LUT::UpdateLut256() {
+  const int32_t last = std::min(range_max_, 256) - 1;
+  alignas(64) uint16_t values[256];
+  for (int32_t v = 0; v < 256; v++) {
+    values[v] = std::min(v, last);
+  }
+  (this->*Convert_AutoImpl)(values, lut256_.get(), 256);
+  lut256_valid_ = true;
+}
+
+void LUT::Convert(const uint8_t* src, uint8_t* dst, int32_t data_size) {
+  if (!lut256_valid_) {
+    UpdateLut256();
+  }
+  if (num_threads_ > 1 && data_size > CONVERT_CHUNK_SIZE) {
+    const int32_t num_chunks = (data_size + CONVERT_CHUNK_SIZE - 1) / CONVERT_CHUNK_SIZE;
+#pragma omp parallel for num_threads(std::min(num_threads_, num_chunks)) schedule(dynamic)
+    for (int32_t chunk = 0; chunk < num_chunks; chunk++) {
+      const int32_t begin = chunk * CONVERT_CHUNK_SIZE;
+      (this->*Convert8_AutoImpl)(src + begin, dst + begin, std::min(CONVERT_CHUNK_SIZE, data_size - begin));
+    }
+  } else {
+    (this->*Convert8_AutoImpl)(src, dst, data_size);
+  }
+}
+
+void LUT::Convert(uint16_t* src, size_t src_step, uint8_t* dst, size_t dst_step, int32_t rows, int32_t cols) {
+  // 行間に隙間がなければ1次元として扱う
+  if (src_step == cols * sizeof(uint16_t) && dst_step == cols * sizeof(uint8_t)) {
+    Convert(src, dst, rows * cols);
+    return;
+  }
+
+  uint8_t* sptr             = reinterpret_cast<uint8_t*>(src);
+  const int32_t num_threads = std::clamp(num_threads_, 1, std::max(rows, 1));
+#pragma omp parallel for num_threads(num_threads) schedule(static) if (num_threads > 1)
+  for (int32_t y = 0; y < rows; y++) {
+    (this->*Convert_AutoImpl)(reinterpret_cast<uint16_t*>(sptr + y * src_step), dst + y * dst_step, cols);
+  }
+}
+
+std::array<uint32_t, 256> LUT::MakeColormap(Colormap colormap) {
+  // 0..1の値を0..255へ
+  auto channel = [](float x) { return static_cast<uint32_t>(std::lround(std::clamp(x, 0.0f, 1.0f) * 255.0f)); };
+
+  std::array<uint32_t, 256> palette;
+  for (int32_t v = 0; v < 256; v++) {
+    const float t = v / 255.0f;
+    uint32_t b    = v;
+    uint32_t g    = v;
+    uint32_t r    = v;
+    if (colormap == Colormap::Jet) {
+      // 青 -> シアン -> 黄 -> 赤
+      b = channel(1.5f - std::abs(4.0f * t - 1.0f));
+      g = channel(1.5f - std::abs(4.0f * t - 2.0f));
+      r = channel(1.5f - std::abs(4.0f * t - 3.0f));
+    } else if (colormap == Colormap::Hot) {
+      // 黒 -> 赤 -> 黄 -> 白
+      r = channel(3.0f * t);
+      g = channel(3.0f * t - 1.0f);
+      b = channel(3.0f * t - 2.0f);
+    }
+    palette[v] = 0xFF000000 | r << 16 | g << 8 | b;
+  }
+  return palette;
+}
+
+void LUT::SetColormap(std::span<const uint32_t, 256> palette) {
+  std::ranges::copy(palette, palette_.get());
+  uint8_t* planes = palette_planes_.get();
+  for (int32_t v = 0; v < 256; v++) {
+    for (int32_t c = 0; c < 4; c++) {
+      planes[c * 256 + v] = static_cast<uint8_t>(palette[v] >> (8 * c));
+    }
+  }
+}
+
+void LUT::ConvertColor(uint16_t* src, uint32_t* dst, int32_t data_size) {
+  if (num_threads_ > 1 && data_size > CONVERT_CHUNK_SIZE) {
+    const int32_t num_chunks = (data_size + CONVERT_CHUNK_SIZE - 1) / CONVERT_CHUNK_SIZE;
+#pragma omp parallel for num_threads(std::min(num_threads_, num_chunks)) schedule(dynamic)
+    for (int32_t chunk = 0; chunk < num_chunks; chunk++) {
+      const int32_t begin = chunk * CONVERT_CHUNK_SIZE;
+      ConvertColor_Chunk(src + begin, dst + begin, std::min(CONVERT_CHUNK_SIZE, data_size - begin));
+    }
+  } else {
+    ConvertColor_Chunk(src, dst, data_size);
+  }
+}
+
+// Convert_AutoImplの出力をL1に置いたまま，ExpandPalette_AutoImplで色にする
+void LUT::ConvertColor_Chunk(uint16_t* src, uint32_t* dst, int32_t data_size) {
+  alignas(64) uint8_t index[COLOR_CHUNK_SIZE];
+  for (int32_t begin = 0; begin < data_size; begin += COLOR_CHUNK_SIZE) {
+    const int32_t size = std::min(COLOR_CHUNK_SIZE, data_size - begin);
+    (this->*Convert_AutoImpl)(src + begin, index, size);
+    (this->*ExpandPalette_AutoImpl)(index, dst + begin, size);
+  }
+}
+
+// 各スレッドがHISTOGRAM_WAYS本のヒストグラムへ順に数え，最後に先頭の1本へ足し合わせる
+std::span<const int32_t> LUT::CalcHistogram(const uint16_t* src, int32_t data_size, int32_t sample_step) {
+  constexpr int32_t chunk_size = CONVERT_CHUNK_SIZE;
+  const int32_t step           = std::max(sample_step, 1);
+  const int32_t num_samples    = (data_size + step - 1) / step;
+  const int32_t num_threads    = std::clamp(num_threads_, 1, std::max((num_samples + chunk_size - 1) / chunk_size, 1));
+  if (histogram_size_ < num_threads * HISTOGRAM_WAYS * range_max_) {
+    histogram_size_ = num_threads * HISTOGRAM_WAYS * range_max_;
+#ifdef _MSC_VER
+    histogram_ = std::shared_ptr<int32_t[]>(new int32_t[histogram_size_]);
+#else
+    histogram_ = std::shared_ptr<int32_t[]>(new (std::align_val_t(64)) int32_t[histogram_size_]);
+#endif
+  }
+
+  int32_t* hptr = histogram_.get();
+#pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+  {
+    // 実際のスレッド数はnum_threadsより少ないことがあるので，足し合わせるのは実行したスレッドの分だけ
+    const int32_t num_histograms = omp_get_num_threads() * HISTOGRAM_WAYS;
+    int32_t* h                   = hptr + omp_get_thread_num() * HISTOGRAM_WAYS * range_max_;
+    std::fill_n(h, HISTOGRAM_WAYS * range_max_, 0);
+
+#pragma omp for schedule(static)
+    for (int32_t begin = 0; begin < num_samples; begin += chunk_size) {
+      const int32_t end = std::min(begin + chunk_size, num_samples);
+      int32_t i         = begin;
+      for (; i + HISTOGRAM_WAYS <= end; i += HISTOGRAM_WAYS) {
+        for (int32_t w = 0; w < HISTOGRAM_WAYS; w++) {
+          h[w * range_max_ + src[(i + w) * step]]++;
+        }
+      }
+      for (; i < end; i++) {
+        h[src[i * step]]++;
+      }
+    }
+
+    // omp forの終わりで全スレッドが数え終わっている
+#pragma omp for schedule(static)
+    for (int32_t v = 0; v < range_max_; v++) {
+      int32_t sum = 0;
+      for (int32_t j = 0; j < num_histograms; j++) {
+        sum += hptr[j * range_max_ + v];
+      }
+      hptr[v] = sum;
+    }
+  }
+  return std::span<const int32_t>(hptr, range_max_);
+}
+
+namespace {
+// 端から数えてcount個を超える最初のビン．from_topの場合は上から数える
+// 64ビンずつの合計で読み飛ばしてから，そのブロックの中を1ビンずつ探す
+int32_t FindPercentileBin(std::span<const int32_t> histogram, int64_t count, bool from_top) {
+  constexpr int32_t block = 64;
+  const int32_t size      = histogram.size();
+  auto bin                = [&](int32_t k) { return from_top ? size - 1 - k : k; };
+
+  int64_t sum = 0;
+  int32_t k   = 0;
+  for (; k + block <= size; k += block) {
+    const int32_t* first = histogram.data() + (from_top ? size - k - block : k);
+    int64_t block_sum    = 0;
+    for (int32_t j = 0; j < block; j++) {
+      block_sum += first[j];
+    }
+    if (sum + block_sum > count) {
+      break;
+    }
+    sum += block_sum;
+  }
+  for (; k < size; k++) {
+    sum += histogram[bin(k)];
+    if (sum > count) {
+      return bin(k);
+    }
+  }
+  return bin(size - 1);
+}
+} // namespace
+
+void LUT::CreateAuto(std::span<const int32_t> histogram, const AutoWindowParams& params) {
+  CreateAuto(histogram, params, CurveParams{});
+}
+
+void LUT::CreateAuto(std::span<const int32_t> histogram, const AutoWindowParams& params, const CurveParams& curve) {
+  int64_t total = 0;
+  for (const int32_t count : histogram) {
+    total += count;
+  }
+
+  float window_min = 0;
+  float window_max = static_cast<float>(histogram.size()) - 1;
+  if (total > 0) {
+    const double low  = std::clamp<double>(params.low_percentile, 0.0, 100.0) / 100.0;
+    const double high = std::clamp<double>(params.high_percentile, 0.0, 100.0) / 100.0;
+    window_min        = FindPercentileBin(histogram, static_cast<int64_t>(total * low), false);
+    window_max        = FindPercentileBin(histogram, static_cast<int64_t>(total * (1.0 - high)), true);
+  }
+
+  // 前回の窓との指数移動平均．1では窓が最初のフレームから動かなくなるので，1未満に抑える
+  const float smoothing = std::clamp(params.smoothing, 0.0f, std::nextafter(1.0f, 0.0f));
+  if (auto_window_valid_ && smoothing > 0) {
+    window_min = smoothing * auto_window_min_ + (1.0f - smoothing) * window_min;
+    window_max = smoothing * auto_window_max_ + (1.0f - smoothing) * window_max;
+  }
+  auto_window_valid_ = true;
+  auto_window_min_   = window_min;
+  auto_window_max_   = window_max;
+
+  const int32_t lut_min = static_cast<int32_t>(std::lround(window_min));
+  const int32_t lut_max = std::max(static_cast<int32_t>(std::lround(window_max)), lut_min);
+  Create(lut_min, lut_max, curve);
+}
+
+void LUT::CreateAuto(const uint16_t* src, int32_t data_size, const AutoWindowParams& params) {
+  CreateAuto(src, data_size, params, CurveParams{});
+}
+
+void LUT::CreateAuto(const uint16_t* src, int32_t data_size, const AutoWindowParams& params, const CurveParams& curve) {
+  CreateAuto(CalcHistogram(src, data_size, params.sample_step), params, curve);
 }
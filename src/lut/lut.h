@@ -1,16 +1,24 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 class LUT {
 private:
 public: // for test
   std::shared_ptr<uint32_t[]> lut_ = nullptr;
+  std::shared_ptr<uint8_t[]> lut8_ = nullptr; // Storage::Byte用．gatherが4byte読むので末尾に余白を取る
   int32_t lut_min_                 = 0;
   int32_t lut_max_                 = 0;
   float coeff_                     = 0;
   int32_t range_max_;
+  int32_t num_threads_ = 1;
 
 public:
   enum class Method {
@@ -26,29 +34,216 @@ public:
     avx512vbmi_calc,
     avx512vbmi_calc_intweight_epu16,
     avx512vbmi_calc_intweight_epi32,
+    // uint8_tのテーブル(lut8_)を引く
+    naive_lut8,
+    avx2_lut8,
+    avx512f_lut8,
+    avx512vbmi_lut8,
+    avx512vbmi_lut8_permute, // range_max <= 256: テーブルをレジスタに置きvpermi2bで引く
+    // カラーマップ(256色のBGRA)を引く．ExpandPalette_Impl用
+    naive_palette,
+    avx2_palette,
+    avx512f_palette,
+    avx512vbmi_palette, // チャンネル毎の256byteをレジスタに置きvpermi2bで引く
+    // 8bitの入力．256要素のテーブル(lut256_)を引く．Convert8_Impl用
+    naive_src8,
+    avx2_src8_pshufb,        // 16byteずつ16回pshufbで引く
+    avx512vbmi_src8_permute, // 256byteをレジスタに置きvpermi2bで引く
+  };
+
+  // テーブルの要素の型．Byteは16bitのテーブルで64KiB(Wordの1/4)になり，L2に収まる
+  enum class Storage {
+    Word,
+    Byte,
+  };
+
+  enum class Curve {
+    Linear,
+    Gamma,
+    Log,
+    Sigmoid,
+    Table,
+  };
+
+  // 窓[lut_min, lut_max]を0..1に正規化した入力tから出力(0..255)への変換曲線
+  struct CurveParams {
+    Curve curve = Curve::Linear;
+    float gamma = 2.2f;             // Gamma: t^(1 / gamma)
+    float gain  = 10.0f;            // Log: log(1 + gain * t) / log(1 + gain)，Sigmoid: 中央(t = 0.5)での傾き
+    std::span<const uint8_t> table; // Table: 窓をtable.size()等分し，それぞれtableの値を出力する
+  };
+
+  // 固定小数点の変換 dst = min((min(max(src - lut_min, 0), max) << pre_shift) * mul >> shift, 255) のパラメータ
+  // *_intweight_epi32はpre_shift = 0の32bit乗算，*_intweight_epu16はmulhi_epu16(16bit)で計算する
+  struct IntWeight {
+    bool exact        = false; // 全ての入力でnaive_lutと一致する
+    int32_t max       = 0;     // 出力が255になる最小の入力(窓が値域より広い場合は値域の上限)
+    uint32_t mul      = 0;
+    int32_t pre_shift = 0;
+    int32_t shift     = 0;
+  };
+
+  // ConvertColorのカラーマップ．MakeColormapで作る
+  enum class Colormap {
+    Gray,
+    Jet,
+    Hot,
+  };
+
+  // ヒストグラムのパーセンタイルから窓を決める(自動コントラスト)
+  struct AutoWindowParams {
+    float low_percentile  = 1.0f;  // [%] これより暗い画素は0になる
+    float high_percentile = 99.0f; // [%] これより明るい画素は255になる
+    float smoothing       = 0.0f;  // [0, 1) 前フレームの窓の重み．大きいほどゆっくり追従し，ちらつかない
+    int32_t sample_step   = 1;     // CreateAuto(src, ...)でヒストグラムを取る画素の間隔
   };
 
 private:
 public: // for test
+  Storage storage_;
+  IntWeight intweight_epu16_;
+  IntWeight intweight_epi32_;
+  // CreateAuto用のヒストグラム(スレッド毎にHISTOGRAM_WAYS本)と，平滑化した窓
+  std::shared_ptr<int32_t[]> histogram_ = nullptr;
+  int32_t histogram_size_               = 0;
+  bool auto_window_valid_               = false;
+  float auto_window_min_                = 0;
+  float auto_window_max_                = 0;
+  // ConvertColor用．palette_[v]は出力値vの色(BGRA)，palette_planes_はB, G, R, Aを256byteずつ並べたもの
+  std::shared_ptr<uint32_t[]> palette_      = nullptr;
+  std::shared_ptr<uint8_t[]> palette_planes_ = nullptr;
+  // 8bitの入力用．入力0..255の出力値で，Createの後の最初のConvert(uint8_t*)で作る
+  std::shared_ptr<uint8_t[]> lut256_ = nullptr;
+  bool lut256_valid_                 = false;
+
+  // 作ったテーブルのLRUキャッシュ．lut_(Word)かlut8_(Byte)はいずれかのエントリのbufferを指す
+  // Create_Impl, CreateCurve_Implを直接呼ぶとキャッシュを通らずにそのbufferを書き換えるので，後でClearTableCacheする
+  struct TableCacheEntry {
+    int32_t lut_min;
+    int32_t lut_max;
+    Curve curve;
+    float gamma;
+    float gain;
+    std::vector<uint8_t> table;
+    std::shared_ptr<uint32_t[]> lut;
+    std::shared_ptr<uint8_t[]> lut8;
+    uint64_t last_used;
+  };
+  std::vector<TableCacheEntry> table_cache_;
+  uint64_t table_cache_clock_ = 0;
+  bool create_uses_table_     = true; // Create_AutoImplがテーブルを作る(*_calcでない)
+  // テーブルを作るカーネル(*_lut, *_lut8)が書き込む範囲[build_begin_, build_end_)．範囲外は前の値のまま
+  int32_t build_begin_ = 0;
+  int32_t build_end_   = 0;
+  // 直前のCreateの窓と曲線．Calibrateの後に同じ窓で作り直す．created_curve_.tableはcreated_table_を指す
+  bool created_        = false;
+  int32_t created_min_ = 0;
+  int32_t created_max_ = 0;
+  CurveParams created_curve_;
+  std::vector<uint8_t> created_table_;
+
   template<Method m>
   void Create_Impl(int32_t lut_min, int32_t lut_max);
   template<Method m>
   void Convert_Impl(uint16_t* src, uint8_t* dst, int32_t data_size);
+  // *_src8のみ
+  template<Method m>
+  void Convert8_Impl(const uint8_t* src, uint8_t* dst, int32_t data_size);
+  // Convertの出力(0..255)をカラーマップでBGRAにする．*_paletteのみ
+  template<Method m>
+  void ExpandPalette_Impl(const uint8_t* src, uint32_t* dst, int32_t data_size);
+  // 曲線のLUTを作る．Convertは*_lut, *_lut8のカーネル(テーブル参照)で行う
+  template<Method m>
+  void CreateCurve_Impl(int32_t lut_min, int32_t lut_max, const CurveParams& params);
 
   void ImplSelector();
+  // Calibrateの候補．roleはlinear(Create_AutoImplとConvert_LinearImpl)，table(Convert_TableImpl)，
+  // intweight_epu16, intweight_epi32(convertがnullptrの"none"は使わない)のどれか
+  struct CalibrationCandidate {
+    std::string_view role;
+    std::string_view name;
+    void (LUT::*create)(int32_t, int32_t);
+    void (LUT::*convert)(uint16_t*, uint8_t*, int32_t);
+  };
+  std::vector<CalibrationCandidate> CalibrationCandidates() const;
+  void ApplyCalibration(const CalibrationCandidate& candidate);
+  void CreateIntWeight(int32_t lut_min, int32_t lut_max);
+  void CreateTable(int32_t lut_min, int32_t lut_max, const CurveParams& params);
+  void RememberCreate(int32_t lut_min, int32_t lut_max, const CurveParams& params);
   void (LUT::*Create_AutoImpl)(int32_t, int32_t);
+  void (LUT::*CreateCurve_AutoImpl)(int32_t, int32_t, const CurveParams&);
+  // Convert_AutoImplは直前のCreateに応じてConvert_LinearImpl, Convert_TableImpl, Convert_IntWeight*Implのどれかになる
   void (LUT::*Convert_AutoImpl)(uint16_t*, uint8_t*, int32_t);
+  void (LUT::*Convert_LinearImpl)(uint16_t*, uint8_t*, int32_t);
+  void (LUT::*Convert_TableImpl)(uint16_t*, uint8_t*, int32_t);
+  // 窓がintweight_*_.exactの場合に優先する．nullptrは使わない
+  void (LUT::*Convert_IntWeightEpu16Impl)(uint16_t*, uint8_t*, int32_t);
+  void (LUT::*Convert_IntWeightEpi32Impl)(uint16_t*, uint8_t*, int32_t);
+  void (LUT::*ExpandPalette_AutoImpl)(const uint8_t*, uint32_t*, int32_t);
+  void (LUT::*Convert8_AutoImpl)(const uint8_t*, uint8_t*, int32_t);
+
+  void Convert_Parallel(uint16_t* src, uint8_t* dst, int32_t data_size);
+  void ConvertColor_Chunk(uint16_t* src, uint32_t* dst, int32_t data_size);
+  void UpdateLut256();
+  std::span<const int32_t> CalcHistogram(const uint16_t* src, int32_t data_size, int32_t sample_step);
 
 public:
-  LUT(int32_t range_max);
+  // 並列Convertで1スレッドが1回に処理する要素数．src(32KiB) + dst(16KiB)がL2に収まり，
+  // 境界がsrc/dstとも64byteの倍数になる
+  static constexpr int32_t CONVERT_CHUNK_SIZE = 16 * 1024;
+  // ConvertColorで1回にConvertする要素数．中間のuint8_t(2KiB)とsrc(4KiB)，dst(8KiB)がL1に収まる
+  static constexpr int32_t COLOR_CHUNK_SIZE = 2 * 1024;
+  // Createで作ったテーブルを保持する数．同じ窓と曲線に戻った場合は作り直さない
+  static constexpr int32_t TABLE_CACHE_SIZE = 4;
+  // CalcHistogramで1スレッドが持つヒストグラムの本数．同じ値が続く場合のストアとロードの依存を分散する
+  static constexpr int32_t HISTOGRAM_WAYS = 2;
+
+  LUT(int32_t range_max, Storage storage = Storage::Word);
+
+  // 各カーネルを計測して最速のものを選び直す(ImplSelectorはISAだけで選ぶ)．Create(min, max)の出力が計測の結果で
+  // 変わらないよう，linearはnaive_lut(8)と一致するテーブル参照のカーネルから選ぶ
+  // 計測には数十msかかるので，コンストラクタや最初のConvertでは行わず，呼び出し側が時期を選んで呼ぶ
+  // profile_pathを指定すると結果を保存し，同じrange_maxとStorageの結果があれば計測せずにそれを使う
+  // 不正な行や同じroleの重複がある場合は計測し直す．Create済みなら最後に同じ窓と曲線で作り直す
+  static constexpr int32_t CALIBRATION_SIZE = 1024 * 1024;
+  void Calibrate(const std::string& profile_path = "");
+
+  // 0以下の場合はomp_get_max_threads()
+  void SetNumThreads(int32_t num_threads);
+  int32_t GetNumThreads() const {
+    return num_threads_;
+  }
 
   void Create(int32_t lut_min, int32_t lut_max);
+  void Create(int32_t lut_min, int32_t lut_max, const CurveParams& params);
+  void ClearTableCache();
+  // histogram(MyHisto::histo_など．histogram[i]は値iの画素数)のパーセンタイルから窓を決めてCreateする
+  // 窓はlut_min_, lut_max_に入る．smoothing > 0の場合は前回のCreateAutoの窓と混ぜる
+  void CreateAuto(std::span<const int32_t> histogram, const AutoWindowParams& params);
+  void CreateAuto(std::span<const int32_t> histogram, const AutoWindowParams& params, const CurveParams& curve);
+  // srcのヒストグラムを取ってからCreateAutoする．srcの値はrange_max未満
+  void CreateAuto(const uint16_t* src, int32_t data_size, const AutoWindowParams& params);
+  void CreateAuto(const uint16_t* src, int32_t data_size, const AutoWindowParams& params, const CurveParams& curve);
+  // 疑似カラー: ConvertColorはConvertの出力値vをpalette[v](BGRA, 256色)にして書き込む
+  // ConvertとExpandPaletteをCOLOR_CHUNK_SIZE毎に続けて行うので，データは1回しか読み書きしない
+  static std::array<uint32_t, 256> MakeColormap(Colormap colormap);
+  void SetColormap(std::span<const uint32_t, 256> palette);
+  void ConvertColor(uint16_t* src, uint32_t* dst, int32_t data_size);
+  // 平滑化の履歴を捨てる(シーンの切り替わりなど)．次のCreateAutoはそのフレームの窓をそのまま使う
+  void ResetAutoWindow() {
+    auto_window_valid_ = false;
+  }
   void Convert(uint16_t* src, uint8_t* dst, int32_t data_size);
+  // 8bitの入力．値をそのままuint16_tにしてConvertしたものと一致する(range_max以上はrange_max - 1として扱う)
+  void Convert(const uint8_t* src, uint8_t* dst, int32_t data_size);
+  // 行毎にstep[byte]離れた2次元領域(cv::MatのROIなど)をそのまま変換する
+  void Convert(uint16_t* src, size_t src_step, uint8_t* dst, size_t dst_step, int32_t rows, int32_t cols);
 };
 
-inline void LUT::Create(int32_t lut_min, int32_t lut_max) {
-  (this->*Create_AutoImpl)(lut_min, lut_max);
-}
 inline void LUT::Convert(uint16_t* src, uint8_t* dst, int32_t data_size) {
-  (this->*Convert_AutoImpl)(src, dst, data_size);
+  if (num_threads_ > 1 && data_size > CONVERT_CHUNK_SIZE) {
+    Convert_Parallel(src, dst, data_size);
+  } else {
+    (this->*Convert_AutoImpl)(src, dst, data_size);
+  }
 }
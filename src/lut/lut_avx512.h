@@ -0,0 +1,49 @@
+#pragma once
+
+// lut_impl_avx512*.cc 専用．#pragma GCC target("avx512f,avx512bw,avx512vl") の後にincludeする
+
+#include <algorithm>
+#include <cstdint>
+
+#include <immintrin.h>
+
+// ループの途中: step要素すべて読み書きできる
+// ptrは読み書きする先頭，offsetはループ1回分の先頭からの要素数
+struct FullLanes {
+  __m512i Load(const uint16_t* ptr, int32_t) const {
+    return _mm512_loadu_si512(reinterpret_cast<const void*>(ptr));
+  }
+  void Store(uint8_t* ptr, int32_t, __m256i v) const {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr), v);
+  }
+  void Store(uint8_t* ptr, int32_t, __m512i v) const {
+    _mm512_storeu_si512(ptr, v);
+  }
+};
+
+// 末尾: 有効なremain要素だけマスクして読み書きする．範囲外のレーンは0を読んだものとして計算し，書き込まない
+struct TailLanes {
+  int32_t remain;
+
+  __m512i Load(const uint16_t* ptr, int32_t offset) const {
+    return _mm512_maskz_loadu_epi16(_bzhi_u32(0xFFFFFFFF, std::clamp(remain - offset, 0, 32)), ptr);
+  }
+  void Store(uint8_t* ptr, int32_t offset, __m256i v) const {
+    _mm256_mask_storeu_epi8(ptr, _bzhi_u32(0xFFFFFFFF, std::clamp(remain - offset, 0, 32)), v);
+  }
+  void Store(uint8_t* ptr, int32_t offset, __m512i v) const {
+    _mm512_mask_storeu_epi8(ptr, _bzhi_u64(0xFFFFFFFFFFFFFFFF, std::clamp(remain - offset, 0, 64)), v);
+  }
+};
+
+// [0, data_size)をstepずつprocess(i, lanes)で処理する．端数は最後に1回TailLanesで処理する
+template<typename Process>
+inline void ForEachStep(int32_t data_size, int32_t step, const Process& process) {
+  const int32_t simd_end = data_size / step * step;
+  for (int32_t i = 0; i < simd_end; i += step) {
+    process(i, FullLanes{});
+  }
+  if (simd_end < data_size) {
+    process(simd_end, TailLanes{data_size - simd_end});
+  }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+// lut_impl_*.cc 専用．LUT::CurveParamsの曲線の評価と，テーブルを値が一定の区間に分ける処理
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+#include "lut.h"
+
+// 入力値iの出力値
+// 曲線を使う方法(naive_lutとavx2_lut)はすべてこの値に一致させる
+inline int32_t CurveValue(const LUT::CurveParams& params, int32_t lut_min, int32_t lut_max, int32_t i) {
+  const int32_t width = lut_max - lut_min + 1;
+  if (params.curve == LUT::Curve::Table) {
+    const int64_t size = params.table.size();
+    const int64_t idx  = std::clamp<int64_t>(static_cast<int64_t>(i - lut_min) * size / width, 0, size - 1);
+    return params.table[idx];
+  }
+
+  const float t = std::clamp(static_cast<float>(i - lut_min) / width, 0.0f, 1.0f);
+  float y       = t;
+  if (params.curve == LUT::Curve::Gamma) {
+    y = std::pow(t, 1.0f / params.gamma);
+  } else if (params.curve == LUT::Curve::Log) {
+    y = std::log1p(params.gain * t) / std::log1p(params.gain);
+  } else if (params.curve == LUT::Curve::Sigmoid) {
+    // 両端が0, 1になるように正規化する
+    auto sigmoid   = [](float x) { return 1.0f / (1.0f + std::exp(-x)); };
+    const float lo = sigmoid(-0.5f * params.gain);
+    const float hi = sigmoid(0.5f * params.gain);
+    y              = (sigmoid(params.gain * (t - 0.5f)) - lo) / (hi - lo);
+  }
+  return std::clamp(static_cast<int32_t>(256.0f * y), 0, 255);
+}
+
+// 出力がyになる正規化入力t(CurveValueの逆関数)．区間の境界の初期値に使うだけなので誤差があってよい
+inline float CurveInverse(const LUT::CurveParams& params, float y) {
+  if (params.curve == LUT::Curve::Gamma) {
+    return std::pow(y, params.gamma);
+  } else if (params.curve == LUT::Curve::Log) {
+    return std::expm1(y * std::log1p(params.gain)) / params.gain;
+  } else if (params.curve == LUT::Curve::Sigmoid) {
+    auto sigmoid   = [](float x) { return 1.0f / (1.0f + std::exp(-x)); };
+    const float lo = sigmoid(-0.5f * params.gain);
+    const float hi = sigmoid(0.5f * params.gain);
+    const float s  = lo + y * (hi - lo);
+    return 0.5f + std::log(s / (1.0f - s)) / params.gain;
+  }
+  return y;
+}
+
+// [first, last)を出力値が一定の区間に分け，先頭から順にfill(begin, end, value)を呼ぶ
+// 単調な曲線は出力値が変わる境界を逆関数で求めてからCurveValueで補正するので，評価は出力の段数の数回で済む
+template<typename Fill>
+inline void ForEachRun(const LUT::CurveParams& params, int32_t first, int32_t last, int32_t lut_min, int32_t lut_max,
+                       const Fill& fill) {
+  const int32_t width = lut_max - lut_min + 1;
+  assert(width > 0);
+  assert(params.curve != LUT::Curve::Table || !params.table.empty());
+  assert(params.curve != LUT::Curve::Gamma || params.gamma > 0);
+  assert(params.curve == LUT::Curve::Table || params.curve == LUT::Curve::Gamma || params.gain > 0);
+
+  if (params.curve == LUT::Curve::Table) {
+    // table[j]の区間は[lut_min + ceil(j * width / size), lut_min + ceil((j + 1) * width / size))
+    const int64_t size = params.table.size();
+    int32_t begin      = first;
+    for (int64_t j = 0; j < size && begin < last; j++) {
+      const int64_t next = j == size - 1 ? last : lut_min + ((j + 1) * width + size - 1) / size;
+      const int32_t end  = static_cast<int32_t>(std::clamp<int64_t>(next, begin, last));
+      if (begin < end) {
+        fill(begin, end, params.table[j]);
+      }
+      begin = end;
+    }
+    return;
+  }
+
+  auto value = [&](int32_t i) { return CurveValue(params, lut_min, lut_max, i); };
+
+  // lut_max + 1以降は出力が最大値のまま
+  const int32_t saturate = std::min(lut_max + 1, last);
+  int32_t begin          = first;
+  while (begin < last) {
+    const int32_t current = value(begin);
+    if (begin >= saturate || current >= value(saturate)) {
+      fill(begin, last, current);
+      return;
+    }
+    // current + 1以上になる最初の入力値
+    const float t = CurveInverse(params, (current + 1) / 256.0f);
+    int32_t end   = std::clamp(lut_min + static_cast<int32_t>(std::ceil(t * width)), begin + 1, saturate);
+    while (end > begin + 1 && value(end - 1) > current) {
+      end--;
+    }
+    while (value(end) <= current) {
+      end++;
+    }
+    fill(begin, end, current);
+    begin = end;
+  }
+}
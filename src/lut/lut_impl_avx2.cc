@@ -1,30 +1,88 @@
 #include "lut.h"
+#include "lut_curve.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+
 #include <immintrin.h>
 
+namespace {
+inline __m256i Load(const uint16_t* ptr) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+}
+inline void Store(uint8_t* ptr, __m256i v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr), v);
+}
+
+// [0, data_size)をstepずつprocess(sptri, dptri)で処理する
+// AVX2にはuint16_t/uint8_t単位のマスク付きロード・ストアがないので，端数はstep要素の一時バッファにコピーして処理する
+template<int32_t STEP, typename Process>
+inline void ForEachStep(const uint16_t* src, uint8_t* dst, int32_t data_size, const Process& process) {
+  const int32_t simd_end = data_size / STEP * STEP;
+  for (int32_t i = 0; i < simd_end; i += STEP) {
+    process(src + i, dst + i);
+  }
+  if (simd_end < data_size) {
+    const int32_t remain            = data_size - simd_end;
+    alignas(32) uint16_t sbuf[STEP] = {};
+    alignas(32) uint8_t dbuf[STEP];
+    std::memcpy(sbuf, src + simd_end, remain * sizeof(uint16_t));
+    process(sbuf, dbuf);
+    std::memcpy(dst + simd_end, dbuf, remain);
+  }
+}
+} // namespace
+
 // SIMDを用いたLUT作成
+// naive_lutと同じくfloatの係数と(i - lut_min)の積を切り捨てるので，naive_lutと一致する
+// (i - lut_min)は整数なのでfloatで正確に表せ，stepずつ足しても誤差が出ない．FMAは丸めが変わるので使わない
 template<>
 void LUT::Create_Impl<LUT::Method::avx2_lut>(int32_t lut_min, int32_t lut_max) {
   constexpr int32_t step = 256 / 8 / sizeof(uint32_t);
   uint32_t* lptr         = lut_.get();
 
-  const float coeff = 255.0 / (lut_max - lut_min + 1);
-
-  const __m256 index_v = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  const float coeff = 256.0 / (lut_max - lut_min + 1);
 
+  const __m256 index_v      = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256 step_v       = _mm256_set1_ps(step);
+  const __m256 coeff_v      = _mm256_set1_ps(coeff);
   const __m256i uint8_max_v = _mm256_set1_epi32(255);
-  const __m256 lut_min_v    = _mm256_set1_ps(lut_min);
   const __m256i zero_v      = _mm256_setzero_si256();
-  const __m256 coeff_v      = _mm256_set1_ps(coeff);
 
-  for (int32_t i = 0; i < range_max_; i += step) {
-    const __m256 i_v  = _mm256_add_ps(_mm256_set1_ps(i), index_v);
-    const __m256i val = _mm256_cvtps_epi32(_mm256_mul_ps(coeff_v, _mm256_sub_ps(i_v, lut_min_v)));
-    _mm256_storeu_epi32(lptr + i, _mm256_max_epi32(_mm256_min_epi32(val, uint8_max_v), zero_v));
+  // stepに揃えるためにbuild_begin_より前も書くが，同じ値になる
+  const int32_t simd_end = build_end_ / step * step;
+  int32_t i              = build_begin_ / step * step;
+  __m256 x_v             = _mm256_add_ps(_mm256_set1_ps(i - lut_min), index_v);
+  for (; i < simd_end; i += step) {
+    const __m256i val = _mm256_cvttps_epi32(_mm256_mul_ps(coeff_v, x_v));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lptr + i),
+                        _mm256_max_epi32(_mm256_min_epi32(val, uint8_max_v), zero_v));
+    x_v = _mm256_add_ps(x_v, step_v);
+  }
+  for (; i < build_end_; i++) {
+    lptr[i] = std::clamp(static_cast<int32_t>(coeff * (i - lut_min)), 0, 255);
   }
 }
 
+// 曲線のLUT作成．出力値が一定の区間ごとにベクトルで埋める．曲線の評価は区間の境界を求めるときだけ行う
+template<>
+void LUT::CreateCurve_Impl<LUT::Method::avx2_lut>(int32_t lut_min, int32_t lut_max, const CurveParams& params) {
+  constexpr int32_t step = 256 / 8 / sizeof(uint32_t);
+  uint32_t* lptr         = lut_.get();
+
+  ForEachRun(params, build_begin_, build_end_, lut_min, lut_max, [&](int32_t begin, int32_t end, int32_t value) {
+    const __m256i value_v = _mm256_set1_epi32(value);
+    int32_t i             = begin;
+    for (; i + step <= end; i += step) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(lptr + i), value_v);
+    }
+    for (; i < end; i++) {
+      lptr[i] = value;
+    }
+  });
+}
+
 // uint16_t入力をunpackでuint32_tベクトルx2にわけ，gatherでLUT取得しuint8_tへパック
 template<>
 void LUT::Convert_Impl<LUT::Method::avx2_lut>(uint16_t* src, uint8_t* dst, int32_t data_size) {
@@ -39,10 +97,8 @@ void LUT::Convert_Impl<LUT::Method::avx2_lut>(uint16_t* src, uint8_t* dst, int32
   // };
   const __m256i shuffle_idx = _mm256_set1_epi32(0x0C080400);
 
-  for (int i = 0; i < data_size; i += step) {
-    uint16_t* sptri     = src + i;
-    uint8_t* dptri      = dst + i;
-    __m256i src_v       = _mm256_loadu_epi16(sptri);
+  ForEachStep<step>(src, dst, data_size, [&](const uint16_t* sptri, uint8_t* dptri) {
+    __m256i src_v       = Load(sptri);
     __m256i idx_hi      = _mm256_unpackhi_epi16(src_v, zero_v);
     __m256i idx_lo      = _mm256_unpacklo_epi16(src_v, zero_v);
     __m256i hi          = _mm256_i32gather_epi32(lptr, idx_hi, sizeof(uint32_t));
@@ -52,7 +108,7 @@ void LUT::Convert_Impl<LUT::Method::avx2_lut>(uint16_t* src, uint8_t* dst, int32
     __m256i dst_lo_v    = _mm256_blend_epi32(compress_lo, compress_hi, 0b10101010);
     dst_lo_v            = _mm256_permute4x64_epi64(dst_lo_v, _MM_SHUFFLE(2, 1, 3, 0));
 
-    src_v            = _mm256_loadu_epi16(sptri + half_step);
+    src_v            = Load(sptri + half_step);
     idx_hi           = _mm256_unpackhi_epi16(src_v, zero_v);
     idx_lo           = _mm256_unpacklo_epi16(src_v, zero_v);
     hi               = _mm256_i32gather_epi32(lptr, idx_hi, sizeof(uint32_t));
@@ -64,8 +120,8 @@ void LUT::Convert_Impl<LUT::Method::avx2_lut>(uint16_t* src, uint8_t* dst, int32
 
     dst_lo_v = _mm256_blend_epi32(dst_lo_v, dst_hi_v, 0b11110000);
 
-    _mm256_storeu_epi32(dptri, dst_lo_v);
-  }
+    Store(dptri, dst_lo_v);
+  });
 }
 
 // uint16_t入力をunpackでuint32_tベクトルx2にわけ，係数乗算はfloatで計算
@@ -81,10 +137,8 @@ void LUT::Convert_Impl<LUT::Method::avx2_calc>(uint16_t* src, uint8_t* dst, int3
   __m256i zero_v      = _mm256_setzero_si256();
 
   const __m256i shuffle_idx = _mm256_set1_epi32(0x0C080400);
-  for (int i = 0; i < data_size; i += step) {
-    uint16_t* sptri   = src + i;
-    uint8_t* dptri    = dst + i;
-    __m256i src_sub_v = _mm256_subs_epu16(_mm256_loadu_epi16(sptri), lut_min_v);
+  ForEachStep<step>(src, dst, data_size, [&](const uint16_t* sptri, uint8_t* dptri) {
+    __m256i src_sub_v = _mm256_subs_epu16(Load(sptri), lut_min_v);
     __m256i srcs_hi   = _mm256_unpackhi_epi16(src_sub_v, zero_v);
     __m256i srcs_lo   = _mm256_unpacklo_epi16(src_sub_v, zero_v);
 
@@ -99,7 +153,7 @@ void LUT::Convert_Impl<LUT::Method::avx2_calc>(uint16_t* src, uint8_t* dst, int3
     dst_lo_v            = _mm256_permute4x64_epi64(dst_lo_v, _MM_SHUFFLE(2, 1, 3, 0));
 
     // half
-    src_sub_v = _mm256_subs_epu16(_mm256_loadu_epi16(sptri + half_step), lut_min_v);
+    src_sub_v = _mm256_subs_epu16(Load(sptri + half_step), lut_min_v);
     srcs_hi   = _mm256_unpackhi_epi16(src_sub_v, zero_v);
     srcs_lo   = _mm256_unpacklo_epi16(src_sub_v, zero_v);
 
@@ -115,90 +169,155 @@ void LUT::Convert_Impl<LUT::Method::avx2_calc>(uint16_t* src, uint8_t* dst, int3
 
     dst_lo_v = _mm256_blend_epi32(dst_lo_v, dst_hi_v, 0b11110000);
 
-    _mm256_storeu_epi32(dptri, dst_lo_v);
-  }
+    Store(dptri, dst_lo_v);
+  });
 }
 
 // 係数を整数として扱う．uint16_tのまま計算を行い，uint8_tへパックする
-// [要テスト] minmax取る順番を早くしているので発生しない予定だが，桁溢れがこわい
 // 式変形
 //      dst[i] = clamp(coeff_ * (src[i] - lut_min), 0, 255)
-//   -> dst[i] = min(max(coeff * (src[i] - lut_min), 0), 255)
-//   -> dst[i] = coeff_ * (min(max(src[i] - lut_min), 0 / coeff), 255 / coeff)
-//   -> dst[i] = (coeff_ * 256) * (min(max(src[i] - lut_min), 0), 255 / coeff) / 256
+//   -> dst[i] = min((min(max(src[i] - lut_min, 0), max) << pre_shift) * mul >> (16 + shift), 255)
+// maxで先に抑えるので桁溢れしない．mul, shiftはCreateIntWeightで段の境界がnaive_lutと一致するように選ぶ
+template<>
+void LUT::Create_Impl<LUT::Method::avx2_calc_intweight_epu16>(int32_t lut_min, int32_t lut_max) {
+  CreateIntWeight(lut_min, lut_max);
+}
+
 template<>
 void LUT::Convert_Impl<LUT::Method::avx2_calc_intweight_epu16>(uint16_t* src, uint8_t* dst, int32_t data_size) {
   constexpr int32_t step      = 256 / 8 / sizeof(uint8_t);
   constexpr int32_t half_step = step >> 1;
 
-  __m256i coeff_v               = _mm256_set1_epi16(std::ceil(coeff_ * (0x100)));
-  __m256i lut_min_v             = _mm256_set1_epi16(lut_min_);
-  __m256i uint8_max_div_coeff_v = _mm256_set1_epi16((255.0 / coeff_));
+  const __m256i mul_v       = _mm256_set1_epi16(intweight_epu16_.mul);
+  const __m256i lut_min_v   = _mm256_set1_epi16(lut_min_);
+  const __m256i max_v       = _mm256_set1_epi16(intweight_epu16_.max);
+  const __m128i pre_shift_v = _mm_cvtsi32_si128(intweight_epu16_.pre_shift);
+  const __m128i shift_v     = _mm_cvtsi32_si128(intweight_epu16_.shift);
+  const __m256i uint8_max_v = _mm256_set1_epi16(255);
 
   const __m256i shuffle_idx = _mm256_set1_epi64x(0x0E0C0A0806040200);
-  for (int i = 0; i < data_size; i += step) {
-    uint16_t* sptri = src + i;
-    uint8_t* dptri  = dst + i;
-    __m256i src_sub_v =
-        _mm256_min_epu16(_mm256_subs_epu16(_mm256_loadu_epi16(sptri), lut_min_v), uint8_max_div_coeff_v);
-    __m256i dst_v1 = _mm256_srli_epi16(_mm256_mullo_epi16(src_sub_v, coeff_v), 8);
-
-    dst_v1 = _mm256_shuffle_epi8(dst_v1, shuffle_idx);
-    dst_v1 = _mm256_permute4x64_epi64(dst_v1, _MM_SHUFFLE(2, 1, 3, 0));
-
-    // half
-    src_sub_v =
-        _mm256_min_epu16(_mm256_subs_epu16(_mm256_loadu_epi16(sptri + half_step), lut_min_v), uint8_max_div_coeff_v);
-    __m256i dst_v2 = _mm256_srli_epi16(_mm256_mullo_epi16(src_sub_v, coeff_v), 8);
 
-    dst_v2 = _mm256_shuffle_epi8(dst_v2, shuffle_idx);
-    dst_v2 = _mm256_permute4x64_epi64(dst_v2, _MM_SHUFFLE(2, 1, 3, 0));
+  // 16要素を変換し，下位128bitにuint8_tで並べる
+  auto calc = [&](const uint16_t* sptr) {
+    const __m256i x = _mm256_min_epu16(_mm256_subs_epu16(Load(sptr), lut_min_v), max_v);
+    const __m256i v = _mm256_srl_epi16(_mm256_mulhi_epu16(_mm256_sll_epi16(x, pre_shift_v), mul_v), shift_v);
+    return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(_mm256_min_epu16(v, uint8_max_v), shuffle_idx),
+                                    _MM_SHUFFLE(2, 1, 3, 0));
+  };
+
+  ForEachStep<step>(src, dst, data_size, [&](const uint16_t* sptri, uint8_t* dptri) {
+    Store(dptri, _mm256_blend_epi32(calc(sptri), calc(sptri + half_step), 0b11110000));
+  });
+}
 
-    __m256i dst_v = _mm256_blend_epi32(dst_v1, dst_v2, 0b11110000);
-    _mm256_storeu_epi32(dptri, dst_v);
-  }
+// 係数を整数として扱う．uint32_tへキャストして乗算し，uint8_tへパックする
+// dst[i] = min(min(max(src[i] - lut_min, 0), max) * mul >> shift, 255)
+template<>
+void LUT::Create_Impl<LUT::Method::avx2_calc_intweight_epi32>(int32_t lut_min, int32_t lut_max) {
+  CreateIntWeight(lut_min, lut_max);
 }
 
-// 係数を整数として扱う．uint32_tへキャストしuint16_tへ戻し，uint8_tへパックする
-// 桁溢れの心配が少ない intweight_epu16 が完成するまで最速だったもの
 template<>
 void LUT::Convert_Impl<LUT::Method::avx2_calc_intweight_epi32>(uint16_t* src, uint8_t* dst, int32_t data_size) {
   constexpr int32_t step      = 256 / 8 / sizeof(uint8_t);
   constexpr int32_t half_step = step >> 1;
 
-  __m256i coeff_v     = _mm256_set1_epi32(coeff_ * 256);
-  __m256i lut_min_v   = _mm256_set1_epi16(lut_min_);
-  __m256i uint8_max_v = _mm256_set1_epi32(255 * 256);
-  __m256i zero_v      = _mm256_setzero_si256();
+  const __m256i mul_v       = _mm256_set1_epi32(intweight_epi32_.mul);
+  const __m256i lut_min_v   = _mm256_set1_epi16(lut_min_);
+  const __m256i max_v       = _mm256_set1_epi16(intweight_epi32_.max);
+  const __m128i shift_v     = _mm_cvtsi32_si128(intweight_epi32_.shift);
+  const __m256i uint8_max_v = _mm256_set1_epi32(255);
+  const __m256i zero_v      = _mm256_setzero_si256();
 
-  const __m256i shuffle_idx = _mm256_set1_epi32(0x0D090501);
-  for (int i = 0; i < data_size; i += step) {
-    uint16_t* sptri   = src + i;
-    uint8_t* dptri    = dst + i;
-    __m256i src_sub_v = _mm256_subs_epu16(_mm256_loadu_epi16(sptri), lut_min_v);
-    __m256i srcs_hi   = _mm256_unpackhi_epi16(src_sub_v, zero_v);
-    __m256i srcs_lo   = _mm256_unpacklo_epi16(src_sub_v, zero_v);
+  const __m256i shuffle_idx = _mm256_set1_epi32(0x0C080400);
 
-    __m256i val_hi = _mm256_mullo_epi32(coeff_v, srcs_hi);
-    __m256i hi     = _mm256_min_epi32(val_hi, uint8_max_v);
-    __m256i val_lo = _mm256_mullo_epi32(coeff_v, srcs_lo);
-    __m256i lo     = _mm256_min_epi32(val_lo, uint8_max_v);
+  // 16要素を変換し，下位128bitにuint8_tで並べる
+  auto calc = [&](const uint16_t* sptr) {
+    const __m256i x     = _mm256_min_epu16(_mm256_subs_epu16(Load(sptr), lut_min_v), max_v);
+    const __m256i hi_v  = _mm256_srl_epi32(_mm256_mullo_epi32(_mm256_unpackhi_epi16(x, zero_v), mul_v), shift_v);
+    const __m256i lo_v  = _mm256_srl_epi32(_mm256_mullo_epi32(_mm256_unpacklo_epi16(x, zero_v), mul_v), shift_v);
+    const __m256i hi    = _mm256_min_epu32(hi_v, uint8_max_v);
+    const __m256i lo    = _mm256_min_epu32(lo_v, uint8_max_v);
+    const __m256i blend = _mm256_blend_epi32(_mm256_shuffle_epi8(lo, shuffle_idx), _mm256_shuffle_epi8(hi, shuffle_idx),
+                                             0b10101010);
+    return _mm256_permute4x64_epi64(blend, _MM_SHUFFLE(2, 1, 3, 0));
+  };
+
+  ForEachStep<step>(src, dst, data_size, [&](const uint16_t* sptri, uint8_t* dptri) {
+    Store(dptri, _mm256_blend_epi32(calc(sptri), calc(sptri + half_step), 0b11110000));
+  });
+}
+
+// uint8_tのLUT作成．naive_lut8と同じfloatの計算を8要素ずつ行い，32要素ずつuint8_tへパックする
+template<>
+void LUT::Create_Impl<LUT::Method::avx2_lut8>(int32_t lut_min, int32_t lut_max) {
+  constexpr int32_t step = 256 / 8 / sizeof(uint8_t);
+  uint8_t* lptr          = lut8_.get();
+
+  const float coeff = 256.0 / (lut_max - lut_min + 1);
 
+  const __m256 index_v      = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256 lut_min_v    = _mm256_set1_ps(lut_min);
+  const __m256 coeff_v      = _mm256_set1_ps(coeff);
+  const __m256i uint8_max_v = _mm256_set1_epi32(255);
+  const __m256i zero_v      = _mm256_setzero_si256();
+  // packs, packusで[a0-3 b0-3 c0-3 d0-3 | a4-7 b4-7 c4-7 d4-7]の順になるのを並べ直す
+  const __m256i order_v = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+  auto calc = [&](int32_t i) {
+    const __m256 i_v  = _mm256_add_ps(_mm256_set1_ps(i), index_v);
+    const __m256i val = _mm256_cvttps_epi32(_mm256_mul_ps(coeff_v, _mm256_sub_ps(i_v, lut_min_v)));
+    return _mm256_max_epi32(_mm256_min_epi32(val, uint8_max_v), zero_v);
+  };
+
+  // stepに揃えるためにbuild_begin_より前も書くが，同じ値になる
+  const int32_t simd_end = build_end_ / step * step;
+  int32_t i              = build_begin_ / step * step;
+  for (; i < simd_end; i += step) {
+    const __m256i ab = _mm256_packs_epi32(calc(i), calc(i + 8));
+    const __m256i cd = _mm256_packs_epi32(calc(i + 16), calc(i + 24));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lptr + i),
+                        _mm256_permutevar8x32_epi32(_mm256_packus_epi16(ab, cd), order_v));
+  }
+  for (; i < build_end_; i++) {
+    lptr[i] = std::clamp(static_cast<int32_t>(coeff * (i - lut_min)), 0, 255);
+  }
+}
+
+// 曲線のuint8_tのLUT作成．区間ごとにmemsetで埋める
+template<>
+void LUT::CreateCurve_Impl<LUT::Method::avx2_lut8>(int32_t lut_min, int32_t lut_max, const CurveParams& params) {
+  uint8_t* lptr = lut8_.get();
+  ForEachRun(params, build_begin_, build_end_, lut_min, lut_max,
+             [&](int32_t begin, int32_t end, int32_t value) { std::memset(lptr + begin, value, end - begin); });
+}
+
+// avx2_lutのテーブルをuint8_tにしたもの．gatherは要素の位置から4byte読むので，下位1byteだけをshuffleで集める
+template<>
+void LUT::Convert_Impl<LUT::Method::avx2_lut8>(uint16_t* src, uint8_t* dst, int32_t data_size) {
+  constexpr int32_t step      = 256 / 8 / sizeof(uint8_t);
+  constexpr int32_t half_step = step >> 1;
+  int32_t* lptr               = reinterpret_cast<int32_t*>(lut8_.get());
+
+  const __m256i zero_v      = _mm256_setzero_si256();
+  const __m256i shuffle_idx = _mm256_set1_epi32(0x0C080400);
+
+  ForEachStep<step>(src, dst, data_size, [&](const uint16_t* sptri, uint8_t* dptri) {
+    __m256i src_v       = Load(sptri);
+    __m256i idx_hi      = _mm256_unpackhi_epi16(src_v, zero_v);
+    __m256i idx_lo      = _mm256_unpacklo_epi16(src_v, zero_v);
+    __m256i hi          = _mm256_i32gather_epi32(lptr, idx_hi, sizeof(uint8_t));
+    __m256i lo          = _mm256_i32gather_epi32(lptr, idx_lo, sizeof(uint8_t));
     __m256i compress_hi = _mm256_shuffle_epi8(hi, shuffle_idx);
     __m256i compress_lo = _mm256_shuffle_epi8(lo, shuffle_idx);
     __m256i dst_lo_v    = _mm256_blend_epi32(compress_lo, compress_hi, 0b10101010);
     dst_lo_v            = _mm256_permute4x64_epi64(dst_lo_v, _MM_SHUFFLE(2, 1, 3, 0));
 
-    // half
-    src_sub_v = _mm256_subs_epu16(_mm256_loadu_epi16(sptri + half_step), lut_min_v);
-    srcs_hi   = _mm256_unpackhi_epi16(src_sub_v, zero_v);
-    srcs_lo   = _mm256_unpacklo_epi16(src_sub_v, zero_v);
-
-    val_hi = _mm256_mullo_epi32(coeff_v, srcs_hi);
-    hi     = _mm256_max_epi32(_mm256_min_epi32(val_hi, uint8_max_v), zero_v);
-    val_lo = _mm256_mullo_epi32(coeff_v, srcs_lo);
-    lo     = _mm256_max_epi32(_mm256_min_epi32(val_lo, uint8_max_v), zero_v);
-
+    src_v            = Load(sptri + half_step);
+    idx_hi           = _mm256_unpackhi_epi16(src_v, zero_v);
+    idx_lo           = _mm256_unpacklo_epi16(src_v, zero_v);
+    hi               = _mm256_i32gather_epi32(lptr, idx_hi, sizeof(uint8_t));
+    lo               = _mm256_i32gather_epi32(lptr, idx_lo, sizeof(uint8_t));
     compress_hi      = _mm256_shuffle_epi8(hi, shuffle_idx);
     compress_lo      = _mm256_shuffle_epi8(lo, shuffle_idx);
     __m256i dst_hi_v = _mm256_blend_epi32(compress_lo, compress_hi, 0b10101010);
@@ -206,6 +325,63 @@ void LUT::Convert_Impl<LUT::Method::avx2_calc_intweight_epi32>(uint16_t* src, ui
 
     dst_lo_v = _mm256_blend_epi32(dst_lo_v, dst_hi_v, 0b11110000);
 
-    _mm256_storeu_epi32(dptri, dst_lo_v);
+    Store(dptri, dst_lo_v);
+  });
+}
+
+// カラーマップ(1KiB)からgatherで8要素ずつ引く．端数は1要素ずつ
+template<>
+void LUT::ExpandPalette_Impl<LUT::Method::avx2_palette>(const uint8_t* src, uint32_t* dst, int32_t data_size) {
+  constexpr int32_t step = 256 / 8 / sizeof(uint32_t);
+  const int* pptr        = reinterpret_cast<const int*>(palette_.get());
+
+  const int32_t simd_end = data_size / (step * 2) * (step * 2);
+  for (int32_t i = 0; i < simd_end; i += step * 2) {
+    const __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m256i lo  = _mm256_i32gather_epi32(pptr, _mm256_cvtepu8_epi32(idx), sizeof(uint32_t));
+    const __m256i hi  = _mm256_i32gather_epi32(pptr, _mm256_cvtepu8_epi32(_mm_srli_si128(idx, 8)), sizeof(uint32_t));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + step), hi);
+  }
+  for (int32_t i = simd_end; i < data_size; i++) {
+    dst[i] = pptr[src[i]];
+  }
+}
+
+// テーブルを16byteずつ16個に分け，上位4bitがhの要素だけpshufbで引いてORする
+// x - 16hに0x70を飽和加算すると，上位4bitがhの要素だけ最上位bitが0(pshufbが0にしない)になる
+template<>
+void LUT::Convert8_Impl<LUT::Method::avx2_src8_pshufb>(const uint8_t* src, uint8_t* dst, int32_t data_size) {
+  constexpr int32_t step = 256 / 8 / sizeof(uint8_t);
+  const uint8_t* lptr    = lut256_.get();
+
+  __m256i tables[16];
+  for (int32_t h = 0; h < 16; h++) {
+    tables[h] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lptr + h * 16)));
+  }
+  const __m256i sixteen_v = _mm256_set1_epi8(16);
+  const __m256i select_v  = _mm256_set1_epi8(0x70);
+
+  auto calc = [&](const uint8_t* sptr) {
+    __m256i x     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sptr));
+    __m256i dst_v = _mm256_setzero_si256();
+    for (int32_t h = 0; h < 16; h++) {
+      dst_v = _mm256_or_si256(dst_v, _mm256_shuffle_epi8(tables[h], _mm256_adds_epu8(x, select_v)));
+      x     = _mm256_sub_epi8(x, sixteen_v);
+    }
+    return dst_v;
+  };
+
+  const int32_t simd_end = data_size / step * step;
+  for (int32_t i = 0; i < simd_end; i += step) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), calc(src + i));
+  }
+  if (simd_end < data_size) {
+    const int32_t remain           = data_size - simd_end;
+    alignas(32) uint8_t sbuf[step] = {};
+    alignas(32) uint8_t dbuf[step];
+    std::memcpy(sbuf, src + simd_end, remain);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(dbuf), calc(sbuf));
+    std::memcpy(dst + simd_end, dbuf, remain);
   }
 }
@@ -1,8 +1,66 @@
+#pragma GCC target("avx512f,avx512bw,avx512vl")
 #include "lut.h"
+#include "lut_avx512.h"
+#include "lut_curve.h"
+
 #include <omp.h>
 
 #include <immintrin.h>
 
+namespace {
+// avx2_lutと同じ計算(naive_lutと一致する)を16要素ずつ行う．端数はマスクして書き込む
+template<typename Store>
+inline void CreateLinear_Avx512(int32_t begin, int32_t end, int32_t lut_min, int32_t lut_max, const Store& store) {
+  constexpr int32_t step = 512 / 8 / sizeof(uint32_t);
+
+  const __m512 index_v = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m512 step_v  = _mm512_set1_ps(step);
+  const __m512 coeff_v = _mm512_set1_ps(static_cast<float>(256.0 / (lut_max - lut_min + 1)));
+  const __m512i zero_v = _mm512_setzero_si512();
+
+  int32_t i  = begin / step * step;
+  __m512 x_v = _mm512_add_ps(_mm512_set1_ps(i - lut_min), index_v);
+  for (; i < end; i += step) {
+    const __mmask16 mask = _bzhi_u32(0xFFFF, std::min(end - i, step));
+    const __m512i val    = _mm512_max_epi32(_mm512_cvttps_epi32(_mm512_mul_ps(coeff_v, x_v)), zero_v);
+    store(i, mask, val);
+    x_v = _mm512_add_ps(x_v, step_v);
+  }
+}
+} // namespace
+
+template<>
+void LUT::Create_Impl<LUT::Method::avx512f_lut>(int32_t lut_min, int32_t lut_max) {
+  uint32_t* lptr            = lut_.get();
+  const __m512i uint8_max_v = _mm512_set1_epi32(255);
+  CreateLinear_Avx512(build_begin_, build_end_, lut_min, lut_max, [&](int32_t i, __mmask16 mask, __m512i val) {
+    _mm512_mask_storeu_epi32(lptr + i, mask, _mm512_min_epi32(val, uint8_max_v));
+  });
+}
+
+// vpmovusdbで255に飽和させながらuint8_tにして書き込む
+template<>
+void LUT::Create_Impl<LUT::Method::avx512f_lut8>(int32_t lut_min, int32_t lut_max) {
+  uint8_t* lptr = lut8_.get();
+  CreateLinear_Avx512(build_begin_, build_end_, lut_min, lut_max, [&](int32_t i, __mmask16 mask, __m512i val) {
+    _mm512_mask_cvtusepi32_storeu_epi8(lptr + i, mask, val);
+  });
+}
+
+// 曲線のLUT作成．avx2_lutと同じく出力値が一定の区間ごとに埋め，区間の端数はマスクして書き込む
+template<>
+void LUT::CreateCurve_Impl<LUT::Method::avx512f_lut>(int32_t lut_min, int32_t lut_max, const CurveParams& params) {
+  constexpr int32_t step = 512 / 8 / sizeof(uint32_t);
+  uint32_t* lptr         = lut_.get();
+
+  ForEachRun(params, build_begin_, build_end_, lut_min, lut_max, [&](int32_t begin, int32_t end, int32_t value) {
+    const __m512i value_v = _mm512_set1_epi32(value);
+    for (int32_t i = begin; i < end; i += step) {
+      _mm512_mask_storeu_epi32(lptr + i, _bzhi_u32(0xFFFF, std::min(end - i, step)), value_v);
+    }
+  });
+}
+
 template<>
 void LUT::Convert_Impl<LUT::Method::avx512f_lut>(uint16_t* src, uint8_t* dst, int32_t data_size) {
   constexpr int32_t step      = 512 / 8 / sizeof(uint8_t);
@@ -10,27 +68,27 @@ void LUT::Convert_Impl<LUT::Method::avx512f_lut>(uint16_t* src, uint8_t* dst, in
   int32_t* lptr               = reinterpret_cast<int32_t*>(lut_.get());
 
   const __m512i zero_v = _mm512_setzero_si512();
-  for (int i = 0; i < data_size; i += step) {
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
     uint16_t* sptri = src + i;
     uint8_t* dptri  = dst + i;
-    __m512i src_v   = _mm512_loadu_epi16(sptri);
+    __m512i src_v   = lanes.Load(sptri, 0);
     __m512i idx_hi  = _mm512_unpackhi_epi16(src_v, zero_v);
     __m512i idx_lo  = _mm512_unpacklo_epi16(src_v, zero_v);
     __m512i hi      = _mm512_i32gather_epi32(idx_hi, lptr, sizeof(uint32_t));
     __m512i lo      = _mm512_i32gather_epi32(idx_lo, lptr, sizeof(uint32_t));
     __m512i pack    = _mm512_packus_epi16(lo, hi);
     __m256i dst_v   = _mm512_cvtepi16_epi8(pack);
-    _mm256_storeu_epi8(dptri, dst_v);
+    lanes.Store(dptri, 0, dst_v);
 
-    src_v  = _mm512_loadu_epi16(sptri + half_step);
+    src_v  = lanes.Load(sptri + half_step, half_step);
     idx_hi = _mm512_unpackhi_epi16(src_v, zero_v);
     idx_lo = _mm512_unpacklo_epi16(src_v, zero_v);
     hi     = _mm512_i32gather_epi32(idx_hi, lptr, sizeof(uint32_t));
     lo     = _mm512_i32gather_epi32(idx_lo, lptr, sizeof(uint32_t));
     pack   = _mm512_packus_epi16(lo, hi);
     dst_v  = _mm512_cvtepi16_epi8(pack);
-    _mm256_storeu_epi8(dptri + half_step, dst_v);
-  }
+    lanes.Store(dptri + half_step, half_step, dst_v);
+  });
 }
 
 template<> // requires AVX-512f
@@ -43,10 +101,10 @@ void LUT::Convert_Impl<LUT::Method::avx512f_calc>(uint16_t* src, uint8_t* dst, i
   const __m512i uint8_max_v = _mm512_set1_epi32(255);
   const __m512i zero_v      = _mm512_setzero_si512();
 
-  for (int i = 0; i < data_size; i += step) {
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
     uint16_t* sptri   = src + i;
     uint8_t* dptri    = dst + i;
-    __m512i src_sub_v = _mm512_subs_epu16(_mm512_loadu_epi16(sptri), lut_min_v);
+    __m512i src_sub_v = _mm512_subs_epu16(lanes.Load(sptri, 0), lut_min_v);
     __m512i srcs_hi   = _mm512_unpackhi_epi16(src_sub_v, zero_v);
     __m512i srcs_lo   = _mm512_unpacklo_epi16(src_sub_v, zero_v);
     __m512i val_hi    = _mm512_cvtps_epi32(_mm512_mul_ps(coeff_v, _mm512_cvtepi32_ps(srcs_hi)));
@@ -55,9 +113,9 @@ void LUT::Convert_Impl<LUT::Method::avx512f_calc>(uint16_t* src, uint8_t* dst, i
     __m512i lo        = _mm512_min_epi32(val_lo, uint8_max_v);
     __m512i pack      = _mm512_packus_epi16(lo, hi);
     __m256i dst_v     = _mm512_cvtepi16_epi8(pack);
-    _mm256_storeu_epi8(dptri, dst_v);
+    lanes.Store(dptri, 0, dst_v);
 
-    src_sub_v = _mm512_subs_epu16(_mm512_loadu_epi16(sptri + half_step), lut_min_v);
+    src_sub_v = _mm512_subs_epu16(lanes.Load(sptri + half_step, half_step), lut_min_v);
     srcs_hi   = _mm512_unpackhi_epi16(src_sub_v, zero_v);
     srcs_lo   = _mm512_unpacklo_epi16(src_sub_v, zero_v);
     val_hi    = _mm512_cvtps_epi32(_mm512_mul_ps(coeff_v, _mm512_cvtepi32_ps(srcs_hi)));
@@ -66,6 +124,51 @@ void LUT::Convert_Impl<LUT::Method::avx512f_calc>(uint16_t* src, uint8_t* dst, i
     lo        = _mm512_min_epi32(val_lo, uint8_max_v);
     pack      = _mm512_packus_epi16(lo, hi);
     dst_v     = _mm512_cvtepi16_epi8(pack);
-    _mm256_storeu_epi8(dptri + half_step, dst_v);
+    lanes.Store(dptri + half_step, half_step, dst_v);
+  });
+}
+
+// avx512f_lutのテーブルをuint8_tにしたもの．gatherは要素の位置から4byte読むので，上位3byteを落としてからパックする
+template<>
+void LUT::Convert_Impl<LUT::Method::avx512f_lut8>(uint16_t* src, uint8_t* dst, int32_t data_size) {
+  constexpr int32_t step      = 512 / 8 / sizeof(uint8_t);
+  constexpr int32_t half_step = step >> 1;
+  int32_t* lptr               = reinterpret_cast<int32_t*>(lut8_.get());
+
+  const __m512i zero_v       = _mm512_setzero_si512();
+  const __m512i uint8_mask_v = _mm512_set1_epi32(0xFF);
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
+    uint16_t* sptri = src + i;
+    uint8_t* dptri  = dst + i;
+    __m512i src_v   = lanes.Load(sptri, 0);
+    __m512i idx_hi  = _mm512_unpackhi_epi16(src_v, zero_v);
+    __m512i idx_lo  = _mm512_unpacklo_epi16(src_v, zero_v);
+    __m512i hi      = _mm512_and_si512(_mm512_i32gather_epi32(idx_hi, lptr, sizeof(uint8_t)), uint8_mask_v);
+    __m512i lo      = _mm512_and_si512(_mm512_i32gather_epi32(idx_lo, lptr, sizeof(uint8_t)), uint8_mask_v);
+    __m512i pack    = _mm512_packus_epi16(lo, hi);
+    __m256i dst_v   = _mm512_cvtepi16_epi8(pack);
+    lanes.Store(dptri, 0, dst_v);
+
+    src_v  = lanes.Load(sptri + half_step, half_step);
+    idx_hi = _mm512_unpackhi_epi16(src_v, zero_v);
+    idx_lo = _mm512_unpacklo_epi16(src_v, zero_v);
+    hi     = _mm512_and_si512(_mm512_i32gather_epi32(idx_hi, lptr, sizeof(uint8_t)), uint8_mask_v);
+    lo     = _mm512_and_si512(_mm512_i32gather_epi32(idx_lo, lptr, sizeof(uint8_t)), uint8_mask_v);
+    pack   = _mm512_packus_epi16(lo, hi);
+    dst_v  = _mm512_cvtepi16_epi8(pack);
+    lanes.Store(dptri + half_step, half_step, dst_v);
+  });
+}
+
+// カラーマップ(1KiB)からgatherで16要素ずつ引く
+template<>
+void LUT::ExpandPalette_Impl<LUT::Method::avx512f_palette>(const uint8_t* src, uint32_t* dst, int32_t data_size) {
+  constexpr int32_t step = 512 / 8 / sizeof(uint32_t);
+  const int32_t* pptr    = reinterpret_cast<const int32_t*>(palette_.get());
+
+  for (int32_t i = 0; i < data_size; i += step) {
+    const __mmask16 mask = _bzhi_u32(0xFFFF, std::min(data_size - i, step));
+    const __m512i idx    = _mm512_cvtepu8_epi32(_mm_maskz_loadu_epi8(mask, src + i));
+    _mm512_mask_storeu_epi32(dst + i, mask, _mm512_i32gather_epi32(idx, pptr, sizeof(uint32_t)));
   }
 }
@@ -1,5 +1,6 @@
+#pragma GCC target("avx512f,avx512bw,avx512vl,avx512vbmi")
 #include "lut.h"
-#include <iostream>
+#include "lut_avx512.h"
 
 #include <cassert>
 #include <cmath>
@@ -31,25 +32,25 @@ void LUT::Convert_Impl<LUT::Method::avx512vbmi_lut>(uint16_t* src, uint8_t* dst,
                       48, 44 | 0x40, 40 | 0x40, 36 | 0x40, 32 | 0x40, 44, 40, 36, 32, 28 | 0x40, 24 | 0x40, 20 | 0x40,
                       16 | 0x40, 28, 24, 20, 16, 12 | 0x40, 8 | 0x40, 4 | 0x40, 0 | 0x40, 12, 8, 4, 0);
 
-  for (int i = 0; i < data_size; i += step) {
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
     uint16_t* sptri = src + i;
     uint8_t* dptri  = dst + i;
-    __m512i src_v   = _mm512_loadu_epi16(sptri);
+    __m512i src_v   = lanes.Load(sptri, 0);
     __m512i idx_hi  = _mm512_unpackhi_epi16(src_v, zero_v);
     __m512i idx_lo  = _mm512_unpacklo_epi16(src_v, zero_v);
     __m512i hi      = _mm512_i32gather_epi32(idx_hi, lptr, sizeof(uint32_t));
     __m512i lo      = _mm512_i32gather_epi32(idx_lo, lptr, sizeof(uint32_t));
     __m512i dst_v1  = _mm512_permutex2var_epi8(lo, permute_index_v, hi);
 
-    src_v          = _mm512_loadu_epi16(sptri + half_step);
+    src_v          = lanes.Load(sptri + half_step, half_step);
     idx_hi         = _mm512_unpackhi_epi16(src_v, zero_v);
     idx_lo         = _mm512_unpacklo_epi16(src_v, zero_v);
     hi             = _mm512_i32gather_epi32(idx_hi, lptr, sizeof(uint32_t));
     lo             = _mm512_i32gather_epi32(idx_lo, lptr, sizeof(uint32_t));
     __m512i dst_v2 = _mm512_permutex2var_epi8(lo, permute_index_v, hi);
 
-    _mm512_storeu_epi8(dptri, _mm512_mask_blend_epi32(0b1111111100000000, dst_v1, dst_v2));
-  }
+    lanes.Store(dptri, 0, _mm512_mask_blend_epi32(0b1111111100000000, dst_v1, dst_v2));
+  });
 }
 
 template<> // requires AVX-512 VBMI: Cannon Lake or Tager Lake later or Zen4 or Zen4
@@ -79,9 +80,9 @@ void LUT::Convert_Impl<LUT::Method::avx512vbmi_calc>(uint16_t* src, uint8_t* dst
                       48, 44 | 0x40, 40 | 0x40, 36 | 0x40, 32 | 0x40, 44, 40, 36, 32, 28 | 0x40, 24 | 0x40, 20 | 0x40,
                       16 | 0x40, 28, 24, 20, 16, 12 | 0x40, 8 | 0x40, 4 | 0x40, 0 | 0x40, 12, 8, 4, 0);
 
-  for (int i = 0; i < data_size; i += step) {
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
     uint16_t* sptri   = src + i;
-    __m512i src_sub_v = _mm512_subs_epu16(_mm512_loadu_epi16(sptri), lut_min_v);
+    __m512i src_sub_v = _mm512_subs_epu16(lanes.Load(sptri, 0), lut_min_v);
     __m512i srcs_hi   = _mm512_unpackhi_epi16(src_sub_v, zero_v);
     __m512i srcs_lo   = _mm512_unpacklo_epi16(src_sub_v, zero_v);
     __m512i val_hi    = _mm512_cvtps_epi32(_mm512_mul_ps(coeff_v, _mm512_cvtepi32_ps(srcs_hi)));
@@ -91,7 +92,7 @@ void LUT::Convert_Impl<LUT::Method::avx512vbmi_calc>(uint16_t* src, uint8_t* dst
 
     __m512i dst_v1 = _mm512_permutex2var_epi8(lo, permute_index_v, hi);
 
-    src_sub_v      = _mm512_subs_epu16(_mm512_loadu_epi16(sptri + half_step), lut_min_v);
+    src_sub_v      = _mm512_subs_epu16(lanes.Load(sptri + half_step, half_step), lut_min_v);
     srcs_hi        = _mm512_unpackhi_epi16(src_sub_v, zero_v);
     srcs_lo        = _mm512_unpacklo_epi16(src_sub_v, zero_v);
     val_hi         = _mm512_cvtps_epi32(_mm512_mul_ps(coeff_v, _mm512_cvtepi32_ps(srcs_hi)));
@@ -100,19 +101,28 @@ void LUT::Convert_Impl<LUT::Method::avx512vbmi_calc>(uint16_t* src, uint8_t* dst
     lo             = _mm512_min_epi32(val_lo, uint8_max_v);
     __m512i dst_v2 = _mm512_permutex2var_epi8(lo, permute_index_v, hi);
 
-    _mm512_storeu_epi8(dst + i, _mm512_mask_blend_epi32(0b1111111100000000, dst_v1, dst_v2));
-  }
+    lanes.Store(dst + i, 0, _mm512_mask_blend_epi32(0b1111111100000000, dst_v1, dst_v2));
+  });
+}
+
+// avx2_calc_intweight_epu16の512bit版
+template<>
+void LUT::Create_Impl<LUT::Method::avx512vbmi_calc_intweight_epu16>(int32_t lut_min, int32_t lut_max) {
+  CreateIntWeight(lut_min, lut_max);
 }
 
-template<> // requires AVX-512 VBMI: Cannon Lake or Tager Lake later or Zen4 or Zen4 // WIP
+template<> // requires AVX-512 VBMI: Cannon Lake or Tager Lake later or Zen4 or Zen4
 void LUT::Convert_Impl<LUT::Method::avx512vbmi_calc_intweight_epu16>(uint16_t* src, uint8_t* dst, int32_t data_size) {
   constexpr int32_t step      = 512 / 8 / sizeof(uint8_t);
   constexpr int32_t half_step = step >> 1;
 
-  const __m512i coeff_v               = _mm512_set1_epi16(std::ceil(coeff_ * (0x100)));
-  const __m512i lut_min_v             = _mm512_set1_epi16(lut_min_);
-  const __m512i uint8_max_div_coeff_v = _mm512_set1_epi16(255.0 / coeff_);
-  const uint8_t permute_index[64]     = {
+  const __m512i mul_v             = _mm512_set1_epi16(intweight_epu16_.mul);
+  const __m512i lut_min_v         = _mm512_set1_epi16(lut_min_);
+  const __m512i max_v             = _mm512_set1_epi16(intweight_epu16_.max);
+  const __m128i pre_shift_v       = _mm_cvtsi32_si128(intweight_epu16_.pre_shift);
+  const __m128i shift_v           = _mm_cvtsi32_si128(intweight_epu16_.shift);
+  const __m512i uint8_max_v       = _mm512_set1_epi16(255);
+  const uint8_t permute_index[64] = {
       0,         2,         4,         6,         8,         10,        12,        14,        16,        18,
       20,        22,        24,        26,        28,        30,        32,        34,        36,        38,
       40,        42,        44,        46,        48,        50,        52,        54,        56,        58,
@@ -121,90 +131,196 @@ void LUT::Convert_Impl<LUT::Method::avx512vbmi_calc_intweight_epu16>(uint16_t* s
       0x40 | 36, 0x40 | 38, 0x40 | 40, 0x40 | 42, 0x40 | 44, 0x40 | 46, 0x40 | 48, 0x40 | 50, 0x40 | 52, 0x40 | 54,
       0x40 | 56, 0x40 | 58, 0x40 | 60, 0x40 | 62};
   const __m512i permute_index_v = _mm512_loadu_si512(permute_index);
-  // setr_epi8 not exists
-  // const __m512i permute_index_v = _mm512_set_epi8(
-  //     60 | 0x40, 56 | 0x40, 52 | 0x40, 48 | 0x40, 60, 56, 52, 48,
-  //     44 | 0x40, 40 | 0x40, 36 | 0x40, 32 | 0x40, 44, 40, 36, 32,
-  //     28 | 0x40, 24 | 0x40, 20 | 0x40, 16 | 0x40, 28, 24, 20, 16,
-  //     12 | 0x40,  8 | 0x40,  4 | 0x40,  0 | 0x40, 12, 8, 4, 0,
-  //     60 | 0x40, 56 | 0x40, 52 | 0x40, 48 | 0x40, 60, 56, 52, 48,
-  //     44 | 0x40, 40 | 0x40, 36 | 0x40, 32 | 0x40, 44, 40, 36, 32,
-  //     28 | 0x40, 24 | 0x40, 20 | 0x40, 16 | 0x40, 28, 24, 20, 16,
-  //     12 | 0x40,  8 | 0x40,  4 | 0x40,  0 | 0x40, 12, 8, 4, 0);
-
-  for (int i = 0; i < data_size; i += step) {
-    uint16_t* sptri = src + i;
-    __m512i src_sub_v =
-        _mm512_min_epu16(_mm512_subs_epu16(_mm512_loadu_epi16(reinterpret_cast<const void*>(sptri)), lut_min_v), uint8_max_div_coeff_v);
-    __m512i dst_v1 = _mm512_srli_epi16(_mm512_mullo_epi16(src_sub_v, coeff_v), 8);
 
-    // half
-    src_sub_v =
-        _mm512_min_epu16(_mm512_subs_epu16(_mm512_loadu_epi16(reinterpret_cast<const void*>(sptri + half_step)), lut_min_v), uint8_max_div_coeff_v);
-    __m512i dst_v2 = _mm512_srli_epi16(_mm512_mullo_epi16(src_sub_v, coeff_v), 8);
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
+    auto calc = [&](int32_t offset) {
+      const __m512i x = _mm512_min_epu16(_mm512_subs_epu16(lanes.Load(src + i + offset, offset), lut_min_v), max_v);
+      const __m512i v = _mm512_srl_epi16(_mm512_mulhi_epu16(_mm512_sll_epi16(x, pre_shift_v), mul_v), shift_v);
+      return _mm512_min_epu16(v, uint8_max_v);
+    };
+    lanes.Store(dst + i, 0, _mm512_permutex2var_epi8(calc(0), permute_index_v, calc(half_step)));
+  });
+}
 
-    __m512i dst_v = _mm512_permutex2var_epi8(dst_v1, permute_index_v, dst_v2);
-    _mm512_storeu_epi32(dst + i, dst_v);
-  }
+// avx2_calc_intweight_epi32の512bit版
+template<>
+void LUT::Create_Impl<LUT::Method::avx512vbmi_calc_intweight_epi32>(int32_t lut_min, int32_t lut_max) {
+  CreateIntWeight(lut_min, lut_max);
 }
 
-template<> // requires AVX-512 VBMI: Cannon Lake or Tager Lake later or Zen4 or Zen4 // WIP
+template<> // requires AVX-512 VBMI: Cannon Lake or Tager Lake later or Zen4 or Zen4
 void LUT::Convert_Impl<LUT::Method::avx512vbmi_calc_intweight_epi32>(uint16_t* src, uint8_t* dst, int32_t data_size) {
-  // assert(false);
   constexpr int32_t step      = 512 / 8 / sizeof(uint8_t);
   constexpr int32_t half_step = step >> 1;
 
-  const __m512i coeff_v           = _mm512_set1_epi32(coeff_ * 256);
+  const __m512i mul_v             = _mm512_set1_epi32(intweight_epi32_.mul);
   const __m512i lut_min_v         = _mm512_set1_epi16(lut_min_);
-  const __m512i uint8_max_v       = _mm512_set1_epi32(255 * 256);
+  const __m512i max_v             = _mm512_set1_epi16(intweight_epi32_.max);
+  const __m128i shift_v           = _mm_cvtsi32_si128(intweight_epi32_.shift);
+  const __m512i uint8_max_v       = _mm512_set1_epi32(255);
   const __m512i zero_v            = _mm512_setzero_si512();
-  const uint8_t permute_index[64] = {1,  5,  9,  13, 0x40 | 1,  0x40 | 5,  0x40 | 9,  0x40 | 13,
-                                     17, 21, 25, 29, 0x40 | 17, 0x40 | 21, 0x40 | 25, 0x40 | 29,
-                                     33, 37, 41, 45, 0x40 | 33, 0x40 | 37, 0x40 | 41, 0x40 | 45,
-                                     49, 53, 57, 61, 0x40 | 49, 0x40 | 53, 0x40 | 57, 0x40 | 61,
-                                     1,  5,  9,  13, 0x40 | 1,  0x40 | 5,  0x40 | 9,  0x40 | 13,
-                                     17, 21, 25, 29, 0x40 | 17, 0x40 | 21, 0x40 | 25, 0x40 | 29,
-                                     33, 37, 41, 45, 0x40 | 33, 0x40 | 37, 0x40 | 41, 0x40 | 45,
-                                     49, 53, 57, 61, 0x40 | 49, 0x40 | 53, 0x40 | 57, 0x40 | 61};
+  const uint8_t permute_index[64] = {0,  4,  8,  12, 0x40 | 0,  0x40 | 4,  0x40 | 8,  0x40 | 12,
+                                     16, 20, 24, 28, 0x40 | 16, 0x40 | 20, 0x40 | 24, 0x40 | 28,
+                                     32, 36, 40, 44, 0x40 | 32, 0x40 | 36, 0x40 | 40, 0x40 | 44,
+                                     48, 52, 56, 60, 0x40 | 48, 0x40 | 52, 0x40 | 56, 0x40 | 60,
+                                     0,  4,  8,  12, 0x40 | 0,  0x40 | 4,  0x40 | 8,  0x40 | 12,
+                                     16, 20, 24, 28, 0x40 | 16, 0x40 | 20, 0x40 | 24, 0x40 | 28,
+                                     32, 36, 40, 44, 0x40 | 32, 0x40 | 36, 0x40 | 40, 0x40 | 44,
+                                     48, 52, 56, 60, 0x40 | 48, 0x40 | 52, 0x40 | 56, 0x40 | 60};
   const __m512i permute_index_v   = _mm512_loadu_si512(reinterpret_cast<const void*>(permute_index));
-  // setr_epi8 not exists
-  // const __m512i permute_index_v = _mm512_set_epi8(
-  //     60 | 0x40, 56 | 0x40, 52 | 0x40, 48 | 0x40, 60, 56, 52, 48,
-  //     44 | 0x40, 40 | 0x40, 36 | 0x40, 32 | 0x40, 44, 40, 36, 32,
-  //     28 | 0x40, 24 | 0x40, 20 | 0x40, 16 | 0x40, 28, 24, 20, 16,
-  //     12 | 0x40,  8 | 0x40,  4 | 0x40,  0 | 0x40, 12, 8, 4, 0,
-  //     60 | 0x40, 56 | 0x40, 52 | 0x40, 48 | 0x40, 60, 56, 52, 48,
-  //     44 | 0x40, 40 | 0x40, 36 | 0x40, 32 | 0x40, 44, 40, 36, 32,
-  //     28 | 0x40, 24 | 0x40, 20 | 0x40, 16 | 0x40, 28, 24, 20, 16,
-  //     12 | 0x40,  8 | 0x40,  4 | 0x40,  0 | 0x40, 12, 8, 4, 0);
-
-  const int32_t loop_end = data_size - step + 1;
-  int i                  = 0;
-  for (; i < loop_end; i += step) {
-    uint16_t* sptri   = src + i;
-    __m512i src_sub_v = _mm512_subs_epu16(_mm512_loadu_epi16(reinterpret_cast<const void*>(sptri)), lut_min_v);
-    __m512i srcs_hi   = _mm512_unpackhi_epi16(src_sub_v, zero_v);
-    __m512i srcs_lo   = _mm512_unpacklo_epi16(src_sub_v, zero_v);
-    __m512i val_hi    = _mm512_mullo_epi32(coeff_v, srcs_hi);
-    __m512i hi        = _mm512_min_epi32(val_hi, uint8_max_v);
-    __m512i val_lo    = _mm512_mullo_epi32(coeff_v, srcs_lo);
-    __m512i lo        = _mm512_min_epi32(val_lo, uint8_max_v);
 
-    __m512i dst_v1 = _mm512_permutex2var_epi8(lo, permute_index_v, hi);
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
+    auto calc = [&](int32_t offset) {
+      const __m512i x  = _mm512_min_epu16(_mm512_subs_epu16(lanes.Load(src + i + offset, offset), lut_min_v), max_v);
+      const __m512i hi = _mm512_srl_epi32(_mm512_mullo_epi32(_mm512_unpackhi_epi16(x, zero_v), mul_v), shift_v);
+      const __m512i lo = _mm512_srl_epi32(_mm512_mullo_epi32(_mm512_unpacklo_epi16(x, zero_v), mul_v), shift_v);
+      return _mm512_permutex2var_epi8(_mm512_min_epu32(lo, uint8_max_v), permute_index_v,
+                                      _mm512_min_epu32(hi, uint8_max_v));
+    };
+    lanes.Store(dst + i, 0, _mm512_mask_blend_epi32(0b1111111100000000, calc(0), calc(half_step)));
+  });
+}
 
-    src_sub_v      = _mm512_subs_epu16(_mm512_loadu_epi16(sptri + half_step), lut_min_v);
-    srcs_hi        = _mm512_unpackhi_epi16(src_sub_v, zero_v);
-    srcs_lo        = _mm512_unpacklo_epi16(src_sub_v, zero_v);
-    val_hi         = _mm512_mullo_epi32(coeff_v, srcs_hi);
-    hi             = _mm512_min_epi32(val_hi, uint8_max_v);
-    val_lo         = _mm512_mullo_epi32(coeff_v, srcs_lo);
-    lo             = _mm512_min_epi32(val_lo, uint8_max_v);
+// avx512vbmi_lutのテーブルをuint8_tにしたもの．permutex2var_epi8は各32bitの下位1byteだけを集めるので，
+// gatherで読んだ上位3byteはそのままでよい
+template<>
+void LUT::Convert_Impl<LUT::Method::avx512vbmi_lut8>(uint16_t* src, uint8_t* dst, int32_t data_size) {
+  constexpr int32_t step      = 512 / 8 / sizeof(uint8_t);
+  constexpr int32_t half_step = step >> 1;
+  int32_t* lptr               = reinterpret_cast<int32_t*>(lut8_.get());
+
+  const __m512i zero_v = _mm512_setzero_si512();
+  const __m512i permute_index_v =
+      _mm512_set_epi8(60 | 0x40, 56 | 0x40, 52 | 0x40, 48 | 0x40, 60, 56, 52, 48, 44 | 0x40, 40 | 0x40, 36 | 0x40,
+                      32 | 0x40, 44, 40, 36, 32, 28 | 0x40, 24 | 0x40, 20 | 0x40, 16 | 0x40, 28, 24, 20, 16, 12 | 0x40,
+                      8 | 0x40, 4 | 0x40, 0 | 0x40, 12, 8, 4, 0, 60 | 0x40, 56 | 0x40, 52 | 0x40, 48 | 0x40, 60, 56, 52,
+                      48, 44 | 0x40, 40 | 0x40, 36 | 0x40, 32 | 0x40, 44, 40, 36, 32, 28 | 0x40, 24 | 0x40, 20 | 0x40,
+                      16 | 0x40, 28, 24, 20, 16, 12 | 0x40, 8 | 0x40, 4 | 0x40, 0 | 0x40, 12, 8, 4, 0);
+
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
+    uint16_t* sptri = src + i;
+    uint8_t* dptri  = dst + i;
+    __m512i src_v   = lanes.Load(sptri, 0);
+    __m512i idx_hi  = _mm512_unpackhi_epi16(src_v, zero_v);
+    __m512i idx_lo  = _mm512_unpacklo_epi16(src_v, zero_v);
+    __m512i hi      = _mm512_i32gather_epi32(idx_hi, lptr, sizeof(uint8_t));
+    __m512i lo      = _mm512_i32gather_epi32(idx_lo, lptr, sizeof(uint8_t));
+    __m512i dst_v1  = _mm512_permutex2var_epi8(lo, permute_index_v, hi);
+
+    src_v          = lanes.Load(sptri + half_step, half_step);
+    idx_hi         = _mm512_unpackhi_epi16(src_v, zero_v);
+    idx_lo         = _mm512_unpacklo_epi16(src_v, zero_v);
+    hi             = _mm512_i32gather_epi32(idx_hi, lptr, sizeof(uint8_t));
+    lo             = _mm512_i32gather_epi32(idx_lo, lptr, sizeof(uint8_t));
     __m512i dst_v2 = _mm512_permutex2var_epi8(lo, permute_index_v, hi);
 
-    _mm512_storeu_epi8(dst + i, _mm512_mask_blend_epi32(0b1111111100000000, dst_v1, dst_v2));
+    lanes.Store(dptri, 0, _mm512_mask_blend_epi32(0b1111111100000000, dst_v1, dst_v2));
+  });
+}
+
+// range_max <= 256: 256byteのテーブルを4本のレジスタに置き，gatherの代わりにvpermi2b 2回で引く
+// 入力は飽和させてuint8_tにし，bit7で前半128byte・後半128byteのどちらの結果を使うか選ぶ
+template<>
+void LUT::Convert_Impl<LUT::Method::avx512vbmi_lut8_permute>(uint16_t* src, uint8_t* dst, int32_t data_size) {
+  constexpr int32_t step      = 512 / 8 / sizeof(uint8_t);
+  constexpr int32_t half_step = step >> 1;
+  assert(range_max_ <= 256);
+
+  const uint8_t* lptr = lut8_.get();
+  const __m512i lut0  = _mm512_loadu_si512(reinterpret_cast<const void*>(lptr));
+  const __m512i lut1  = _mm512_loadu_si512(reinterpret_cast<const void*>(lptr + 64));
+  const __m512i lut2  = _mm512_loadu_si512(reinterpret_cast<const void*>(lptr + 128));
+  const __m512i lut3  = _mm512_loadu_si512(reinterpret_cast<const void*>(lptr + 192));
+
+  ForEachStep(data_size, step, [&](int32_t i, const auto& lanes) {
+    uint16_t* sptri    = src + i;
+    const __m256i idx1 = _mm512_cvtusepi16_epi8(lanes.Load(sptri, 0));
+    const __m256i idx2 = _mm512_cvtusepi16_epi8(lanes.Load(sptri + half_step, half_step));
+    const __m512i idx  = _mm512_inserti64x4(_mm512_castsi256_si512(idx1), idx2, 1);
+    const __m512i lo   = _mm512_permutex2var_epi8(lut0, idx, lut1);
+    const __m512i hi   = _mm512_permutex2var_epi8(lut2, idx, lut3);
+    lanes.Store(dst + i, 0, _mm512_mask_blend_epi8(_mm512_movepi8_mask(idx), lo, hi));
+  });
+}
+
+// B, G, R, Aの各256byteをvpermi2bで64要素ずつ引き，BGRAへ並べ替える
+template<>
+void LUT::ExpandPalette_Impl<LUT::Method::avx512vbmi_palette>(const uint8_t* src, uint32_t* dst, int32_t data_size) {
+  constexpr int32_t step         = 512 / 8 / sizeof(uint8_t);
+  constexpr int32_t quarter_step = step >> 2;
+
+  const uint8_t* pptr = palette_planes_.get();
+  __m512i planes[4][4];
+  for (int32_t c = 0; c < 4; c++) {
+    for (int32_t j = 0; j < 4; j++) {
+      planes[c][j] = _mm512_loadu_si512(reinterpret_cast<const void*>(pptr + c * 256 + j * 64));
+    }
+  }
+  // 1チャンネル分: idxの下位7bitで128byteずつ引き，最上位bitで選ぶ
+  auto lookup = [&](const __m512i (&plane)[4], __m512i idx, __mmask64 upper) {
+    const __m512i lo = _mm512_permutex2var_epi8(plane[0], idx, plane[1]);
+    const __m512i hi = _mm512_permutex2var_epi8(plane[2], idx, plane[3]);
+    return _mm512_mask_blend_epi8(upper, lo, hi);
+  };
+
+  for (int32_t i = 0; i < data_size; i += step) {
+    const int32_t remain  = std::min(data_size - i, step);
+    const __m512i idx     = _mm512_maskz_loadu_epi8(_bzhi_u64(0xFFFFFFFFFFFFFFFF, remain), src + i);
+    const __mmask64 upper = _mm512_movepi8_mask(idx);
+    const __m512i b       = lookup(planes[0], idx, upper);
+    const __m512i g       = lookup(planes[1], idx, upper);
+    const __m512i r       = lookup(planes[2], idx, upper);
+    const __m512i a       = lookup(planes[3], idx, upper);
+    const __m512i bg_lo   = _mm512_unpacklo_epi8(b, g);
+    const __m512i bg_hi   = _mm512_unpackhi_epi8(b, g);
+    const __m512i ra_lo   = _mm512_unpacklo_epi8(r, a);
+    const __m512i ra_hi   = _mm512_unpackhi_epi8(r, a);
+    // p0..p3の128bitレーンkには要素16k + 0..3, 4..7, 8..11, 12..15が入る
+    const __m512i p0 = _mm512_unpacklo_epi16(bg_lo, ra_lo);
+    const __m512i p1 = _mm512_unpackhi_epi16(bg_lo, ra_lo);
+    const __m512i p2 = _mm512_unpacklo_epi16(bg_hi, ra_hi);
+    const __m512i p3 = _mm512_unpackhi_epi16(bg_hi, ra_hi);
+    // レーンを4x4で転置して要素順にする
+    const __m512i t0 = _mm512_shuffle_i64x2(p0, p1, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m512i t1 = _mm512_shuffle_i64x2(p2, p3, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m512i t2 = _mm512_shuffle_i64x2(p0, p1, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m512i t3 = _mm512_shuffle_i64x2(p2, p3, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m512i out[4] = {
+        _mm512_shuffle_i64x2(t0, t1, _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm512_shuffle_i64x2(t0, t1, _MM_SHUFFLE(3, 1, 3, 1)),
+        _mm512_shuffle_i64x2(t2, t3, _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm512_shuffle_i64x2(t2, t3, _MM_SHUFFLE(3, 1, 3, 1)),
+    };
+    for (int32_t j = 0; j < 4; j++) {
+      const __mmask16 mask = _bzhi_u32(0xFFFF, std::clamp(remain - j * quarter_step, 0, quarter_step));
+      _mm512_mask_storeu_epi32(dst + i + j * quarter_step, mask, out[j]);
+    }
+  }
+}
+
+// 256byteのテーブルを4本のレジスタに置き，下位7bitで2回vpermi2b，最上位bitで選ぶ
+template<>
+void LUT::Convert8_Impl<LUT::Method::avx512vbmi_src8_permute>(const uint8_t* src, uint8_t* dst, int32_t data_size) {
+  constexpr int32_t step = 512 / 8 / sizeof(uint8_t);
+
+  const uint8_t* lptr = lut256_.get();
+  const __m512i lut0  = _mm512_loadu_si512(reinterpret_cast<const void*>(lptr));
+  const __m512i lut1  = _mm512_loadu_si512(reinterpret_cast<const void*>(lptr + 64));
+  const __m512i lut2  = _mm512_loadu_si512(reinterpret_cast<const void*>(lptr + 128));
+  const __m512i lut3  = _mm512_loadu_si512(reinterpret_cast<const void*>(lptr + 192));
+
+  auto calc = [&](__m512i idx) {
+    const __m512i lo = _mm512_permutex2var_epi8(lut0, idx, lut1);
+    const __m512i hi = _mm512_permutex2var_epi8(lut2, idx, lut3);
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(idx), lo, hi);
+  };
+
+  const int32_t simd_end = data_size / step * step;
+  for (int32_t i = 0; i < simd_end; i += step) {
+    _mm512_storeu_si512(dst + i, calc(_mm512_loadu_si512(reinterpret_cast<const void*>(src + i))));
   }
-  for (; i < data_size; i++) {
-    // naive
-    std::cout << "naive" << std::endl;
+  if (simd_end < data_size) {
+    const __mmask64 mask = _bzhi_u64(0xFFFFFFFFFFFFFFFF, data_size - simd_end);
+    _mm512_mask_storeu_epi8(dst + simd_end, mask, calc(_mm512_maskz_loadu_epi8(mask, src + simd_end)));
   }
 }
@@ -1,4 +1,5 @@
 #include "lut.h"
+#include "lut_curve.h"
 
 #include <algorithm>
 
@@ -6,7 +7,7 @@ template<>
 void LUT::Create_Impl<LUT::Method::naive_lut>(int32_t lut_min, int32_t lut_max) {
   uint32_t* lptr = lut_.get();
   float coeff    = 256.0 / (lut_max - lut_min + 1);
-  for (int i = 0; i < range_max_; i++) {
+  for (int i = build_begin_; i < build_end_; i++) {
     lptr[i] = std::clamp(static_cast<int32_t>(coeff * (i - lut_min)), 0, 255);
   }
 }
@@ -32,3 +33,52 @@ void LUT::Convert_Impl<LUT::Method::naive_calc>(uint16_t* src, uint8_t* dst, int
     dst[i] = std::clamp(static_cast<int32_t>(coeff_ * (src[i] - lut_min_)), 0, 255);
   }
 }
+
+template<>
+void LUT::CreateCurve_Impl<LUT::Method::naive_lut>(int32_t lut_min, int32_t lut_max, const CurveParams& params) {
+  uint32_t* lptr = lut_.get();
+  for (int i = build_begin_; i < build_end_; i++) {
+    lptr[i] = CurveValue(params, lut_min, lut_max, i);
+  }
+}
+
+template<>
+void LUT::Create_Impl<LUT::Method::naive_lut8>(int32_t lut_min, int32_t lut_max) {
+  uint8_t* lptr = lut8_.get();
+  float coeff   = 256.0 / (lut_max - lut_min + 1);
+  for (int i = build_begin_; i < build_end_; i++) {
+    lptr[i] = std::clamp(static_cast<int32_t>(coeff * (i - lut_min)), 0, 255);
+  }
+}
+
+template<>
+void LUT::Convert_Impl<LUT::Method::naive_lut8>(uint16_t* src, uint8_t* dst, int32_t data_size) {
+  uint8_t* lptr = lut8_.get();
+  for (int i = 0; i < data_size; i++) {
+    dst[i] = lptr[src[i]];
+  }
+}
+
+template<>
+void LUT::CreateCurve_Impl<LUT::Method::naive_lut8>(int32_t lut_min, int32_t lut_max, const CurveParams& params) {
+  uint8_t* lptr = lut8_.get();
+  for (int i = build_begin_; i < build_end_; i++) {
+    lptr[i] = CurveValue(params, lut_min, lut_max, i);
+  }
+}
+
+template<>
+void LUT::ExpandPalette_Impl<LUT::Method::naive_palette>(const uint8_t* src, uint32_t* dst, int32_t data_size) {
+  const uint32_t* pptr = palette_.get();
+  for (int i = 0; i < data_size; i++) {
+    dst[i] = pptr[src[i]];
+  }
+}
+
+template<>
+void LUT::Convert8_Impl<LUT::Method::naive_src8>(const uint8_t* src, uint8_t* dst, int32_t data_size) {
+  const uint8_t* lptr = lut256_.get();
+  for (int i = 0; i < data_size; i++) {
+    dst[i] = lptr[src[i]];
+  }
+}
@@ -1,16 +1,22 @@
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
 #include <concepts>
+#include <filesystem>
 #include <format>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <new>
+#include <random>
 #include <ranges>
 #include <span>
+#include <tuple>
 #include <valarray>
+#include <vector>
 
-#include <InstructionInfo.h>
+#include "instruction_info.h"
 
 #include "lut.h"
 
@@ -60,6 +66,7 @@ auto main() -> int {
   // constexpr int32_t LUT_END = static_cast<int32_t>(std::numeric_limits<uint16_t>::max()) + 1;
   constexpr int32_t LUT_END = 0xFFFF + 1;
   LUT lut(LUT_END);
+  LUT lut8(LUT_END, LUT::Storage::Byte);
 
   for (auto width : width_samples) {
     uint16_t* sptr = src.get();
@@ -206,8 +213,9 @@ auto main() -> int {
                 << std::endl;
 
       // avx2 calc int weight convert
+      lut.Create_Impl<LUT::Method::avx2_calc_intweight_epu16>(lut_min, lut_max);
       std::ranges::fill(std::span(dptr, data_size), 0);
-      std::cout << "avx2_calc_int_weight_epu16 ";
+      std::cout << std::format("avx2_calc_int_weight_epu16 exact: {} ", lut.intweight_epu16_.exact);
       start = std::chrono::high_resolution_clock::now();
       for (auto current_loop : std::views::iota(0, loop_count)) {
         lut.Convert_Impl<LUT::Method::avx2_calc_intweight_epu16>(sptr, dptr, data_size);
@@ -218,8 +226,9 @@ auto main() -> int {
                 << std::endl;
 
       // avx2 calc int weight convert
+      lut.Create_Impl<LUT::Method::avx2_calc_intweight_epi32>(lut_min, lut_max);
       std::ranges::fill(std::span(dptr, data_size), 0);
-      std::cout << "avx2_calc_int_weight_epi32 ";
+      std::cout << std::format("avx2_calc_int_weight_epi32 exact: {} ", lut.intweight_epi32_.exact);
       start = std::chrono::high_resolution_clock::now();
       for (auto current_loop : std::views::iota(0, loop_count)) {
         lut.Convert_Impl<LUT::Method::avx2_calc_intweight_epi32>(sptr, dptr, data_size);
@@ -257,8 +266,9 @@ auto main() -> int {
                 << std::endl;
 
       // avx512 calc int weight epu16 convert
+      lut.Create_Impl<LUT::Method::avx512vbmi_calc_intweight_epu16>(lut_min, lut_max);
       std::ranges::fill(std::span(dptr, data_size), 0);
-      std::cout << "avx512_vbmi_calc_intweight_epu16 ";
+      std::cout << std::format("avx512_vbmi_calc_intweight_epu16 exact: {} ", lut.intweight_epu16_.exact);
       start = std::chrono::high_resolution_clock::now();
       for (auto current_loop : std::views::iota(0, loop_count)) {
         lut.Convert_Impl<LUT::Method::avx512vbmi_calc_intweight_epu16>(sptr, dptr, data_size);
@@ -269,8 +279,9 @@ auto main() -> int {
                 << std::endl;
 
       // avx512 calc int weight epi32 convert
+      lut.Create_Impl<LUT::Method::avx512vbmi_calc_intweight_epi32>(lut_min, lut_max);
       std::ranges::fill(std::span(dptr, data_size), 0);
-      std::cout << "avx512vbmi_calc_intweigth_epi32 ";
+      std::cout << std::format("avx512vbmi_calc_intweight_epi32 exact: {} ", lut.intweight_epi32_.exact);
       start = std::chrono::high_resolution_clock::now();
       for (auto current_loop : std::views::iota(0, loop_count)) {
         lut.Convert_Impl<LUT::Method::avx512vbmi_calc_intweight_epi32>(sptr, dptr, data_size);
@@ -304,6 +315,585 @@ auto main() -> int {
     time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
     std::cout << std::format("time: {}, diff: {}", time_count / loop_count, CalcDiff(dptr, rptr, data_size))
               << std::endl;
+
+    // Auto Convert (multi thread)
+    for (auto num_threads : {2, 4, 0}) {
+      lut.SetNumThreads(num_threads);
+      std::ranges::fill(std::span(dptr, data_size), 0);
+      std::cout << std::format("threads: {} ", lut.GetNumThreads());
+      start = std::chrono::high_resolution_clock::now();
+      for (auto current_loop : std::views::iota(0, loop_count)) {
+        lut.Convert(sptr, dptr, data_size);
+      }
+      end        = std::chrono::high_resolution_clock::now();
+      time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      std::cout << std::format("time: {}, diff: {}", time_count / loop_count, CalcDiff(dptr, rptr, data_size))
+                << std::endl;
+    }
+    lut.SetNumThreads(1);
+
+    // 端数: data_sizeがstepの倍数でなくても範囲外へ書き込まない
+    std::cout << "Tail" << std::endl;
+    using ConvertImpl = void (LUT::*)(uint16_t*, uint8_t*, int32_t);
+    const std::tuple<const char*, bool, ConvertImpl> convert_impls[] = {
+        {"naive_lut", true, &LUT::Convert_Impl<LUT::Method::naive_lut>},
+        {"naive_calc", true, &LUT::Convert_Impl<LUT::Method::naive_calc>},
+        {"avx2_lut", supported_avx2, &LUT::Convert_Impl<LUT::Method::avx2_lut>},
+        {"avx2_calc", supported_avx2, &LUT::Convert_Impl<LUT::Method::avx2_calc>},
+        {"avx512f_lut", supported_avx512f, &LUT::Convert_Impl<LUT::Method::avx512f_lut>},
+        {"avx512f_calc", supported_avx512f, &LUT::Convert_Impl<LUT::Method::avx512f_calc>},
+        {"avx512vbmi_lut", supported_avx512vbmi, &LUT::Convert_Impl<LUT::Method::avx512vbmi_lut>},
+        {"avx512vbmi_calc", supported_avx512vbmi, &LUT::Convert_Impl<LUT::Method::avx512vbmi_calc>},
+        {"avx2_calc_intweight_epu16", supported_avx2, &LUT::Convert_Impl<LUT::Method::avx2_calc_intweight_epu16>},
+        {"avx2_calc_intweight_epi32", supported_avx2, &LUT::Convert_Impl<LUT::Method::avx2_calc_intweight_epi32>},
+        {"avx512vbmi_calc_intweight_epu16", supported_avx512vbmi,
+         &LUT::Convert_Impl<LUT::Method::avx512vbmi_calc_intweight_epu16>},
+        {"avx512vbmi_calc_intweight_epi32", supported_avx512vbmi,
+         &LUT::Convert_Impl<LUT::Method::avx512vbmi_calc_intweight_epi32>},
+    };
+    lut.Create_Impl<LUT::Method::naive_lut>(lut_min, lut_max);
+    lut.Create_Impl<LUT::Method::naive_calc>(lut_min, lut_max);
+    lut.CreateIntWeight(lut_min, lut_max);
+    for (auto tail_size : {1, 31, 33, 63, data_size - 13}) {
+      for (const auto& [name, supported, convert] : convert_impls) {
+        if (!supported) {
+          continue;
+        }
+        std::ranges::fill(std::span(dptr, data_size), 0xAA);
+        (lut.*convert)(sptr, dptr, tail_size);
+        const auto guard   = std::span(dptr + tail_size, std::min(64, data_size - tail_size));
+        const bool overrun = std::ranges::any_of(guard, [](auto v) { return v != 0xAA; });
+        std::cout << std::format("{} size: {}, diff: {}, overrun: {}", name, tail_size,
+                                 CalcDiff(dptr, rptr, tail_size), overrun)
+                  << std::endl;
+      }
+    }
+
+    // ROI: 行の間に隙間がある2次元領域
+    const int32_t roi_rows = width / 2 - 1;
+    const int32_t roi_cols = width / 2 - 3;
+    std::ranges::fill(std::span(dptr, data_size), 0xAA);
+    lut.Convert(sptr + width + 1, width * sizeof(uint16_t), dptr + width + 1, width, roi_rows, roi_cols);
+    float roi_diff   = 0;
+    bool roi_overrun = false;
+    for (auto y : std::views::iota(1, roi_rows + 1)) {
+      roi_diff += CalcDiff(dptr + y * width + 1, rptr + y * width + 1, roi_cols);
+      roi_overrun |= dptr[y * width] != 0xAA || dptr[y * width + roi_cols + 1] != 0xAA;
+    }
+    std::cout << std::format("ROI diff: {}, overrun: {}", roi_diff / roi_rows, roi_overrun) << std::endl;
+
+    // 固定小数点: exactの窓ではnaive_lutと全ての入力で一致する
+    std::cout << "IntWeight windows" << std::endl;
+    const std::pair<int32_t, int32_t> windows[] = {
+        {0x0000, 0x00FF}, {0x0100, 0x01E3}, {0x0000, 0x000F}, {0x0123, 0x0456},
+        {0x0000, 0x0FFF}, {0x1000, 0x3FFF}, {0x0000, 0xFFFF}, {0x7FFF, 0x8000},
+    };
+    std::vector<uint8_t> window_ref(data_size);
+    for (const auto& [window_min, window_max] : windows) {
+      lut.Create_Impl<LUT::Method::naive_lut>(window_min, window_max);
+      for (auto i : std::views::iota(0, data_size)) {
+        window_ref[i] = lut.lut_[sptr[i]];
+      }
+      lut.CreateIntWeight(window_min, window_max);
+      std::cout << std::format("[{:#06x}, {:#06x}] exact epu16: {}, epi32: {}", window_min, window_max,
+                               lut.intweight_epu16_.exact, lut.intweight_epi32_.exact);
+      for (const auto& [name, supported, convert] : convert_impls | std::views::drop(8)) {
+        if (!supported) {
+          continue;
+        }
+        (lut.*convert)(sptr, dptr, data_size);
+        const bool match = std::ranges::equal(std::span(dptr, data_size), window_ref);
+        std::cout << std::format(", {}: {}", name, match ? "match" : "mismatch");
+      }
+      std::cout << std::endl;
+    }
+
+    // テーブルの作成: SIMDの版もnaive_lut(8)と一致する
+    // 書き込まなかった要素を見逃さないように，各カーネルの前にテーブルを基準値の反転で埋める
+    std::cout << "Create windows" << std::endl;
+    using CreateImpl = void (LUT::*)(int32_t, int32_t);
+    const std::tuple<const char*, bool, bool, CreateImpl> create_impls[] = {
+        {"avx2_lut", supported_avx2, false, &LUT::Create_Impl<LUT::Method::avx2_lut>},
+        {"avx512f_lut", supported_avx512f, false, &LUT::Create_Impl<LUT::Method::avx512f_lut>},
+        {"avx2_lut8", supported_avx2, true, &LUT::Create_Impl<LUT::Method::avx2_lut8>},
+        {"avx512f_lut8", supported_avx512f, true, &LUT::Create_Impl<LUT::Method::avx512f_lut8>},
+    };
+    std::vector<uint32_t> window_lut(LUT_END);
+    for (const auto& [window_min, window_max] : windows) {
+      lut.Create_Impl<LUT::Method::naive_lut>(window_min, window_max);
+      std::ranges::copy(std::span(lut.lut_.get(), LUT_END), window_lut.begin());
+      std::cout << std::format("[{:#06x}, {:#06x}]", window_min, window_max);
+      for (const auto& [name, supported, byte, create] : create_impls) {
+        if (!supported) {
+          continue;
+        }
+        LUT& target = byte ? lut8 : lut;
+        for (auto i : std::views::iota(0, LUT_END)) {
+          if (byte) {
+            lut8.lut8_[i] = static_cast<uint8_t>(~window_lut[i]);
+          } else {
+            lut.lut_[i] = ~window_lut[i];
+          }
+        }
+        (target.*create)(window_min, window_max);
+        const bool match = byte ? std::ranges::equal(std::span(lut8.lut8_.get(), LUT_END), window_lut)
+                                : std::ranges::equal(std::span(lut.lut_.get(), LUT_END), window_lut);
+        std::cout << std::format(", {}: {}", name, match ? "match" : "mismatch");
+      }
+      std::cout << std::endl;
+    }
+    for (const auto& [name, supported, byte, create] : create_impls) {
+      if (!supported) {
+        continue;
+      }
+      LUT& target = byte ? lut8 : lut;
+      std::cout << std::format("{} ", name);
+      start = std::chrono::high_resolution_clock::now();
+      for (auto current_loop : std::views::iota(0, loop_count)) {
+        (target.*create)(lut_min, lut_max);
+      }
+      end        = std::chrono::high_resolution_clock::now();
+      time_count = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      std::cout << std::format("time: {} ns", time_count / loop_count) << std::endl;
+    }
+
+    // 曲線: naive_lutで作ったテーブルを基準にする
+    std::cout << "Curve" << std::endl;
+    constexpr int32_t curve_min                 = 0x0100;
+    constexpr int32_t curve_max                 = 0x0FFF;
+    constexpr std::array<uint8_t, 5> user_table = {0, 255, 32, 128, 64};
+
+    const std::tuple<const char*, LUT::CurveParams> curves[] = {
+        {"gamma", {.curve = LUT::Curve::Gamma, .gamma = 2.2f}},
+        {"log", {.curve = LUT::Curve::Log, .gain = 100.0f}},
+        {"sigmoid", {.curve = LUT::Curve::Sigmoid, .gain = 10.0f}},
+        {"table", {.curve = LUT::Curve::Table, .table = user_table}},
+    };
+    std::vector<uint32_t> curve_lut(LUT_END);
+    std::vector<uint8_t> curve_ref(data_size);
+    for (const auto& [name, params] : curves) {
+      std::cout << std::format("{} naive_lut ", name);
+      start = std::chrono::high_resolution_clock::now();
+      for (auto current_loop : std::views::iota(0, loop_count)) {
+        lut.CreateCurve_Impl<LUT::Method::naive_lut>(curve_min, curve_max, params);
+      }
+      end        = std::chrono::high_resolution_clock::now();
+      time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      std::cout << std::format("time: {}", time_count / loop_count) << std::endl;
+      std::ranges::copy(std::span(lut.lut_.get(), LUT_END), curve_lut.begin());
+      for (auto i : std::views::iota(0, data_size)) {
+        curve_ref[i] = curve_lut[sptr[i]];
+      }
+
+      using CreateCurveImpl = void (LUT::*)(int32_t, int32_t, const LUT::CurveParams&);
+      const std::tuple<const char*, bool, CreateCurveImpl> create_curve_impls[] = {
+          {"avx2_lut", supported_avx2, &LUT::CreateCurve_Impl<LUT::Method::avx2_lut>},
+          {"avx512f_lut", supported_avx512f, &LUT::CreateCurve_Impl<LUT::Method::avx512f_lut>},
+      };
+      for (const auto& [impl_name, supported, create_curve] : create_curve_impls) {
+        if (!supported) {
+          continue;
+        }
+        std::ranges::transform(curve_lut, lut.lut_.get(), [](uint32_t v) { return ~v; });
+        std::cout << std::format("{} {} ", name, impl_name);
+        start = std::chrono::high_resolution_clock::now();
+        for (auto current_loop : std::views::iota(0, loop_count)) {
+          (lut.*create_curve)(curve_min, curve_max, params);
+        }
+        end        = std::chrono::high_resolution_clock::now();
+        time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        std::cout << std::format("time: {}, diff: {}", time_count / loop_count,
+                                 CalcDiff(lut.lut_.get(), curve_lut.data(), LUT_END))
+                  << std::endl;
+      }
+
+      // Auto Convert
+      lut.Create(curve_min, curve_max, params);
+      std::ranges::fill(std::span(dptr, data_size), 0);
+      std::cout << std::format("{} Auto Impl ", name);
+      start = std::chrono::high_resolution_clock::now();
+      for (auto current_loop : std::views::iota(0, loop_count)) {
+        lut.Convert(sptr, dptr, data_size);
+      }
+      end        = std::chrono::high_resolution_clock::now();
+      time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      std::cout << std::format("time: {}, diff: {}", time_count / loop_count,
+                               CalcDiff(dptr, curve_ref.data(), data_size))
+                << std::endl;
+    }
+    lut.Create(lut_min, lut_max);
+
+    // uint8_tのテーブル
+    std::cout << "Storage::Byte" << std::endl;
+    std::ranges::fill(std::span(lut8.lut8_.get(), LUT_END), 0);
+    std::cout << "naive_lut8 ";
+    start = std::chrono::high_resolution_clock::now();
+    for (auto current_loop : std::views::iota(0, loop_count)) {
+      lut8.Create_Impl<LUT::Method::naive_lut8>(lut_min, lut_max);
+    }
+    end        = std::chrono::high_resolution_clock::now();
+    time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::cout << std::format("time: {}, diff: {}", time_count / loop_count,
+                             CalcDiff(lut8.lut8_.get(), ref_lut, LUT_END))
+              << std::endl;
+    if (supported_avx2) {
+      std::ranges::fill(std::span(lut8.lut8_.get(), LUT_END), 0);
+      std::cout << "avx2_lut8 ";
+      start = std::chrono::high_resolution_clock::now();
+      for (auto current_loop : std::views::iota(0, loop_count)) {
+        lut8.Create_Impl<LUT::Method::avx2_lut8>(lut_min, lut_max);
+      }
+      end        = std::chrono::high_resolution_clock::now();
+      time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      std::cout << std::format("time: {}, diff: {}", time_count / loop_count,
+                               CalcDiff(lut8.lut8_.get(), ref_lut, LUT_END))
+                << std::endl;
+    }
+
+    const std::tuple<const char*, bool, ConvertImpl> convert8_impls[] = {
+        {"naive_lut8", true, &LUT::Convert_Impl<LUT::Method::naive_lut8>},
+        {"avx2_lut8", supported_avx2, &LUT::Convert_Impl<LUT::Method::avx2_lut8>},
+        {"avx512f_lut8", supported_avx512f, &LUT::Convert_Impl<LUT::Method::avx512f_lut8>},
+        {"avx512vbmi_lut8", supported_avx512vbmi, &LUT::Convert_Impl<LUT::Method::avx512vbmi_lut8>},
+    };
+    for (const auto& [name, supported, convert] : convert8_impls) {
+      if (!supported) {
+        continue;
+      }
+      std::ranges::fill(std::span(dptr, data_size), 0);
+      std::cout << name << " ";
+      start = std::chrono::high_resolution_clock::now();
+      for (auto current_loop : std::views::iota(0, loop_count)) {
+        (lut8.*convert)(sptr, dptr, data_size);
+      }
+      end        = std::chrono::high_resolution_clock::now();
+      time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      std::cout << std::format("time: {}, diff: {}", time_count / loop_count, CalcDiff(dptr, rptr, data_size))
+                << std::endl;
+    }
+
+    // range_max <= 256: レジスタに置いたテーブルを引く．範囲外の入力は255として扱う
+    if (supported_avx512vbmi) {
+      LUT lut8_small(0x100, LUT::Storage::Byte);
+      lut8_small.Create_Impl<LUT::Method::naive_lut8>(lut_min, lut_max);
+      std::vector<uint8_t> small_ref(data_size);
+      for (auto i : std::views::iota(0, data_size)) {
+        small_ref[i] = ref_lut[std::min<int32_t>(sptr[i], 0xFF)];
+      }
+      std::ranges::fill(std::span(dptr, data_size), 0);
+      std::cout << "avx512vbmi_lut8_permute ";
+      start = std::chrono::high_resolution_clock::now();
+      for (auto current_loop : std::views::iota(0, loop_count)) {
+        lut8_small.Convert_Impl<LUT::Method::avx512vbmi_lut8_permute>(sptr, dptr, data_size);
+      }
+      end        = std::chrono::high_resolution_clock::now();
+      time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      std::cout << std::format("time: {}, diff: {}", time_count / loop_count,
+                               CalcDiff(dptr, small_ref.data(), data_size))
+                << std::endl;
+    }
+
+    // 疑似カラー: uint16_t -> BGRA
+    std::cout << "Colormap" << std::endl;
+    std::vector<uint32_t> color_dst(data_size);
+    std::vector<uint32_t> color_ref(data_size);
+    using ExpandPaletteImpl = void (LUT::*)(const uint8_t*, uint32_t*, int32_t);
+    const std::tuple<const char*, bool, ExpandPaletteImpl> palette_impls[] = {
+        {"naive_palette", true, &LUT::ExpandPalette_Impl<LUT::Method::naive_palette>},
+        {"avx2_palette", supported_avx2, &LUT::ExpandPalette_Impl<LUT::Method::avx2_palette>},
+        {"avx512f_palette", supported_avx512f, &LUT::ExpandPalette_Impl<LUT::Method::avx512f_palette>},
+        {"avx512vbmi_palette", supported_avx512vbmi, &LUT::ExpandPalette_Impl<LUT::Method::avx512vbmi_palette>},
+    };
+    const std::tuple<const char*, LUT::Colormap> colormaps[] = {
+        {"gray", LUT::Colormap::Gray},
+        {"jet", LUT::Colormap::Jet},
+        {"hot", LUT::Colormap::Hot},
+    };
+    for (const auto& [colormap_name, colormap] : colormaps) {
+      const auto palette = LUT::MakeColormap(colormap);
+      lut.SetColormap(palette);
+      for (auto i : std::views::iota(0, data_size)) {
+        color_ref[i] = palette[rptr[i]];
+      }
+
+      // rptr(Convertの出力)を色にする．端数を含むようにdata_size - 37要素
+      const int32_t expand_size = data_size - 37;
+      for (const auto& [name, supported, expand] : palette_impls) {
+        if (!supported) {
+          continue;
+        }
+        std::ranges::fill(color_dst, 0);
+        std::cout << std::format("{} {} ", colormap_name, name);
+        start = std::chrono::high_resolution_clock::now();
+        for (auto current_loop : std::views::iota(0, loop_count)) {
+          (lut.*expand)(rptr, color_dst.data(), expand_size);
+        }
+        end        = std::chrono::high_resolution_clock::now();
+        time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        const bool match =
+            std::ranges::equal(std::span(color_dst).first(expand_size), std::span(color_ref).first(expand_size)) &&
+            color_dst[expand_size] == 0;
+        std::cout << std::format("time: {}, {}", time_count / loop_count, match ? "match" : "mismatch") << std::endl;
+      }
+
+      // Convert + ExpandPaletteを1回で行う
+      for (auto num_threads : {1, 0}) {
+        lut.SetNumThreads(num_threads);
+        std::ranges::fill(color_dst, 0);
+        std::cout << std::format("{} ConvertColor threads: {} ", colormap_name, lut.GetNumThreads());
+        start = std::chrono::high_resolution_clock::now();
+        for (auto current_loop : std::views::iota(0, loop_count)) {
+          lut.ConvertColor(sptr, color_dst.data(), data_size);
+        }
+        end        = std::chrono::high_resolution_clock::now();
+        time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        std::cout << std::format("time: {}, {}", time_count / loop_count,
+                                 std::ranges::equal(color_dst, color_ref) ? "match" : "mismatch")
+                  << std::endl;
+      }
+      lut.SetNumThreads(1);
+    }
+  }
+
+  // テーブルのキャッシュ: 窓を少しずつ動かしてCreateする(ドラッグ)
+  {
+    std::cout << "Table cache" << std::endl;
+    constexpr int32_t drag_frames               = 200;
+    constexpr std::array<uint8_t, 4> drag_table = {16, 64, 128, 240};
+
+    const std::tuple<const char*, LUT::Storage, LUT::CurveParams> drag_cases[] = {
+        {"gamma", LUT::Storage::Word, {.curve = LUT::Curve::Gamma, .gamma = 2.2f}},
+        {"table", LUT::Storage::Word, {.curve = LUT::Curve::Table, .table = drag_table}},
+        {"sigmoid byte", LUT::Storage::Byte, {.curve = LUT::Curve::Sigmoid, .gain = 10.0f}},
+    };
+    for (const auto& [name, storage, params] : drag_cases) {
+      const bool byte = storage == LUT::Storage::Byte;
+      LUT cached(LUT_END, storage);
+      LUT full(LUT_END, storage);
+      auto window = [](int32_t frame_i) { return std::pair{0x1000 + 7 * frame_i, 0x3000 + 5 * frame_i}; };
+
+      // 毎回キャッシュを捨てて全体を作るものと一致する
+      bool match = true;
+      for (auto frame_i : std::views::iota(0, drag_frames)) {
+        const auto [window_min, window_max] = window(frame_i);
+        cached.Create(window_min, window_max, params);
+        full.ClearTableCache();
+        full.Create(window_min, window_max, params);
+        match = match && (byte ? std::ranges::equal(std::span(cached.lut8_.get(), LUT_END),
+                                                    std::span(full.lut8_.get(), LUT_END))
+                               : std::ranges::equal(std::span(cached.lut_.get(), LUT_END),
+                                                    std::span(full.lut_.get(), LUT_END)));
+      }
+
+      auto measure = [&](bool clear, bool back_and_forth) {
+        start = std::chrono::high_resolution_clock::now();
+        for (auto frame_i : std::views::iota(0, drag_frames)) {
+          if (clear) {
+            cached.ClearTableCache();
+          }
+          const auto [window_min, window_max] = window(back_and_forth ? frame_i % 2 : frame_i);
+          cached.Create(window_min, window_max, params);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / drag_frames;
+      };
+      // full: 毎回キャッシュを捨てる(テーブルの確保を含む)，toggle: 2つの窓を行き来する
+      const auto full_time   = measure(true, false);
+      const auto drag_time   = measure(false, false);
+      const auto toggle_time = measure(false, true);
+      std::cout << std::format("{}: {}, full: {} ns, drag: {} ns, toggle: {} ns", name, match ? "match" : "mismatch",
+                               full_time, drag_time, toggle_time)
+                << std::endl;
+    }
+  }
+
+  // 8bitの入力: uint16_tへ広げてConvertしたものと一致する
+  {
+    std::cout << "8bit source" << std::endl;
+    constexpr int32_t src8_size  = 1920 * 1080 + 37;
+    constexpr int32_t src8_loop  = 200;
+    constexpr int32_t src8_range = 0x100;
+
+    std::vector<uint8_t> src8(src8_size);
+    std::vector<uint16_t> src16(src8_size);
+    std::vector<uint8_t> dst8(src8_size);
+    std::vector<uint8_t> ref8(src8_size);
+    std::mt19937 engine(0);
+    for (auto i : std::views::iota(0, src8_size)) {
+      src8[i]  = static_cast<uint8_t>(engine());
+      src16[i] = src8[i];
+    }
+
+    using Convert8Impl = void (LUT::*)(const uint8_t*, uint8_t*, int32_t);
+    const std::tuple<const char*, bool, Convert8Impl> convert8_src_impls[] = {
+        {"naive_src8", true, &LUT::Convert8_Impl<LUT::Method::naive_src8>},
+        {"avx2_src8_pshufb", supported_avx2, &LUT::Convert8_Impl<LUT::Method::avx2_src8_pshufb>},
+        {"avx512vbmi_src8_permute", supported_avx512vbmi,
+         &LUT::Convert8_Impl<LUT::Method::avx512vbmi_src8_permute>},
+    };
+    const std::tuple<const char*, int32_t, int32_t, LUT::CurveParams> windows8[] = {
+        {"linear", 0x10, 0xC0, {}},
+        {"gamma", 0x00, 0xFF, {.curve = LUT::Curve::Gamma, .gamma = 2.2f}},
+    };
+
+    LUT lut_src8(src8_range);
+    for (const auto& [name, window_min, window_max, params] : windows8) {
+      lut_src8.Create(window_min, window_max, params);
+      lut_src8.Convert(src16.data(), ref8.data(), src8_size);
+
+      // これまでの方法: uint16_tに広げたものをgatherで引く
+      if (supported_avx512f) {
+        lut_src8.Create_Impl<LUT::Method::naive_lut>(window_min, window_max);
+        if (params.curve != LUT::Curve::Linear) {
+          lut_src8.CreateCurve_Impl<LUT::Method::naive_lut>(window_min, window_max, params);
+        }
+        std::cout << std::format("{} avx512f_lut(uint16_t) ", name);
+        start = std::chrono::high_resolution_clock::now();
+        for (auto current_loop : std::views::iota(0, src8_loop)) {
+          lut_src8.Convert_Impl<LUT::Method::avx512f_lut>(src16.data(), dst8.data(), src8_size);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << std::format("time: {}, {}",
+                                 std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / src8_loop,
+                                 std::ranges::equal(dst8, ref8) ? "match" : "mismatch")
+                  << std::endl;
+        lut_src8.ClearTableCache();
+        lut_src8.Create(window_min, window_max, params);
+      }
+
+      std::ranges::fill(dst8, 0);
+      lut_src8.Convert(src8.data(), dst8.data(), src8_size);
+      std::cout << std::format("{} Auto Impl: {}", name, std::ranges::equal(dst8, ref8) ? "match" : "mismatch")
+                << std::endl;
+      for (const auto& [impl_name, supported, convert] : convert8_src_impls) {
+        if (!supported) {
+          continue;
+        }
+        std::ranges::fill(dst8, 0);
+        std::cout << std::format("{} {} ", name, impl_name);
+        start = std::chrono::high_resolution_clock::now();
+        for (auto current_loop : std::views::iota(0, src8_loop)) {
+          (lut_src8.*convert)(src8.data(), dst8.data(), src8_size);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << std::format("time: {}, {}",
+                                 std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / src8_loop,
+                                 std::ranges::equal(dst8, ref8) ? "match" : "mismatch")
+                  << std::endl;
+      }
+    }
+  }
+
+  // 計測による実装の選択: 2回目はプロファイルを読むだけ
+  {
+    std::cout << "Calibrate" << std::endl;
+    const auto profile_path = (std::filesystem::temp_directory_path() / "lut_calibration.txt").string();
+    std::filesystem::remove(profile_path);
+
+    constexpr int32_t calib_min = 0x1000;
+    constexpr int32_t calib_max = 0x8FFF;
+    std::vector<uint16_t> calib_src(LUT_END);
+    std::vector<uint8_t> calib_dst(LUT_END);
+    std::vector<uint8_t> calib_ref(LUT_END);
+    std::ranges::copy(std::views::iota(0, LUT_END), calib_src.begin());
+
+    for (auto storage : {LUT::Storage::Word, LUT::Storage::Byte}) {
+      for (auto pass : {"measure", "profile"}) {
+        LUT calibrated(LUT_END, storage);
+        start = std::chrono::high_resolution_clock::now();
+        calibrated.Calibrate(profile_path);
+        end = std::chrono::high_resolution_clock::now();
+
+        // 選び直しても出力はnaive_lutと同じ
+        LUT reference(LUT_END, storage);
+        reference.Create_Impl<LUT::Method::naive_lut>(calib_min, calib_max);
+        reference.Convert_Impl<LUT::Method::naive_lut>(calib_src.data(), calib_ref.data(), LUT_END);
+        calibrated.Create(calib_min, calib_max);
+        calibrated.Convert(calib_src.data(), calib_dst.data(), LUT_END);
+        std::cout << std::format("{} {}: {} us, diff: {}", storage == LUT::Storage::Word ? "Word" : "Byte", pass,
+                                 std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(),
+                                 CalcDiff(calib_dst.data(), calib_ref.data(), LUT_END))
+                  << std::endl;
+      }
+    }
+    std::ifstream ifs(profile_path);
+    std::cout << ifs.rdbuf();
+    std::filesystem::remove(profile_path);
+  }
+
+  // 自動窓: 4Kのフレームでヒストグラム -> 窓 -> Convertを通す
+  {
+    std::cout << "Auto window" << std::endl;
+    constexpr int32_t frame_width  = 3840;
+    constexpr int32_t frame_height = 2160;
+    constexpr int32_t frame_size   = frame_width * frame_height;
+    constexpr int32_t frame_loop   = 20;
+
+    std::vector<uint16_t> frame(frame_size);
+    std::vector<uint8_t> frame_dst(frame_size);
+    std::mt19937 engine(0);
+    std::normal_distribution<float> norm_dist(0x4000, 0x800);
+    for (auto& v : frame) {
+      v = static_cast<uint16_t>(std::clamp(static_cast<int32_t>(norm_dist(engine)), 0, 0xFFFF));
+    }
+
+    // パーセンタイルの基準: 小さい方からcount番目(0始まり)の値
+    const LUT::AutoWindowParams auto_params{.low_percentile = 1.0f, .high_percentile = 99.0f};
+    std::vector<uint16_t> sorted = frame;
+    auto nth                     = [&](int64_t count) {
+      std::ranges::nth_element(sorted, sorted.begin() + count);
+      return sorted[count];
+    };
+    const int32_t ref_min = nth(static_cast<int64_t>(frame_size * 0.01));
+    const int32_t ref_max = nth(frame_size - 1 - static_cast<int64_t>(frame_size * (1.0 - 0.99)));
+
+    LUT auto_lut(LUT_END);
+    for (auto num_threads : {1, 0}) {
+      auto_lut.SetNumThreads(num_threads);
+      auto_lut.CreateAuto(frame.data(), frame_size, auto_params);
+      std::cout << std::format("threads: {} window: [{}, {}] ref: [{}, {}] ", auto_lut.GetNumThreads(),
+                               auto_lut.lut_min_, auto_lut.lut_max_, ref_min, ref_max);
+      start = std::chrono::high_resolution_clock::now();
+      for (auto current_loop : std::views::iota(0, frame_loop)) {
+        auto_lut.CreateAuto(frame.data(), frame_size, auto_params);
+        auto_lut.Convert(frame.data(), frame_dst.data(), frame_size);
+      }
+      end        = std::chrono::high_resolution_clock::now();
+      time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      std::cout << std::format("time: {}", time_count / frame_loop) << std::endl;
+    }
+
+    // 間引いたヒストグラム
+    const LUT::AutoWindowParams sampled_params{.sample_step = 4};
+    auto_lut.SetNumThreads(1);
+    auto_lut.CreateAuto(frame.data(), frame_size, sampled_params);
+    std::cout << std::format("sample_step: 4 window: [{}, {}] ", auto_lut.lut_min_, auto_lut.lut_max_);
+    start = std::chrono::high_resolution_clock::now();
+    for (auto current_loop : std::views::iota(0, frame_loop)) {
+      auto_lut.CreateAuto(frame.data(), frame_size, sampled_params);
+      auto_lut.Convert(frame.data(), frame_dst.data(), frame_size);
+    }
+    end        = std::chrono::high_resolution_clock::now();
+    time_count = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::cout << std::format("time: {}", time_count / frame_loop) << std::endl;
+
+    // 平滑化: 明るさが1フレームおきに変わっても窓はゆっくり動く
+    std::vector<int32_t> flicker_histogram(LUT_END);
+    for (auto smoothing : {0.0f, 0.8f}) {
+      auto_lut.ResetAutoWindow();
+      std::cout << std::format("smoothing: {}", smoothing);
+      for (auto frame_i : std::views::iota(0, 6)) {
+        // 山が±0x200ずれる
+        std::ranges::fill(flicker_histogram, 0);
+        const int32_t center = 0x4000 + (frame_i % 2 == 0 ? 0x200 : -0x200);
+        for (auto i : std::views::iota(-0x800, 0x800)) {
+          flicker_histogram[center + i] = 100;
+        }
+        auto_lut.CreateAuto(flicker_histogram, {.smoothing = smoothing});
+        std::cout << std::format(" [{}, {}]", auto_lut.lut_min_, auto_lut.lut_max_);
+      }
+      std::cout << std::endl;
+    }
   }
 
   return 0;
@@ -0,0 +1,344 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <span>
+#include <random>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "instruction_info.h"
+#include "lut.h"
+
+namespace {
+constexpr int32_t RANGE_MAX = 4096;
+
+std::vector<uint16_t> CreateTestData(int32_t data_size) {
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int32_t> dist(0, RANGE_MAX - 1);
+  std::vector<uint16_t> src(data_size);
+  for (auto& elem : src) {
+    elem = dist(engine);
+  }
+  return src;
+}
+
+// naive_lutで作ったテーブルを引いた結果
+std::vector<uint8_t> Reference(const std::vector<uint16_t>& src, int32_t lut_min, int32_t lut_max,
+                               const LUT::CurveParams& params = {}) {
+  LUT ref(RANGE_MAX);
+  if (params.curve == LUT::Curve::Linear) {
+    ref.Create_Impl<LUT::Method::naive_lut>(lut_min, lut_max);
+  } else {
+    ref.CreateCurve_Impl<LUT::Method::naive_lut>(lut_min, lut_max, params);
+  }
+  std::vector<uint16_t> tmp(src);
+  std::vector<uint8_t> dst(src.size());
+  ref.Convert_Impl<LUT::Method::naive_lut>(tmp.data(), dst.data(), tmp.size());
+  return dst;
+}
+
+void ExpectEqual(const std::vector<uint8_t>& ref, const std::vector<uint8_t>& dst) {
+  ASSERT_EQ(ref.size(), dst.size());
+  for (auto i : std::views::iota(size_t{0}, ref.size())) {
+    ASSERT_EQ(ref[i], dst[i]) << std::format("i={}", i);
+  }
+}
+} // namespace
+
+class LUT_PARALLEL_TEST : public ::testing::TestWithParam<std::tuple<LUT::Storage, int32_t, int32_t>> {};
+INSTANTIATE_TEST_CASE_P(, LUT_PARALLEL_TEST,
+                        ::testing::Combine(::testing::Values(LUT::Storage::Word, LUT::Storage::Byte),
+                                           ::testing::Values(1, 2, 4),
+                                           ::testing::Values(LUT::CONVERT_CHUNK_SIZE * 3 + 77,
+                                                             LUT::CONVERT_CHUNK_SIZE * 8)));
+
+// チャンクに分けたConvertがシングルスレッドのnaive_lutと一致する．端数のチャンクも確認する
+TEST_P(LUT_PARALLEL_TEST, Convert) {
+  const auto [storage, num_threads, data_size] = GetParam();
+  std::vector<uint16_t> src                    = CreateTestData(data_size);
+  std::vector<uint8_t> dst(data_size);
+
+  LUT lut(RANGE_MAX, storage);
+  lut.SetNumThreads(num_threads);
+  for (auto [lut_min, lut_max] : {std::pair{0, RANGE_MAX - 1}, {1000, 1255}, {300, 3000}}) {
+    lut.Create(lut_min, lut_max);
+    lut.Convert(src.data(), dst.data(), data_size);
+    ExpectEqual(Reference(src, lut_min, lut_max), dst);
+
+    const LUT::CurveParams gamma{.curve = LUT::Curve::Gamma};
+    lut.Create(lut_min, lut_max, gamma);
+    lut.Convert(src.data(), dst.data(), data_size);
+    ExpectEqual(Reference(src, lut_min, lut_max, gamma), dst);
+  }
+}
+
+// 行間に隙間のある2次元領域は変換し，隙間は書き換えない
+TEST_P(LUT_PARALLEL_TEST, Convert2D) {
+  const auto [storage, num_threads, data_size] = GetParam();
+  constexpr int32_t rows = 37;
+  constexpr int32_t cols = 999;
+  constexpr int32_t src_pitch = 1024;
+  constexpr int32_t dst_pitch = 1031;
+  constexpr uint8_t sentinel  = 0xA5;
+
+  std::vector<uint16_t> src = CreateTestData(rows * src_pitch);
+  std::vector<uint8_t> dst(rows * dst_pitch, sentinel);
+
+  LUT lut(RANGE_MAX, storage);
+  lut.SetNumThreads(num_threads);
+  lut.Create(500, 2500);
+  lut.Convert(src.data(), src_pitch * sizeof(uint16_t), dst.data(), dst_pitch, rows, cols);
+
+  const std::vector<uint8_t> ref = Reference(src, 500, 2500);
+  for (auto y : std::views::iota(0, rows)) {
+    for (auto x : std::views::iota(0, dst_pitch)) {
+      const uint8_t expected = x < cols ? ref[y * src_pitch + x] : sentinel;
+      ASSERT_EQ(expected, dst[y * dst_pitch + x]) << std::format("(y, x)=({}, {})", y, x);
+    }
+  }
+
+  // 隙間がない場合は1次元のConvertと同じ
+  std::vector<uint8_t> contiguous(rows * src_pitch);
+  lut.Convert(src.data(), src_pitch * sizeof(uint16_t), contiguous.data(), src_pitch, rows, src_pitch);
+  ExpectEqual(ref, contiguous);
+}
+
+class LUT_TABLE_CACHE_TEST : public ::testing::TestWithParam<LUT::Storage> {};
+INSTANTIATE_TEST_CASE_P(, LUT_TABLE_CACHE_TEST, ::testing::Values(LUT::Storage::Word, LUT::Storage::Byte));
+
+// キャッシュから戻したテーブル，追い出して範囲だけ作り直したテーブルが，毎回作ったものと一致する
+TEST_P(LUT_TABLE_CACHE_TEST, Create) {
+  const LUT::Storage storage = GetParam();
+  constexpr int32_t data_size = 64 * 1024;
+  std::vector<uint16_t> src   = CreateTestData(data_size);
+  std::vector<uint8_t> dst(data_size);
+
+  const LUT::CurveParams gamma{.curve = LUT::Curve::Gamma};
+  const LUT::CurveParams log{.curve = LUT::Curve::Log};
+  // TABLE_CACHE_SIZEより多い窓を行き来して，同じ曲線の窓を追い出すものと別の曲線を追い出すものを混ぜる
+  const std::tuple<int32_t, int32_t, LUT::CurveParams> windows[] = {
+      {100,  900,  gamma},
+      {200,  1200, gamma},
+      {100,  900,  gamma},
+      {0,    4095, log  },
+      {1500, 3500, gamma},
+      {300,  700,  gamma},
+      {2000, 2100, log  },
+      {100,  900,  gamma},
+      {200,  1200, gamma},
+      {2000, 2100, log  },
+      {1500, 3500, log  },
+  };
+
+  LUT lut(RANGE_MAX, storage);
+  for (const auto& [lut_min, lut_max, params] : windows) {
+    lut.Create(lut_min, lut_max, params);
+    ASSERT_LE(lut.table_cache_.size(), LUT::TABLE_CACHE_SIZE);
+    lut.Convert(src.data(), dst.data(), data_size);
+    ExpectEqual(Reference(src, lut_min, lut_max, params), dst);
+  }
+
+  // キャッシュにある窓は作り直さずに同じテーブルを使う
+  lut.Create(200, 1200, gamma);
+  const void* table = storage == LUT::Storage::Byte ? static_cast<const void*>(lut.lut8_.get())
+                                                    : static_cast<const void*>(lut.lut_.get());
+  lut.Create(2000, 2100, log);
+  lut.Create(200, 1200, gamma);
+  EXPECT_EQ(table, storage == LUT::Storage::Byte ? static_cast<const void*>(lut.lut8_.get())
+                                                 : static_cast<const void*>(lut.lut_.get()));
+
+  lut.ClearTableCache();
+  EXPECT_TRUE(lut.table_cache_.empty());
+  lut.Create(300, 700, gamma);
+  lut.Convert(src.data(), dst.data(), data_size);
+  ExpectEqual(Reference(src, 300, 700, gamma), dst);
+}
+
+class LUT_HISTOGRAM_TEST : public ::testing::TestWithParam<std::tuple<int32_t, int32_t>> {};
+INSTANTIATE_TEST_CASE_P(, LUT_HISTOGRAM_TEST, ::testing::Combine(::testing::Values(1, 4), ::testing::Values(1, 3)));
+
+// CalcHistogramがsample_step毎に数えたものと一致する．スレッド数が指定より少ない場合(入れ子の並列)も確認する
+TEST_P(LUT_HISTOGRAM_TEST, CalcHistogram) {
+  const auto [num_threads, sample_step] = GetParam();
+  constexpr int32_t data_size           = LUT::CONVERT_CHUNK_SIZE * 5 + 11;
+  std::vector<uint16_t> src             = CreateTestData(data_size);
+
+  std::vector<int32_t> ref(RANGE_MAX, 0);
+  for (int32_t i = 0; i < data_size; i += sample_step) {
+    ref[src[i]]++;
+  }
+
+  LUT lut(RANGE_MAX);
+  lut.SetNumThreads(num_threads);
+  auto expect_equal = [&](std::span<const int32_t> histogram) {
+    ASSERT_EQ(histogram.size(), RANGE_MAX);
+    for (auto v : std::views::iota(0, RANGE_MAX)) {
+      ASSERT_EQ(ref[v], histogram[v]) << std::format("v={}", v);
+    }
+  };
+  expect_equal(lut.CalcHistogram(src.data(), data_size, sample_step));
+
+  // 前回の各スレッドのヒストグラムが残っていても，実行しなかったスレッドの分は足さない
+  std::vector<int32_t> nested;
+#pragma omp parallel num_threads(2)
+  {
+#pragma omp single
+    {
+      const auto histogram = lut.CalcHistogram(src.data(), data_size, sample_step);
+      nested.assign(histogram.begin(), histogram.end());
+    }
+  }
+  expect_equal(nested);
+}
+
+// Calibrateの前にCreateした窓と曲線は，Calibrateの後もそのまま使え，出力はnaive_lutと一致する
+TEST(LUT_CALIBRATE, KeepsWindow) {
+  constexpr int32_t data_size = 64 * 1024;
+  std::vector<uint16_t> src   = CreateTestData(data_size);
+  std::vector<uint8_t> dst(data_size);
+  const uint8_t steps[]           = {0, 40, 200, 255};
+  const LUT::CurveParams params[] = {{}, {.curve = LUT::Curve::Gamma}, {.curve = LUT::Curve::Table, .table = steps}};
+
+  for (auto storage : {LUT::Storage::Word, LUT::Storage::Byte}) {
+    for (const auto& curve : params) {
+      LUT lut(RANGE_MAX, storage);
+      lut.Create(123, 2345, curve);
+      lut.Calibrate();
+      lut.Convert(src.data(), dst.data(), data_size);
+      ExpectEqual(Reference(src, 123, 2345, curve), dst);
+    }
+  }
+}
+
+// 計測で選ぶ組み合わせによらず，Calibrateの後の線形の窓はnaive_lutと一致する
+TEST(LUT_CALIBRATE, LinearMatchesNaive) {
+  constexpr int32_t data_size = 64 * 1024;
+  std::vector<uint16_t> src   = CreateTestData(data_size);
+  std::vector<uint8_t> dst(data_size);
+  constexpr std::pair<int32_t, int32_t> windows[] = {{0, RANGE_MAX - 1}, {123, 2345}, {1000, 1003}, {-500, 777}};
+
+  for (auto storage : {LUT::Storage::Word, LUT::Storage::Byte}) {
+    LUT lut(RANGE_MAX, storage);
+    lut.Calibrate();
+    for (const auto& [lut_min, lut_max] : windows) {
+      lut.Create(lut_min, lut_max);
+      lut.Convert(src.data(), dst.data(), data_size);
+      ExpectEqual(Reference(src, lut_min, lut_max, {}), dst);
+    }
+  }
+}
+
+// プロファイルに不正な行や同じroleの重複があれば計測し直し，正しいプロファイルで上書きする
+TEST(LUT_CALIBRATE, RejectsBrokenProfile) {
+  const auto profile_path = std::filesystem::temp_directory_path() / "lut_calibrate_test.txt";
+  auto count_lines        = [&](std::string_view role) {
+    std::ifstream ifs(profile_path);
+    std::string line;
+    int32_t count = 0;
+    while (std::getline(ifs, line)) {
+      count += line.starts_with(std::format("{} 0 {} ", RANGE_MAX, role));
+    }
+    return count;
+  };
+
+  LUT lut(RANGE_MAX);
+  std::filesystem::remove(profile_path);
+  lut.Calibrate(profile_path.string());
+  for (auto role : {"linear", "table", "intweight_epu16", "intweight_epi32"}) {
+    ASSERT_EQ(count_lines(role), 1) << role;
+  }
+
+  for (auto broken : {std::format("{} 0 table naive_lut\n", RANGE_MAX), std::string("broken line\n"),
+                      std::format("{} 0 linear naive_lut extra\n", RANGE_MAX)}) {
+    {
+      std::ofstream ofs(profile_path, std::ios::app);
+      ofs << broken;
+    }
+    lut.Calibrate(profile_path.string());
+    for (auto role : {"linear", "table", "intweight_epu16", "intweight_epi32"}) {
+      EXPECT_EQ(count_lines(role), 1) << role;
+    }
+    std::ifstream ifs(profile_path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      EXPECT_NE(line, "broken line");
+    }
+  }
+  std::filesystem::remove(profile_path);
+}
+
+// SIMDのテーブル作成がnaive_lut(8)と一致する．書き込まなかった要素を見逃さないように，基準値の反転で埋めてから作る
+TEST(LUT_BUILDER, MatchesNaive) {
+  using IIIS          = InstructionInfo::InstructionSet;
+  const bool avx2     = InstructionInfo::IsSupported(IIIS::AVX2);
+  const bool avx512f  = InstructionInfo::IsSupported(IIIS::AVX512F) && InstructionInfo::IsSupported(IIIS::AVX512BW) &&
+                       InstructionInfo::IsSupported(IIIS::AVX512VL);
+  const uint8_t steps[] = {0, 255, 32, 128, 64};
+  const LUT::CurveParams curves[] = {{},
+                                     {.curve = LUT::Curve::Gamma},
+                                     {.curve = LUT::Curve::Log, .gain = 100.0f},
+                                     {.curve = LUT::Curve::Sigmoid},
+                                     {.curve = LUT::Curve::Table, .table = steps}};
+
+  using Build = void (*)(LUT&, int32_t, int32_t, const LUT::CurveParams&);
+  const std::tuple<const char*, bool, LUT::Storage, Build> builders[] = {
+      {"avx2_lut", avx2, LUT::Storage::Word,
+       [](LUT& lut, int32_t lut_min, int32_t lut_max, const LUT::CurveParams& params) {
+         params.curve == LUT::Curve::Linear ? lut.Create_Impl<LUT::Method::avx2_lut>(lut_min, lut_max)
+                                            : lut.CreateCurve_Impl<LUT::Method::avx2_lut>(lut_min, lut_max, params);
+       }},
+      {"avx512f_lut", avx512f, LUT::Storage::Word,
+       [](LUT& lut, int32_t lut_min, int32_t lut_max, const LUT::CurveParams& params) {
+         params.curve == LUT::Curve::Linear ? lut.Create_Impl<LUT::Method::avx512f_lut>(lut_min, lut_max)
+                                            : lut.CreateCurve_Impl<LUT::Method::avx512f_lut>(lut_min, lut_max, params);
+       }},
+      {"avx2_lut8", avx2, LUT::Storage::Byte,
+       [](LUT& lut, int32_t lut_min, int32_t lut_max, const LUT::CurveParams& params) {
+         params.curve == LUT::Curve::Linear ? lut.Create_Impl<LUT::Method::avx2_lut8>(lut_min, lut_max)
+                                            : lut.CreateCurve_Impl<LUT::Method::avx2_lut8>(lut_min, lut_max, params);
+       }},
+      {"avx512f_lut8", avx512f, LUT::Storage::Byte,
+       [](LUT& lut, int32_t lut_min, int32_t lut_max, const LUT::CurveParams& params) {
+         // uint8_tの曲線はavx2_lut8を使う
+         params.curve == LUT::Curve::Linear ? lut.Create_Impl<LUT::Method::avx512f_lut8>(lut_min, lut_max)
+                                            : lut.CreateCurve_Impl<LUT::Method::avx2_lut8>(lut_min, lut_max, params);
+       }},
+  };
+
+  LUT ref(RANGE_MAX);
+  for (auto [lut_min, lut_max] : {std::pair{0, 255}, {0, 15}, {291, 1110}, {1000, 3999}, {0, RANGE_MAX - 1}}) {
+    for (const auto& params : curves) {
+      if (params.curve == LUT::Curve::Linear) {
+        ref.Create_Impl<LUT::Method::naive_lut>(lut_min, lut_max);
+      } else {
+        ref.CreateCurve_Impl<LUT::Method::naive_lut>(lut_min, lut_max, params);
+      }
+      for (const auto& [name, supported, storage, build] : builders) {
+        if (!supported) {
+          continue;
+        }
+        LUT lut(RANGE_MAX, storage);
+        const bool byte = storage == LUT::Storage::Byte;
+        for (auto i : std::views::iota(0, RANGE_MAX)) {
+          if (byte) {
+            lut.lut8_[i] = static_cast<uint8_t>(~ref.lut_[i]);
+          } else {
+            lut.lut_[i] = ~ref.lut_[i];
+          }
+        }
+        build(lut, lut_min, lut_max, params);
+        for (auto i : std::views::iota(0, RANGE_MAX)) {
+          const uint32_t value = byte ? lut.lut8_[i] : lut.lut_[i];
+          ASSERT_EQ(ref.lut_[i], value) << std::format("{} curve={} [{}, {}] i={}", name,
+                                                       static_cast<int32_t>(params.curve), lut_min, lut_max, i);
+        }
+      }
+    }
+  }
+}